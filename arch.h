@@ -2,6 +2,7 @@
 #define ARCH_H
 
 #include <dirent.h>
+#include <time.h>
 
 /**
  * @brief ファイル属性のビットフラグ定義
@@ -9,6 +10,29 @@
 #define FILE_ATTR_SYMLINK (1 << 0)     // シンボリックリンク属性
 #define FILE_ATTR_EXECUTABLE (1 << 1)  // 実行可能属性
 
+/**
+ * @brief ファイルのメタデータ
+ *
+ * @struct FileInfo
+ */
+typedef struct {
+  unsigned long size;  // ファイルサイズ (バイト)
+  time_t mtime;        // 最終更新日時
+  int mode;            // 種類と許可 (struct stat の st_mode と同じ形式)
+} FileInfo;
+
+/**
+ * @brief ディレクトリを物理的に識別する値
+ *
+ * 別のパスから同じディレクトリをたどった場合に同じ値になる
+ *
+ * @struct FileIdentity
+ */
+typedef struct {
+  unsigned long device;  // ドライブ (デバイス) の番号
+  unsigned long inode;   // ドライブ内でディレクトリを識別する番号
+} FileIdentity;
+
 /**
  * @brief ファイルシステムが大文字小文字を区別するかどうかを判定する
  *
@@ -24,6 +48,26 @@ int is_filesystem_ignore_case(void);
  */
 int is_directory_entry(struct dirent *entry);
 
+/**
+ * @brief struct dirent のエントリがシンボリックリンクを表しているかどうかを判定する
+ *
+ * @param[in] entry 判定するディレクトリエントリ
+ * @return シンボリックリンクの場合は非ゼロ値、それ以外は 0
+ */
+int is_symlink_entry(struct dirent *entry);
+
+/**
+ * @brief 指定されたパスの種類とディレクトリの識別値を取得する
+ *
+ * シンボリックリンクはリンク先をたどって判定する
+ *
+ * @param[in] path 判定するパス
+ * @param[out] id ディレクトリの場合は識別値を格納する
+ * @return ディレクトリの場合は 1、ディレクトリ以外の場合は 0、
+ * 存在しない場合 (リンク先が存在しない場合を含む) は -1
+ */
+int get_directory_identity(const char *path, FileIdentity *id);
+
 /**
  * @brief 指定されたパスが通常ファイルかどうかを判定する
  *
@@ -34,6 +78,20 @@ int is_directory_entry(struct dirent *entry);
  */
 int is_existing_regular_file(const char *path);
 
+/**
+ * @brief 指定されたパスのディレクトリを 1 回の検索で探す
+ *
+ * ディレクトリを列挙せずに、指定された名前のエントリだけを検索する。
+ * シンボリックリンクはディレクトリとみなさない
+ *
+ * @param[in] path 探すディレクトリのパス
+ * @param[out] name ディレクトリに格納されている実際の名前を格納するバッファ
+ * (ファイルシステムが大文字小文字を区別しない場合は path と異なることがある)
+ * @param[in] size name のバイト数
+ * @return ディレクトリが存在する場合は非ゼロ値、それ以外は 0
+ */
+int find_subdirectory(const char *path, char *name, const int size);
+
 /**
  * @brief ファイルの属性を取得する
  *
@@ -44,6 +102,65 @@ int is_existing_regular_file(const char *path);
  */
 int get_file_attributes(const char *path);
 
+/**
+ * @brief scan_file_attributes でエントリごとに呼び出される関数
+ *
+ * @param[in] name エントリのファイル名
+ * @param[in] attributes 属性のビットフラグ (FILE_ATTR_* 定数の組み合わせ)
+ * @param[in] info エントリのメタデータ (get_file_info と同じもの)
+ * @param[in] user_data scan_file_attributes に渡されたポインタ
+ */
+typedef void (*FileAttributeCallback)(const char *name, int attributes,
+                                      const FileInfo *info, void *user_data);
+
+/**
+ * @brief ディレクトリ内のすべてのエントリの属性を格納順にまとめて取得する
+ *
+ * エントリごとに get_file_attributes / get_file_info を呼び出す代わりに、
+ * ディレクトリを先頭から 1 回だけ読んで属性とメタデータを取得する。
+ * "." と ".." は通知しない
+ *
+ * @param[in] dir_path ディレクトリのパス (区切り文字で終わる)
+ * @param[in] callback エントリごとに呼び出す関数
+ * @param[in] user_data callback に渡すポインタ
+ * @return 成功時は 1、失敗時は 0
+ */
+int scan_file_attributes(const char *dir_path, FileAttributeCallback callback,
+                         void *user_data);
+
+/**
+ * @brief ファイルのメタデータを取得する
+ *
+ * シンボリックリンクはリンク先ではなくリンク自体の情報を取得する
+ *
+ * @param[in] path メタデータを取得するファイルのパス
+ * @param[out] info 取得したメタデータ
+ * @return 成功時は 1、失敗時は 0
+ */
+int get_file_info(const char *path, FileInfo *info);
+
+/**
+ * @brief コマンドを実行して終了を待つ
+ *
+ * @param[in] argv コマンドと引数 (NULL 終端)
+ * @return コマンドの終了コード、実行できなかった場合は負の値
+ */
+int run_command(char *const argv[]);
+
+/**
+ * @brief 1 回のコマンド実行で渡せるコマンドラインの長さの上限を取得する
+ *
+ * @return コマンドラインの長さの上限 (バイト)
+ */
+int get_command_line_limit(void);
+
+/**
+ * @brief 指定された秒数だけ待つ
+ *
+ * @param[in] seconds 待つ秒数
+ */
+void wait_seconds(const int seconds);
+
 /**
  * @brief 文字列の末尾がパス区切り文字終わっているかを判定する
  *
@@ -1,12 +1,17 @@
 #include <ctype.h>
 #include <dirent.h>
 #include <mbstring.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <x68k/dos.h>
 
 #include "arch.h"
 
+#define DOS_ATTR_READONLY 0x01  // 読み込み専用属性
+#define DOS_ATTR_ALL 0xff       // _dos_files ですべての種類のエントリを検索する
+
 int is_filesystem_ignore_case(void) {
   int ret;
   __asm__ volatile(
@@ -22,6 +27,55 @@ int is_filesystem_ignore_case(void) {
 
 int is_directory_entry(struct dirent *entry) { return entry->d_type == DT_DIR; }
 
+int is_symlink_entry(struct dirent *entry) { return entry->d_type == DT_LNK; }
+
+int get_directory_identity(const char *path, FileIdentity *id) {
+  struct _filbuf buf;
+  char *pattern;
+
+  // ワイルドカード文字を含む名前のエントリは存在しない
+  if (strpbrk(path, "*?") != NULL) {
+    return -1;
+  }
+  pattern = (char *)malloc(strlen(path) + 5);
+  if (pattern == NULL) {
+    return -1;
+  }
+  strcpy(pattern, path);
+  if (!is_path_end_with_separator(pattern)) {
+    strcat(pattern, "/");
+  }
+
+  // i ノードの代わりに、ディレクトリの先頭の "." エントリがあるセクタの番号を
+  // 使う (リンク先をたどった実体のディレクトリのセクタになる)
+  strcat(pattern, ".");
+  int found = _dos_files(&buf, pattern, _DOS_IFDIR) >= 0;
+  if (!found) {
+    // ルートディレクトリには "." がないため、最初のエントリのセクタを使う
+    strcpy(pattern + strlen(pattern) - 1, "*.*");
+    found = _dos_files(&buf, pattern, DOS_ATTR_ALL) >= 0;
+  }
+  free(pattern);
+  if (found) {
+    id->device = buf.driveno;
+    id->inode = buf.dirsec;
+    return 1;
+  }
+
+  if (_dos_files(&buf, path, DOS_ATTR_ALL) >= 0) {
+    return 0;  // ディレクトリ以外
+  }
+  // 空のルートディレクトリ (中をたどっても何も見つからないため、識別値は
+  // 区別しない)
+  DIR *dir = opendir(path);
+  if (dir == NULL) {
+    return -1;
+  }
+  closedir(dir);
+  id->device = id->inode = 0;
+  return 1;
+}
+
 int is_existing_regular_file(const char *path) {
   struct stat st;
   if (stat(path, &st) != 0) {
@@ -30,10 +84,32 @@ int is_existing_regular_file(const char *path) {
   return S_ISREG(st.st_mode);
 }
 
-int get_file_attributes(const char *path) {
-  int dos_attr;
+int find_subdirectory(const char *path, char *name, const int size) {
+  struct _filbuf buf;
+  // ワイルドカード文字を含む名前のエントリは存在しない
+  // (_dos_files に渡すとワイルドカードとして扱われるため)
+  if (strpbrk(path, "*?") != NULL) {
+    return 0;
+  }
+  if (_dos_files(&buf, path, _DOS_IFDIR) < 0) {
+    return 0;
+  }
+  if (!_DOS_ISDIR(buf.atr) || _DOS_ISLNK(buf.atr) ||
+      (int)strlen(buf.name) >= size) {
+    return 0;
+  }
+  strcpy(name, buf.name);
+  return 1;
+}
+
+/**
+ * @brief DOS の属性を FILE_ATTR_* のビットフラグに変換する
+ *
+ * @param[in] dos_attr DOS の属性
+ * @return 属性のビットフラグ
+ */
+static int to_file_attributes(const int dos_attr) {
   int result = 0;
-  dos_attr = _dos_chmod(path, -1);
   if (_DOS_ISLNK(dos_attr)) {
     result |= FILE_ATTR_SYMLINK;
   }
@@ -43,6 +119,126 @@ int get_file_attributes(const char *path) {
   return result;
 }
 
+int get_file_attributes(const char *path) {
+  return to_file_attributes(_dos_chmod(path, -1));
+}
+
+/**
+ * @brief DOS _FILES の結果からメタデータを作る
+ *
+ * @param[in] buf DOS _FILES の結果
+ * @param[out] info メタデータ
+ */
+static void to_file_info(const struct _filbuf *buf, FileInfo *info) {
+  struct tm tm;
+
+  info->size = buf->filelen;
+
+  // 日付と時刻は FAT の形式 (秒は 2 秒単位) で格納されている
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_year = (buf->date >> 9) + 80;
+  tm.tm_mon = ((buf->date >> 5) & 0x0f) - 1;
+  tm.tm_mday = buf->date & 0x1f;
+  tm.tm_hour = buf->time >> 11;
+  tm.tm_min = (buf->time >> 5) & 0x3f;
+  tm.tm_sec = (buf->time & 0x1f) * 2;
+  tm.tm_isdst = -1;
+  info->mtime = mktime(&tm);
+
+  // 属性から st_mode と同じ形式の値を作る (所有者の区別はない)
+  if (_DOS_ISLNK(buf->atr)) {
+    info->mode = S_IFLNK | 0777;
+  } else if (_DOS_ISDIR(buf->atr)) {
+    info->mode = S_IFDIR | 0755;
+  } else {
+    info->mode = S_IFREG | 0644;
+    if (buf->atr & _DOS_IEXEC) {
+      info->mode |= 0111;
+    }
+  }
+  if (buf->atr & DOS_ATTR_READONLY) {
+    info->mode &= ~0222;
+  }
+}
+
+int get_file_info(const char *path, FileInfo *info) {
+  struct _filbuf buf;
+
+  // DOS _FILES 1 回でサイズ、日時、属性をまとめて取得する
+  // (ワイルドカード文字を含む名前のエントリは存在しない)
+  if (strpbrk(path, "*?") != NULL || _dos_files(&buf, path, DOS_ATTR_ALL) < 0) {
+    return 0;
+  }
+  to_file_info(&buf, info);
+  return 1;
+}
+
+int scan_file_attributes(const char *dir_path, FileAttributeCallback callback,
+                         void *user_data) {
+  struct _filbuf buf;
+  char *pattern = (char *)malloc(strlen(dir_path) + 4);
+  if (pattern == NULL) {
+    return 0;
+  }
+  strcpy(pattern, dir_path);
+  strcat(pattern, "*.*");
+
+  // エントリごとに _dos_chmod でディレクトリを先頭から探す代わりに、
+  // DOS _FILES / _NFILES でディレクトリを 1 回だけ順に読む
+  int result = _dos_files(&buf, pattern, DOS_ATTR_ALL);
+  free(pattern);
+  if (result < 0) {
+    return 0;
+  }
+  do {
+    if (strcmp(buf.name, ".") != 0 && strcmp(buf.name, "..") != 0) {
+      FileInfo info;
+      to_file_info(&buf, &info);
+      callback(buf.name, to_file_attributes(buf.atr), &info, user_data);
+    }
+  } while (_dos_nfiles(&buf) >= 0);
+  return 1;
+}
+
+int run_command(char *const argv[]) {
+  // 空白を含む引数は二重引用符で囲み、 1 行のコマンドラインにして実行する
+  int len = 1;
+  for (int i = 0; argv[i] != NULL; i++) {
+    len += strlen(argv[i]) + 3;
+  }
+  char *line = (char *)malloc(len);
+  if (line == NULL) {
+    return -1;
+  }
+  line[0] = '\0';
+  for (int i = 0; argv[i] != NULL; i++) {
+    int quote = argv[i][0] == '\0' || strpbrk(argv[i], " \t") != NULL;
+    if (i > 0) {
+      strcat(line, " ");
+    }
+    strcat(line, quote ? "\"" : "");
+    strcat(line, argv[i]);
+    strcat(line, quote ? "\"" : "");
+  }
+
+  int status = system(line);
+  free(line);
+  return status;
+}
+
+int get_command_line_limit(void) {
+  // DOS _EXEC に渡せるコマンドラインは 255 バイトまで
+  return 255;
+}
+
+void wait_seconds(const int seconds) {
+  // 時刻を見ながら待ち、待っている間はバックグラウンドタスクに実行権を渡す
+  time_t end = time(NULL) + seconds;
+  while (time(NULL) < end) {
+    _dos_change_pr();
+  }
+}
+
 int is_path_end_with_separator(const char *path) {
   const unsigned char *p = (const unsigned char *)path;
   const unsigned char *p_prev = NULL;
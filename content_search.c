@@ -0,0 +1,143 @@
+#include "content_search.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief 1 回に読み込むバイト数
+ *
+ * Human68k では読み込みの回数が少ないほど速いため、大きな単位で読む
+ */
+#define CONTENT_BUFFER_SIZE 32768
+
+/**
+ * @brief 準備した文字列を表す構造体
+ *
+ * @struct ContentPattern
+ */
+struct ContentPattern {
+  unsigned char *text;     // 探す文字列 (大文字小文字を区別しない場合は小文字)
+  int length;              // 探す文字列のバイト数
+  int skip[256];           // 照合位置の末尾の文字ごとのずらし量
+  unsigned char fold[256]; // 照合前に文字に適用する変換 (大文字を小文字にする)
+  unsigned char *buffer;   // 読み込み用のバッファ
+  int buffer_size;         // buffer のバイト数
+};
+
+ContentPattern *content_pattern_compile(const char *text, int ignore_case) {
+  ContentPattern *pattern = (ContentPattern *)calloc(1, sizeof(ContentPattern));
+  if (pattern == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    return NULL;
+  }
+
+  // シフト JIS の 2 バイト目を変換しないよう、変換するのは 1 バイトの英字の
+  // 大文字だけにする (2 バイト目に英字がくる場合は一致することがある)
+  for (int c = 0; c < 256; c++) {
+    pattern->fold[c] = (ignore_case && c >= 'A' && c <= 'Z') ? c - 'A' + 'a'
+                                                             : c;
+  }
+
+  pattern->length = strlen(text);
+  pattern->buffer_size = CONTENT_BUFFER_SIZE;
+  while (pattern->buffer_size < pattern->length * 2) {
+    pattern->buffer_size *= 2;
+  }
+  pattern->text = (unsigned char *)malloc(pattern->length + 1);
+  pattern->buffer = (unsigned char *)malloc(pattern->buffer_size);
+  if (pattern->text == NULL || pattern->buffer == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    content_pattern_free(pattern);
+    return NULL;
+  }
+  for (int i = 0; i <= pattern->length; i++) {
+    pattern->text[i] = pattern->fold[(unsigned char)text[i]];
+  }
+
+  // 末尾の文字が文字列中に最後に現れる位置から末尾までの距離だけずらす
+  // (現れない文字は文字列の長さだけずらす)
+  for (int c = 0; c < 256; c++) {
+    pattern->skip[c] = pattern->length;
+  }
+  for (int i = 0; i < pattern->length - 1; i++) {
+    for (int c = 0; c < 256; c++) {
+      if (pattern->fold[c] == pattern->text[i]) {
+        pattern->skip[c] = pattern->length - 1 - i;
+      }
+    }
+  }
+  return pattern;
+}
+
+/**
+ * @brief バッファに文字列が含まれるかどうかを判定する
+ *
+ * @param[in] pattern 準備した文字列
+ * @param[in] data 判定するデータ
+ * @param[in] size data のバイト数
+ * @return 含まれる場合は 1、含まれない場合は 0
+ */
+static int search_buffer(const ContentPattern *pattern,
+                         const unsigned char *data, const int size) {
+  const int last = pattern->length - 1;
+
+  for (int pos = 0; pos + last < size;
+       pos += pattern->skip[data[pos + last]]) {
+    int i = last;
+    while (i >= 0 && pattern->fold[data[pos + i]] == pattern->text[i]) {
+      i--;
+    }
+    if (i < 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int content_pattern_search_stream(const ContentPattern *pattern,
+                                  FILE *stream) {
+  unsigned char *buffer = pattern->buffer;
+  int kept = 0;
+
+  if (pattern->length == 0) {
+    return 1;
+  }
+
+  // 読み込みの境界をまたいで一致する場合のため、前回の末尾の
+  // (文字列の長さ - 1) バイトを残して続きを読む
+  for (;;) {
+    int read =
+        fread(buffer + kept, 1, pattern->buffer_size - kept, stream);
+    if (read <= 0) {
+      return 0;
+    }
+    int size = kept + read;
+    if (search_buffer(pattern, buffer, size)) {
+      return 1;
+    }
+    kept = (size < pattern->length - 1) ? size : pattern->length - 1;
+    memmove(buffer, buffer + size - kept, kept);
+  }
+}
+
+int content_pattern_search_file(const ContentPattern *pattern,
+                                const char *path) {
+  FILE *stream = fopen(path, "rb");
+  if (stream == NULL) {
+    return 0;
+  }
+  // 大きな単位で直接読み込むため、ストリームのバッファは使わない
+  setvbuf(stream, NULL, _IONBF, 0);
+  int found = content_pattern_search_stream(pattern, stream);
+  fclose(stream);
+  return found;
+}
+
+void content_pattern_free(ContentPattern *pattern) {
+  if (pattern == NULL) {
+    return;
+  }
+  free(pattern->text);
+  free(pattern->buffer);
+  free(pattern);
+}
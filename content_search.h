@@ -0,0 +1,48 @@
+#ifndef CONTENT_SEARCH_H
+#define CONTENT_SEARCH_H
+
+#include <stdio.h>
+
+#include "efind.h"
+
+/**
+ * @brief -contains / -icontains で探す文字列を準備する
+ *
+ * 文字列の照合に使うずらし量の表 (Boyer-Moore-Horspool 法) と読み込み用の
+ * バッファを引数解析時に 1 回だけ作成する
+ *
+ * @param[in] text 探す文字列
+ * @param[in] ignore_case 英字の大文字小文字を区別しない場合は 1
+ * @return 準備した文字列、メモリ不足の場合は NULL
+ */
+ContentPattern *content_pattern_compile(const char *text, int ignore_case);
+
+/**
+ * @brief ストリームの内容に文字列が含まれるかどうかを判定する
+ *
+ * 大きな単位で先頭から順に読み込み、最初に見つかった時点で読み込みを止める
+ *
+ * @param[in] pattern 準備した文字列
+ * @param[in] stream 読み込むストリーム
+ * @return 含まれる場合は 1、含まれない場合は 0
+ */
+int content_pattern_search_stream(const ContentPattern *pattern, FILE *stream);
+
+/**
+ * @brief ファイルの内容に文字列が含まれるかどうかを判定する
+ *
+ * @param[in] pattern 準備した文字列
+ * @param[in] path ファイルのパス
+ * @return 含まれる場合は 1、含まれないか読み込めない場合は 0
+ */
+int content_pattern_search_file(const ContentPattern *pattern,
+                                const char *path);
+
+/**
+ * @brief 準備した文字列を解放する
+ *
+ * @param[in] pattern 解放する文字列 (NULL の場合は何もしない)
+ */
+void content_pattern_free(ContentPattern *pattern);
+
+#endif /* CONTENT_SEARCH_H */
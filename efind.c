@@ -11,17 +11,59 @@
 #include <string.h>
 
 #include "arch.h"
+#include "content_search.h"
 
 /**
- * @brief ディレクトリエントリを保持する構造体
+ * @brief エントリの集合を表すビットマスクの 1 ワード
  *
- * ディレクトリ内のエントリ情報を格納するために使用するフィールドにはエントリ名や属性などが含まれる
+ * i 番目のエントリはワード i / MASK_BITS のビット i % MASK_BITS に対応する
+ */
+typedef unsigned long MaskWord;
+
+#define MASK_BITS ((int)(sizeof(MaskWord) * 8))            // 1 ワードのビット数
+#define MASK_WORDS(n) (((n) + MASK_BITS - 1) / MASK_BITS)  // n ビットに必要なワード数
+#define MASK_TEST(mask, i) (((mask)[(i) / MASK_BITS] >> ((i) % MASK_BITS)) & 1)
+#define MASK_SET(mask, i) \
+  ((mask)[(i) / MASK_BITS] |= (MaskWord)1 << ((i) % MASK_BITS))
+
+/**
+ * @brief 1 ディレクトリ分のエントリを列ごとに保持する構造体
+ *
+ * エントリごとの構造体の配列ではなく、項目ごとに連続した配列
+ * (ファイル名は NUL 区切りで連結したバッファ、ディレクトリかどうかはビット集合)
+ * として保持し、条件をエントリの集合全体に対してまとめて評価できるようにする
  */
 typedef struct {
-  char name[256];  // ファイル名 (最大長を確保)
-  int is_dir;      // ディレクトリかどうかのフラグ
-  int attributes;  // 属性フラグ (FILE_ATTR_* の組み合わせ)
-} DirEntry;
+  int count;                  // エントリ数
+  int capacity;               // エントリ単位の容量
+  char *names;                // ファイル名を NUL 区切りで連結したバッファ
+  int names_size;             // names の使用バイト数
+  int names_capacity;         // names の容量
+  int *name_offsets;          // ファイル名の names 内での位置 (count + 1 個)
+  const char *prefix;         // パスのうちファイル名より前の部分
+  int prefix_len;             // prefix のバイト数
+  const int *path_states;     // 条件ごとの prefix まで照合したパスの照合状態
+  unsigned char *attributes;  // 属性フラグ (FILE_ATTR_* の組み合わせ)
+  MaskWord *is_dir;           // ディレクトリかどうかのビット集合
+  MaskWord *symlink;          // シンボリックリンクかどうかのビット集合 (評価用)
+  MaskWord *executable;       // 実行属性があるかどうかのビット集合 (評価用)
+  MaskWord *match;            // 条件に一致したかどうかのビット集合 (評価結果)
+  MaskWord *scratch;          // 評価中に使用する作業用のビット集合
+  FileInfo *infos;            // メタデータ (必要になった時点で確保)
+  MaskWord *info_loaded;      // メタデータの取得を試みたかどうかのビット集合
+  MaskWord *info_valid;       // メタデータを取得できたかどうかのビット集合
+} EntryBatch;
+
+/**
+ * @brief i 番目のエントリのファイル名を取得する
+ */
+#define BATCH_NAME(batch, i) ((batch)->names + (batch)->name_offsets[i])
+
+/**
+ * @brief i 番目のエントリのファイル名のバイト数を取得する
+ */
+#define BATCH_NAME_LEN(batch, i) \
+  ((batch)->name_offsets[(i) + 1] - (batch)->name_offsets[i] - 1)
 
 /**
  * @brief パターンマッチングを行う
@@ -98,356 +140,2700 @@ static int match_pattern(const char *pattern, const char *string,
   return !mbsnextc(p);
 }
 
-/**
- * @brief 指定された条件を評価する
- *
- * ディレクトリエントリに基づいて、指定された条件を評価し、条件を満たすかどうかを判定する
- *
- * @param[in] entry 評価対象のディレクトリエントリ
- * @param[in] opts 評価基準を含む Options 構造体へのポインタ
- * @param[in] fs_ignore_case ファイルシステムが大文字小文字を区別しない場合は
- * 1、区別する場合は 0
- * @return 条件を満たす場合は 1 を返し、満たさない場合は 0
- */
-static int evaluate_conditions(const DirEntry *entry, const Options *opts,
-                               const int fs_ignore_case) {
-  // 条件が指定されていない場合はすべて一致とみなす
-  if (opts->condition_count == 0) {
-    return 1;  // 条件がない場合はすべて一致
+void analyze_name_pattern(Condition *cond) {
+  if (cond->pattern == NULL) {
+    return;
   }
 
-  int result = 0;
-  Operator current_op = OP_AND;
+  const unsigned char *p = (const unsigned char *)cond->pattern;
+  const unsigned char *lit_begin = NULL;  // リテラル部分の先頭
+  const unsigned char *lit_end = NULL;    // リテラル部分の末尾の次
+  int leading_star = 0;                   // 先頭に '*' があるか
+  int trailing_star = 0;                  // リテラルの後ろに '*' があるか
+  unsigned int c;
 
-  // 各条件を順に評価
-  for (int i = 0; i < opts->condition_count; i++) {
-    int match = 1;
-    const Condition *cond = &opts->conditions[i];
+  cond->shape = SHAPE_GENERIC;
+  cond->literal = NULL;
+  cond->literal_len = 0;
 
-    // ファイルタイプのチェック
-    if (cond->type != TYPE_NONE) {
-      if (cond->type == TYPE_FILE &&
-          (entry->is_dir || (entry->attributes & FILE_ATTR_SYMLINK))) {
-        match = 0;
-      } else if (cond->type == TYPE_DIR &&
-                 (!entry->is_dir || (entry->attributes & FILE_ATTR_SYMLINK))) {
-        match = 0;
-      } else if (cond->type == TYPE_SYMLINK &&
-                 !(entry->attributes & FILE_ATTR_SYMLINK)) {
-        match = 0;
-      } else if (cond->type == TYPE_EXECUTABLE &&
-                 !(entry->attributes & FILE_ATTR_EXECUTABLE)) {
-        match = 0;
-      }
+  // match_pattern と同じく文字単位で走査し、 '*' と '?' の位置を調べる
+  while ((c = mbsnextc(p))) {
+    if (c == '?') {
+      return;  // '?' を含むパターンは汎用照合
     }
-
-    // 名前パターンのチェック
-    if (cond->pattern != NULL) {
-      if (!match_pattern(cond->pattern, entry->name, cond->ignore_case,
-                         fs_ignore_case)) {
-        match = 0;
+    if (c == '*') {
+      if (lit_begin == NULL) {
+        leading_star = 1;
+      } else {
+        trailing_star = 1;
+      }
+    } else {
+      if (trailing_star) {
+        return;  // リテラルの途中に '*' がある
+      }
+      if (lit_begin == NULL) {
+        lit_begin = p;
       }
+      lit_end = mbsinc((unsigned char *)p);
     }
+    p = mbsinc((unsigned char *)p);
+  }
 
-    // 演算子ロジックを適用
-    if (i == 0) {
-      result = match;
-    } else if (current_op == OP_AND) {
-      result = result && match;
-    } else if (current_op == OP_OR) {
-      result = result || match;
+  if (lit_begin == NULL) {
+    // '*' のみ (または空) のパターン
+    if (leading_star) {
+      cond->shape = SHAPE_ANY;
+    } else {
+      cond->shape = SHAPE_EXACT;
+      cond->literal = cond->pattern;
     }
-
-    // 次の条件のために演算子を設定
-    current_op = cond->op;
+    return;
   }
 
-  return result;
+  cond->literal = (const char *)lit_begin;
+  cond->literal_len = (int)(lit_end - lit_begin);
+  if (leading_star && trailing_star) {
+    cond->shape = SHAPE_INFIX;
+  } else if (leading_star) {
+    cond->shape = SHAPE_SUFFIX;
+  } else if (trailing_star) {
+    cond->shape = SHAPE_PREFIX;
+  } else {
+    cond->shape = SHAPE_EXACT;
+  }
 }
 
 /**
- * @brief asprintf 関数のラッパー
+ * @brief 文字境界から始まるバイト列とリテラルを比較する
  *
- * asprintf を呼び出し、エラー時にはメッセージを出力する
+ * s は文字境界を指していなければならない。大文字小文字を区別しない場合は、
+ * 1 バイト文字のみを小文字に変換して比較する (2 バイト文字の 2 バイト目は変換しない)
  *
- * @param[out] strp  確保された文字列を格納するポインタのアドレス
- * @param[in] fmt    書式指定文字列
- * @param[in] ...    可変引数
- * @return 成功時は文字数、失敗時は負の値
+ * @param[in] s 比較対象のバイト列 (len バイト以上)
+ * @param[in] lit リテラル
+ * @param[in] len リテラルのバイト数
+ * @param[in] ignore_case 大文字小文字を区別しない場合は 1、区別する場合は 0
+ * @return 一致する場合は非ゼロ値、一致しない場合は 0
  */
-static int alloc_formatted_string(char **strp, const char *fmt, ...) {
-  va_list ap;
-  int result;
+static int literal_equals(const unsigned char *s, const unsigned char *lit,
+                          const int len, const int ignore_case) {
+  if (!ignore_case) {
+    return memcmp(s, lit, len) == 0;
+  }
 
-  va_start(ap, fmt);
-  result = vasprintf(strp, fmt, ap);
-  va_end(ap);
+  int i = 0;
+  while (i < len) {
+    if (ismbblead(lit[i]) && i + 1 < len) {
+      // 2 バイト文字はそのまま比較
+      if (s[i] != lit[i] || s[i + 1] != lit[i + 1]) {
+        return 0;
+      }
+      i += 2;
+    } else {
+      if (tolower(s[i]) != tolower(lit[i])) {
+        return 0;
+      }
+      i++;
+    }
+  }
+  return 1;
+}
 
-  if (result == -1) {
-    fprintf(stderr, "Memory allocation error\n");
-    *strp = NULL;
+/**
+ * @brief 指定位置が文字境界かどうかを判定する
+ *
+ * SJIS の 2 バイト目は 1 バイト文字と区別できないため、先頭から走査して判定する
+ *
+ * @param[in] s 文字列の先頭
+ * @param[in] pos 判定する位置
+ * @return 文字境界の場合は非ゼロ値、それ以外は 0
+ */
+static int is_char_boundary(const unsigned char *s, const unsigned char *pos) {
+  while (s < pos) {
+    s += (ismbblead(*s) && s[1]) ? 2 : 1;
   }
+  return s == pos;
+}
 
-  return result;
+/**
+ * @brief 文字列の末尾がリテラルと一致するかを判定する ("*literal" 用)
+ *
+ * 末尾のバイト比較で候補を絞り込んでから、一致位置が文字境界かどうかを確認する
+ *
+ * @param[in] s 比較対象の文字列
+ * @param[in] s_len 文字列のバイト数
+ * @param[in] lit リテラル
+ * @param[in] lit_len リテラルのバイト数
+ * @param[in] ignore_case 大文字小文字を区別しない場合は 1、区別する場合は 0
+ * @return 一致する場合は非ゼロ値、一致しない場合は 0
+ */
+static int match_suffix(const unsigned char *s, const int s_len,
+                        const unsigned char *lit, const int lit_len,
+                        const int ignore_case) {
+  if (lit_len > s_len) {
+    return 0;
+  }
+  const unsigned char *pos = s + s_len - lit_len;
+  return literal_equals(pos, lit, lit_len, ignore_case) &&
+         is_char_boundary(s, pos);
 }
 
 /**
- * @brief ファイル属性チェックが必要かどうかを判定する
+ * @brief 文字列がリテラルを含むかどうかを判定する ("*literal*" 用)
  *
- * Options 構造体を調べ、シンボリックリンクや実行可能ファイルなど
- * ファイル属性の検索条件が含まれているかを確認する
+ * 大文字小文字を区別する場合は memchr で先頭バイトの候補位置まで読み飛ばし、
+ * 文字境界の位置は候補位置までまとめて進める。
+ * 2 バイト文字の 2 バイト目から始まる一致は採用しない
  *
- * @param[in] opts 検索オプション構造体へのポインタ
- * @return ファイル属性の検索が必要な場合は 1、それ以外は 0
+ * @param[in] s 比較対象の文字列
+ * @param[in] s_len 文字列のバイト数
+ * @param[in] lit リテラル (1 バイト以上)
+ * @param[in] lit_len リテラルのバイト数
+ * @param[in] ignore_case 大文字小文字を区別しない場合は 1、区別する場合は 0
+ * @return 含む場合は非ゼロ値、含まない場合は 0
  */
-static int needs_file_attribute_check(const Options *opts) {
-  if (opts == NULL || opts->condition_count == 0) {
+static int match_infix(const unsigned char *s, const int s_len,
+                       const unsigned char *lit, const int lit_len,
+                       const int ignore_case) {
+  if (lit_len > s_len) {
     return 0;
   }
 
-  // 各条件を調べ、TYPE_SYMLINK または TYPE_EXECUTABLE があるか確認
-  for (int i = 0; i < opts->condition_count; i++) {
-    if (opts->conditions[i].type == TYPE_SYMLINK ||
-        opts->conditions[i].type == TYPE_EXECUTABLE) {
-      return 1;
+  const unsigned char *last = s + s_len - lit_len;  // 一致を開始できる最後の位置
+  const unsigned char *boundary = s;                // 既知の文字境界
+
+  if (!ignore_case || !isalpha(lit[0])) {
+    const unsigned char *p = s;
+    while (p <= last) {
+      const unsigned char *hit = memchr(p, lit[0], last - p + 1);
+      if (hit == NULL) {
+        return 0;
+      }
+      while (boundary < hit) {
+        boundary += (ismbblead(*boundary) && boundary[1]) ? 2 : 1;
+      }
+      if (boundary == hit &&
+          literal_equals(hit, lit, lit_len, ignore_case)) {
+        return 1;
+      }
+      p = hit + 1;
     }
+    return 0;
   }
 
+  // 先頭がアルファベットで大文字小文字を区別しない場合は文字境界ごとに比較する
+  const int first = tolower(lit[0]);
+  while (boundary <= last) {
+    if (tolower(*boundary) == first &&
+        literal_equals(boundary, lit, lit_len, ignore_case)) {
+      return 1;
+    }
+    boundary += (ismbblead(*boundary) && boundary[1]) ? 2 : 1;
+  }
   return 0;
 }
 
 /**
- * @brief ディレクトリからエントリを収集する
+ * @brief 条件の名前パターンとファイル名を照合する
  *
- * 指定されたディレクトリからすべてのエントリを読み込み、配列に格納する
+ * analyze_name_pattern で判定した形状に応じて専用の照合処理を使い、
+ * 汎用のパターンの場合は match_pattern を呼び出す
  *
- * @param[in] dir_path 検索対象のディレクトリパス
- * @param[out] entries_ptr
- * 収集されたエントリの配列へのポインタ (関数内で割り当て)
- * @param[in] opts 検索オプション構造体へのポインタ
- * @return 成功時は収集されたエントリ数、失敗時は負の値
+ * @param[in] cond 照合する条件 (pattern が NULL でないこと)
+ * @param[in] name ファイル名
+ * @param[in] name_len ファイル名のバイト数
+ * @param[in] fs_ignore_case ファイルシステムが大文字小文字を区別しない場合は
+ * 1、区別する場合は 0
+ * @return 一致する場合は非ゼロ値、一致しない場合は 0
  */
-static int collect_directory_entries(const char *dir_path,
-                                     DirEntry **entries_ptr,
-                                     const Options *opts) {
-  DIR *dir;
-  struct dirent *entry;
-  DirEntry *entries = NULL;
-  int entry_count = 0;
-  int entry_capacity = 0;
-  char *full_path = NULL;  // 動的に確保するように変更
-  int check_attributes =
-      needs_file_attribute_check(opts);  // ファイル属性のチェックが必要かどうか
+static int match_name_condition(const Condition *cond, const char *name,
+                                const int name_len, const int fs_ignore_case) {
+  const int ignore_case = cond->ignore_case || fs_ignore_case;
+  const unsigned char *s = (const unsigned char *)name;
+  const unsigned char *lit = (const unsigned char *)cond->literal;
 
-  // ディレクトリを開いてエントリを収集
-  if ((dir = opendir(dir_path)) == NULL) {
-    fprintf(stderr, "Cannot open directory '%s': %s\n", dir_path,
-            strerror(errno));
-    return -1;
+  switch (cond->shape) {
+    case SHAPE_ANY:
+      return 1;
+    case SHAPE_EXACT:
+      return name_len == cond->literal_len &&
+             literal_equals(s, lit, name_len, ignore_case);
+    case SHAPE_PREFIX:
+      // リテラルは文字単位で一致するため、一致の末尾は必ず文字境界になる
+      return name_len >= cond->literal_len &&
+             literal_equals(s, lit, cond->literal_len, ignore_case);
+    case SHAPE_SUFFIX:
+      return match_suffix(s, name_len, lit, cond->literal_len, ignore_case);
+    case SHAPE_INFIX:
+      return match_infix(s, name_len, lit, cond->literal_len, ignore_case);
+    default:
+      return match_pattern(cond->pattern, name, cond->ignore_case,
+                           fs_ignore_case);
   }
+}
 
-  // 収集するエントリ用の初期メモリを確保
-  entry_capacity = 128;  // 初期容量
-  entries = (DirEntry *)malloc(sizeof(DirEntry) * entry_capacity);
-  if (entries == NULL) {
+/**
+ * @brief エントリ集合を初期化する
+ *
+ * @param[out] batch 初期化するエントリ集合
+ * @return 成功時は 1、失敗時は 0
+ */
+static int batch_init(EntryBatch *batch) {
+  memset(batch, 0, sizeof(*batch));
+  batch->name_offsets = (int *)malloc(sizeof(int));
+  if (batch->name_offsets == NULL) {
     fprintf(stderr, "Memory allocation error\n");
-    closedir(dir);
-    return -1;
+    return 0;
   }
+  batch->name_offsets[0] = 0;
+  return 1;
+}
 
-  // ディレクトリエントリを読み込む ("." と ".." を除く)
-  while ((entry = readdir(dir)) != NULL) {
-    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-      continue;
-    }
+/**
+ * @brief エントリ集合を解放する
+ *
+ * @param[in,out] batch 解放するエントリ集合
+ */
+static void batch_free(EntryBatch *batch) {
+  free(batch->names);
+  free(batch->name_offsets);
+  free(batch->attributes);
+  free(batch->is_dir);
+  free(batch->symlink);
+  free(batch->executable);
+  free(batch->match);
+  free(batch->scratch);
+  free(batch->infos);
+  free(batch->info_loaded);
+  free(batch->info_valid);
+  memset(batch, 0, sizeof(*batch));
+}
 
-    // エントリリストの拡張が必要な場合
-    if (entry_count >= entry_capacity) {
-      entry_capacity *= 2;
-      DirEntry *new_entries =
-          (DirEntry *)realloc(entries, sizeof(DirEntry) * entry_capacity);
-      if (new_entries == NULL) {
-        fprintf(stderr, "Memory allocation error during expansion\n");
-        free(entries);
-        closedir(dir);
-        return -1;
-      }
-      entries = new_entries;
-    }
+/**
+ * @brief ビット集合の配列を拡張する
+ *
+ * 拡張した部分は 0 で初期化する
+ *
+ * @param[in,out] mask 拡張するビット集合へのポインタ
+ * @param[in] old_capacity 拡張前の容量 (エントリ数)
+ * @param[in] new_capacity 拡張後の容量 (エントリ数)
+ * @return 成功時は 1、失敗時は 0
+ */
+static int grow_mask(MaskWord **mask, const int old_capacity,
+                     const int new_capacity) {
+  int old_words = MASK_WORDS(old_capacity);
+  int new_words = MASK_WORDS(new_capacity);
+  MaskWord *new_mask =
+      (MaskWord *)realloc(*mask, sizeof(MaskWord) * new_words);
+  if (new_mask == NULL) {
+    return 0;
+  }
+  memset(new_mask + old_words, 0, sizeof(MaskWord) * (new_words - old_words));
+  *mask = new_mask;
+  return 1;
+}
 
-    // エントリ名をコピー
-    strncpy(entries[entry_count].name, entry->d_name,
-            sizeof(entries[entry_count].name) - 1);
-    entries[entry_count].name[sizeof(entries[entry_count].name) - 1] =
-        '\0';  // NULL終端を保証
+/**
+ * @brief エントリ集合にエントリを追加する
+ *
+ * @param[in,out] batch 追加先のエントリ集合
+ * @param[in] name ファイル名
+ * @param[in] is_dir ディレクトリの場合は非ゼロ値
+ * @param[in] attributes 属性フラグ (FILE_ATTR_* の組み合わせ)
+ * @return 成功時は 1、失敗時は 0
+ */
+static int batch_add_entry(EntryBatch *batch, const char *name,
+                           const int is_dir, const int attributes) {
+  int name_size = strlen(name) + 1;
 
-    // 完全パスを構築 (alloc_formatted_string を使用)
-    if (alloc_formatted_string(&full_path, "%s/%s", dir_path, entry->d_name) <
-        0) {
-      // メモリ確保に失敗した場合
-      fprintf(stderr, "Memory allocation error for path\n");
-      free(entries);
-      closedir(dir);
-      return -1;
+  // エントリ単位の配列の拡張が必要な場合
+  if (batch->count >= batch->capacity) {
+    int new_capacity = batch->capacity ? batch->capacity * 2 : 128;
+    int *new_offsets = (int *)realloc(batch->name_offsets,
+                                      sizeof(int) * (new_capacity + 1));
+    if (new_offsets == NULL) {
+      fprintf(stderr, "Memory allocation error during expansion\n");
+      return 0;
     }
+    batch->name_offsets = new_offsets;
 
-    // ディレクトリかどうかの判定
-    entries[entry_count].is_dir = is_directory_entry(entry);
-
-    // 属性情報の取得と設定 (属性チェックが必要な場合のみ)
-    if (check_attributes) {
-      entries[entry_count].attributes = get_file_attributes(full_path);
-    } else {
-      entries[entry_count].attributes = 0;
+    unsigned char *new_attributes =
+        (unsigned char *)realloc(batch->attributes, new_capacity);
+    if (new_attributes == NULL) {
+      fprintf(stderr, "Memory allocation error during expansion\n");
+      return 0;
     }
+    batch->attributes = new_attributes;
 
-    // 不要になったパスを解放
-    free(full_path);
-    full_path = NULL;
+    if (!grow_mask(&batch->is_dir, batch->capacity, new_capacity) ||
+        !grow_mask(&batch->symlink, batch->capacity, new_capacity) ||
+        !grow_mask(&batch->executable, batch->capacity, new_capacity) ||
+        !grow_mask(&batch->match, batch->capacity, new_capacity) ||
+        !grow_mask(&batch->scratch, batch->capacity, new_capacity)) {
+      fprintf(stderr, "Memory allocation error during expansion\n");
+      return 0;
+    }
+    batch->capacity = new_capacity;
+  }
 
-    entry_count++;
+  // ファイル名バッファの拡張が必要な場合
+  if (batch->names_size + name_size > batch->names_capacity) {
+    int new_capacity = batch->names_capacity ? batch->names_capacity : 4096;
+    while (batch->names_size + name_size > new_capacity) {
+      new_capacity *= 2;
+    }
+    char *new_names = (char *)realloc(batch->names, new_capacity);
+    if (new_names == NULL) {
+      fprintf(stderr, "Memory allocation error during expansion\n");
+      return 0;
+    }
+    batch->names = new_names;
+    batch->names_capacity = new_capacity;
   }
 
-  // ディレクトリハンドルはもう必要ないので閉じる
-  closedir(dir);
+  int i = batch->count;
+  memcpy(batch->names + batch->names_size, name, name_size);
+  batch->names_size += name_size;
+  batch->name_offsets[i + 1] = batch->names_size;
+  batch->attributes[i] = (unsigned char)attributes;
+  if (is_dir) {
+    MASK_SET(batch->is_dir, i);
+  }
+  batch->count++;
 
-  *entries_ptr = entries;
-  return entry_count;
+  return 1;
 }
 
 /**
- * @brief 通常ファイルを処理する
+ * @brief エントリを並べ替える際のキー
  *
- * 通常ファイルに対して条件評価を行い、条件に合致する場合は表示する
+ * @struct SortKey
+ */
+typedef struct {
+  unsigned long head;  // ファイル名の先頭 4 バイト (先頭のバイトが上位)
+  const char *name;    // ファイル名
+  int size;            // ファイル名の NUL を含むバイト数
+  int index;           // 並べ替える前のインデックス
+} SortKey;
+
+/**
+ * @brief 並べ替えのキーを比較する
  *
- * @param[in] file_path 処理対象ファイルのパス
- * @param[in] opts 検索オプション構造体へのポインタ
- * @param[in] fs_ignore_case ファイルシステムが大文字小文字を区別しない場合は
- * 1、区別する場合は 0
- * @return 常に 0 を返す (正常終了)
+ * 多くの場合は先頭 4 バイトの比較だけで決まり、ファイル名を読まずに済む
+ *
+ * @param[in] a キー
+ * @param[in] b キー
+ * @return a が前の場合は負の値、同じ場合は 0、後の場合は正の値
  */
-static int process_regular_file(const char *file_path, const Options *opts,
-                                const int fs_ignore_case) {
-  // 通常ファイル用の DirEntry を作成
-  DirEntry file_entry;
-  char *file_name = strrchr(file_path, '/');
+static int compare_sort_keys(const void *a, const void *b) {
+  const SortKey *key_a = (const SortKey *)a;
+  const SortKey *key_b = (const SortKey *)b;
 
-  if (file_name == NULL) {
-    file_name = strrchr(file_path, '\\');
+  if (key_a->head != key_b->head) {
+    return (key_a->head < key_b->head) ? -1 : 1;
   }
+  return strcmp(key_a->name, key_b->name);
+}
 
-  // ファイル名部分を取得 (パス区切り文字がない場合はパス全体がファイル名)
-  if (file_name == NULL) {
-    file_name = (char *)file_path;
-  } else {
-    file_name++;  // パス区切り文字をスキップ
+/**
+ * @brief エントリをファイル名のバイト順に並べ替える (-s)
+ *
+ * シフト JIS のバイト順は JIS の文字コード順と一致するため、2 バイト文字も
+ * 文字コード順に並ぶ。並べ替えた順にファイル名のバッファを詰め直すので、
+ * 以降の処理は並べ替える前と同じように連続したファイル名を参照する。
+ * 条件を評価する前 (メタデータや評価結果がない状態) に呼び出す
+ *
+ * @param[in,out] batch 並べ替えるエントリ集合
+ * @return 成功時は 1、メモリ不足の場合は 0
+ */
+static int batch_sort(EntryBatch *batch) {
+  const int count = batch->count;
+  const int words = MASK_WORDS(count);
+
+  if (count < 2) {
+    return 1;
   }
 
-  // ファイルエントリ情報を設定
-  strncpy(file_entry.name, file_name, sizeof(file_entry.name) - 1);
-  file_entry.name[sizeof(file_entry.name) - 1] = '\0';  // NULL 終端を保証
-  file_entry.is_dir = 0;                                // 通常ファイル
+  SortKey *keys = (SortKey *)malloc(sizeof(SortKey) * count);
+  char *names = (char *)malloc(batch->names_capacity);
+  unsigned char *attributes = (unsigned char *)malloc(count);
+  MaskWord *is_dir = (MaskWord *)malloc(sizeof(MaskWord) * words);
+  if (keys == NULL || names == NULL || attributes == NULL || is_dir == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    free(keys);
+    free(names);
+    free(attributes);
+    free(is_dir);
+    return 0;
+  }
 
-  // ファイル属性のチェックが必要な場合のみ属性を取得
-  if (needs_file_attribute_check(opts)) {
-    file_entry.attributes = get_file_attributes(file_path);
-  } else {
-    file_entry.attributes = 0;
+  for (int i = 0; i < count; i++) {
+    const unsigned char *name = (const unsigned char *)BATCH_NAME(batch, i);
+    unsigned long head = 0;
+    for (int k = 0, end = 0; k < 4; k++) {
+      end = end || name[k] == '\0';
+      head = (head << 8) | (end ? 0 : name[k]);
+    }
+    keys[i].head = head;
+    keys[i].name = (const char *)name;
+    keys[i].size = BATCH_NAME_LEN(batch, i) + 1;
+    keys[i].index = i;
   }
+  qsort(keys, count, sizeof(SortKey), compare_sort_keys);
 
-  // 条件に合致するか評価して表示
-  if (evaluate_conditions(&file_entry, opts, fs_ignore_case)) {
-    printf("%s\n", file_path);
+  // 並べ替えた順にファイル名・属性・ディレクトリかどうかを詰め直す
+  memcpy(attributes, batch->attributes, count);
+  memcpy(is_dir, batch->is_dir, sizeof(MaskWord) * words);
+  memset(batch->is_dir, 0, sizeof(MaskWord) * words);
+  int names_size = 0;
+  for (int i = 0; i < count; i++) {
+    int from = keys[i].index;
+    memcpy(names + names_size, keys[i].name, keys[i].size);
+    batch->name_offsets[i] = names_size;
+    batch->attributes[i] = attributes[from];
+    if (MASK_TEST(is_dir, from)) {
+      MASK_SET(batch->is_dir, i);
+    }
+    names_size += keys[i].size;
   }
+  batch->name_offsets[count] = names_size;
+  free(batch->names);
+  batch->names = names;
 
-  return 0;
+  free(keys);
+  free(attributes);
+  free(is_dir);
+  return 1;
+}
+
+/**
+ * @brief ファイルタイプの条件に一致するエントリのビット集合を 1 ワード分求める
+ *
+ * @param[in] batch 評価対象のエントリ集合
+ * @param[in] type 評価するファイルタイプ
+ * @param[in] w ワード位置
+ * @return 一致するエントリのビットが立ったワード
+ */
+static MaskWord type_mask_word(const EntryBatch *batch, const FileType type,
+                               const int w) {
+  switch (type) {
+    case TYPE_FILE:
+      return ~(batch->is_dir[w] | batch->symlink[w]);
+    case TYPE_DIR:
+      return batch->is_dir[w] & ~batch->symlink[w];
+    case TYPE_SYMLINK:
+      return batch->symlink[w];
+    case TYPE_EXECUTABLE:
+      return batch->executable[w];
+    default:
+      return ~(MaskWord)0;
+  }
 }
 
 /**
- * @brief ディレクトリを処理する
+ * @brief 条件の評価順を入れ替える間隔 (評価したエントリ数)
+ */
+#define REORDER_INTERVAL 256
+
+/**
+ * @brief 評価手順の 1 ステップを表す構造体
  *
- * ディレクトリ内のエントリを収集し、条件に合致するものを表示する
- * また、サブディレクトリがある場合は再帰的に処理する
+ * @struct EvalStep
+ */
+typedef struct {
+  int cond_index;  // 評価する条件のインデックス
+  Operator op;     // それまでの結果との結合方法 (OP_AND または OP_OR)
+  int deferred;    // ファイルを読む条件で、 AND の並びの最後に評価する場合は 1
+} EvalStep;
+
+/**
+ * @brief 条件ごとの評価統計を表す構造体
  *
- * @param[in] dir_path 処理対象ディレクトリのパス
- * @param[in] current_depth 現在の再帰深度
- * @param[in] opts 検索オプション構造体へのポインタ
- * @param[in] fs_ignore_case ファイルシステムが大文字小文字を区別しない場合は
- * 1、区別する場合は 0
- * @return 成功時は 0、エラー時は 1
+ * @struct EvalStats
  */
-static int process_directory(const char *dir_path, const int current_depth,
-                             const Options *opts, const int fs_ignore_case) {
-  DirEntry *entries = NULL;
-  int entry_count = 0;
-  int return_status = 0;
-  char *dir_path_tmp = NULL;
+typedef struct {
+  long tested;  // 評価したエントリ数
+  long passed;  // 条件を満たしたエントリ数
+  long cost;    // 評価にかかった作業量の見積もりの合計
+} EvalStats;
 
-  if (alloc_formatted_string(       //
-          &dir_path_tmp, "%s%s%s",  //
-          dir_path,                 //
-          should_append_dot(dir_path) ? "." : "",
-          is_path_end_with_separator(dir_path) ? "" : "/") < 0) {
-    return 1;
+/**
+ * @brief 条件の評価手順を表す構造体
+ *
+ * 条件は左から順に結合されるため、結果は「すべて真」から始めて各条件を
+ * AND / OR で順に結合したものと等しい。連続する AND のステップは入れ替えても
+ * 結果が変わらないので、評価中に集計したコストと通過率に基づいて、
+ * 安くてよく絞り込める条件が先に評価されるよう並べ替える
+ *
+ * @struct EvalPlan
+ */
+typedef struct {
+  int step_count;                   // ステップ数
+  EvalStep steps[MAX_CONDITIONS];   // 評価手順
+  EvalStats stats[MAX_CONDITIONS];  // 条件ごとの評価統計
+  long tested_since_reorder;        // 前回の並べ替え以降に評価したエントリ数
+} EvalPlan;
+
+static void plan_reorder(EvalPlan *plan);
+
+/**
+ * @brief 評価手順を初期化する
+ *
+ * 初期状態ではコマンドラインで指定された順に評価する。ただし、ファイルの
+ * 内容を読む条件は最初から AND の並びの最後に移す
+ *
+ * @param[out] plan 初期化する評価手順
+ * @param[in] opts 検索オプション構造体へのポインタ
+ */
+static void plan_init(EvalPlan *plan, const Options *opts) {
+  memset(plan, 0, sizeof(*plan));
+  plan->step_count = opts->condition_count;
+  for (int i = 0; i < opts->condition_count; i++) {
+    plan->steps[i].cond_index = i;
+    plan->steps[i].op = (i == 0) ? OP_AND : opts->conditions[i - 1].op;
+    plan->steps[i].deferred = opts->conditions[i].content != NULL;
   }
+  plan_reorder(plan);
+}
 
-  if (opts->maxdepth >= 0 && current_depth > opts->maxdepth - 1) {
-    free(dir_path_tmp);
-    return 0;
+/**
+ * @brief 名前パターンを 1 エントリ照合する際のコストの見積もりを返す
+ *
+ * ファイルタイプの条件はワード単位で評価できるため 1 とし、
+ * 名前パターンはパターンの形状とファイル名の長さに応じて見積もる
+ *
+ * @param[in] cond 条件
+ * @param[in] name_len ファイル名のバイト数
+ * @return コストの見積もり
+ */
+static int name_condition_cost(const Condition *cond, const int name_len) {
+  switch (cond->shape) {
+    case SHAPE_ANY:
+      return 1;
+    case SHAPE_EXACT:
+    case SHAPE_PREFIX:
+      return 2 + cond->literal_len;
+    case SHAPE_SUFFIX:
+      return 2 + cond->literal_len + name_len / 4;
+    case SHAPE_INFIX:
+      return 4 + name_len;
+    default:
+      return 8 + name_len * 2;
   }
+}
 
-  // ディレクトリからエントリを収集
-  entry_count = collect_directory_entries(dir_path_tmp, &entries, opts);
-  if (entry_count < 0) {
-    free(dir_path_tmp);
-    // 最初の呼び出し (current_depth == 0) でエラーの場合のみエラーコードを返す
-    return (current_depth == 0) ? 1 : 0;
+/**
+ * @brief 条件の評価順の優先度を比較するための値を求める
+ *
+ * AND で結合された条件の集合は、 1 エントリあたりのコストを
+ * 偽になる確率で割った値の小さい順に評価すると総コストが最小になる。
+ * 通過率はまだ評価していない条件でも極端にならないよう補正する
+ *
+ * @param[in] stats 条件の評価統計
+ * @return 優先度 (小さいほど先に評価する)
+ */
+static double step_rank(const EvalStats *stats) {
+  double cost = (stats->cost + 1.0) / (stats->tested + 1.0);
+  double pass_rate = (stats->passed + 1.0) / (stats->tested + 2.0);
+  return cost / (1.0 - pass_rate);
+}
+
+/**
+ * @brief ステップ a をステップ b より後に評価すべきかどうかを判定する
+ *
+ * ファイルの内容を読む条件は、統計に関わらず常に他の条件より後に評価する
+ *
+ * @param[in] plan 評価手順
+ * @param[in] a ステップ
+ * @param[in] b ステップ
+ * @return a を後に評価すべき場合は 1、そうでない場合は 0
+ */
+static int step_follows(const EvalPlan *plan, const EvalStep *a,
+                        const EvalStep *b) {
+  if (a->deferred != b->deferred) {
+    return a->deferred;
   }
+  return step_rank(&plan->stats[a->cond_index]) >
+         step_rank(&plan->stats[b->cond_index]);
+}
 
-  // 収集したエントリを処理
-  for (int i = 0; i < entry_count; i++) {
-    char *path = NULL;
-    // パスを結合
-    if (alloc_formatted_string(&path, "%s%s", dir_path_tmp, entries[i].name) <
-        0) {
+/**
+ * @brief 連続する AND のステップを評価統計に基づいて並べ替える
+ *
+ * OR のステップおよびその前後の順序は変更しない
+ *
+ * @param[in,out] plan 並べ替える評価手順
+ */
+static void plan_reorder(EvalPlan *plan) {
+  int start = 0;
+  while (start < plan->step_count) {
+    if (plan->steps[start].op != OP_AND) {
+      start++;
       continue;
     }
 
-    // 条件を評価して、マッチすれば出力
-    if (evaluate_conditions(&entries[i], opts, fs_ignore_case)) {
-      printf("%s\n", path);
+    // AND が連続する範囲 [start, end) を挿入ソートで並べ替える
+    int end = start + 1;
+    while (end < plan->step_count && plan->steps[end].op == OP_AND) {
+      end++;
     }
-
-    // ディレクトリなら再帰的に処理
-    if (entries[i].is_dir) {
-      search_directory(path, current_depth + 1, opts);
+    for (int i = start + 1; i < end; i++) {
+      EvalStep step = plan->steps[i];
+      int j = i - 1;
+      while (j >= start && step_follows(plan, &plan->steps[j], &step)) {
+        plan->steps[j + 1] = plan->steps[j];
+        j--;
+      }
+      plan->steps[j + 1] = step;
     }
 
-    free(path);
+    start = end;
   }
-
-  free(entries);
-  free(dir_path_tmp);
-
-  return return_status;
+  plan->tested_since_reorder = 0;
 }
 
-int search_directory(const char *base_dir, const int current_depth,
-                     const Options *opts) {
-  // ファイルシステムの大文字小文字の区別を検索開始時に 1 回だけチェック
+/**
+ * @brief エントリ単位で評価する条件 (名前パターン、正規表現) を評価する
+ *
+ * @param[in] batch 評価対象のエントリ集合
+ * @param[in] index 評価するエントリのインデックス
+ * @param[in] cond 評価する条件
+ * @param[in] path_state prefix まで照合したパスの照合状態
+ * (REGEX_STATE_UNKNOWN の場合はパス全体を先頭から照合する)
+ * @param[in,out] stats 条件の評価統計 (コストを加算する)
+ * @param[in] fs_ignore_case ファイルシステムが大文字小文字を区別しない場合は
+ * 1、区別する場合は 0
+ * @return 条件を満たす場合は非ゼロ値、満たさない場合は 0
+ */
+static int match_entry_condition(const EntryBatch *batch, const int index,
+                                 const Condition *cond, const int path_state,
+                                 EvalStats *stats, const int fs_ignore_case) {
+  const char *name = BATCH_NAME(batch, index);
+  int name_len = BATCH_NAME_LEN(batch, index);
+
+  if (cond->pattern != NULL) {
+    stats->cost += name_condition_cost(cond, name_len);
+    if (!match_name_condition(cond, name, name_len, fs_ignore_case)) {
+      return 0;
+    }
+  }
+
+  // 正規表現と -path はパス全体と照合する (DFA で 1 バイトずつ遷移する)。
+  // ディレクトリのパスまでの照合状態があればファイル名の部分だけを照合する
+  if (cond->regex != NULL) {
+    if (path_state != REGEX_STATE_UNKNOWN) {
+      stats->cost += 4 + name_len;
+      if (!regex_match_from(cond->regex, path_state, name)) {
+        return 0;
+      }
+    } else {
+      stats->cost += 4 + batch->prefix_len + name_len;
+      if (!regex_match(cond->regex, batch->prefix, name)) {
+        return 0;
+      }
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * @brief 属性やメタデータをまとめて取得するエントリ数の下限
+ *
+ * これより少ない場合はエントリごとに get_file_attributes / get_file_info で
+ * 取得する
+ */
+#define ATTRIBUTE_SCAN_MIN 8
+
+#define META_FETCH_COST 64  // メタデータを 1 エントリ分取得するコストの見積もり
+
+/**
+ * @brief scan_file_attributes の結果をエントリ集合に格納する際の状態
+ */
+typedef struct {
+  EntryBatch *batch;  // 属性を格納するエントリ集合
+  int cursor;         // 次に一致すると見込まれるエントリのインデックス
+} AttributeScan;
+
+/**
+ * @brief scan_file_attributes から通知されたエントリを探す
+ *
+ * ディレクトリの格納順と readdir の順は通常同じなので、前回見つけたエントリの
+ * 次から探す
+ *
+ * @param[in,out] scan 格納の状態
+ * @param[in] name エントリのファイル名
+ * @return エントリのインデックス、見つからない場合は -1
+ */
+static int find_scanned_entry(AttributeScan *scan, const char *name) {
+  EntryBatch *batch = scan->batch;
+
+  for (int n = 0; n < batch->count; n++) {
+    int i = (scan->cursor + n) % batch->count;
+    if (strcmp(BATCH_NAME(batch, i), name) == 0) {
+      scan->cursor = i + 1;
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief scan_file_attributes から通知されたメタデータをエントリに格納する
+ *
+ * @param[in] name エントリのファイル名
+ * @param[in] attributes 属性のビットフラグ (使用しない)
+ * @param[in] info エントリのメタデータ
+ * @param[in] user_data AttributeScan へのポインタ
+ */
+static void store_scanned_info(const char *name, int attributes,
+                               const FileInfo *info, void *user_data) {
+  AttributeScan *scan = (AttributeScan *)user_data;
+  EntryBatch *batch = scan->batch;
+  int i = find_scanned_entry(scan, name);
+
+  if (i >= 0 && !MASK_TEST(batch->info_loaded, i)) {
+    batch->infos[i] = *info;
+    MASK_SET(batch->info_loaded, i);
+    MASK_SET(batch->info_valid, i);
+  }
+}
+
+/**
+ * @brief エントリのパスを作成する
+ *
+ * @param[in] batch エントリ集合
+ * @param[in] index エントリのインデックス
+ * @return パス (呼び出し側で解放する)、メモリ不足の場合は NULL
+ */
+static char *batch_entry_path(const EntryBatch *batch, const int index) {
+  int name_len = BATCH_NAME_LEN(batch, index);
+  char *path = (char *)malloc(batch->prefix_len + name_len + 1);
+  if (path == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    return NULL;
+  }
+  memcpy(path, batch->prefix, batch->prefix_len);
+  memcpy(path + batch->prefix_len, BATCH_NAME(batch, index), name_len + 1);
+  return path;
+}
+
+/**
+ * @brief エントリのメタデータを取得する
+ *
+ * エントリごとに 1 回だけ取得し、結果は batch->infos に残す。取得する
+ * エントリが多い場合はディレクトリを 1 回だけ読んでまとめて取得する
+ *
+ * @param[in,out] batch エントリ集合
+ * @param[in] wanted メタデータが必要なエントリのビット集合
+ * @param[in] files_only ディレクトリを除く場合は 1
+ * @return 新たに取得したエントリ数、メモリ不足の場合は -1
+ */
+static int batch_load_info(EntryBatch *batch, const MaskWord *wanted,
+                           const int files_only) {
+  const int words = MASK_WORDS(batch->count);
+  int missing = 0;
+
+  if (batch->infos == NULL) {
+    batch->infos = (FileInfo *)malloc(sizeof(FileInfo) * batch->count);
+    batch->info_loaded = (MaskWord *)calloc(words, sizeof(MaskWord));
+    batch->info_valid = (MaskWord *)calloc(words, sizeof(MaskWord));
+    if (batch->infos == NULL || batch->info_loaded == NULL ||
+        batch->info_valid == NULL) {
+      fprintf(stderr, "Memory allocation error\n");
+      return -1;
+    }
+  }
+  for (int w = 0; w < words; w++) {
+    MaskWord bits = wanted[w] & ~batch->info_loaded[w];
+    if (files_only) {
+      bits &= ~batch->is_dir[w];
+    }
+    for (; bits; bits &= bits - 1) {
+      missing++;
+    }
+  }
+  if (missing >= ATTRIBUTE_SCAN_MIN) {
+    AttributeScan scan = {batch, 0};
+    scan_file_attributes(batch->prefix, store_scanned_info, &scan);
+  }
+
+  // まとめて取得できなかったエントリは個別に取得する
+  for (int w = 0; w < words; w++) {
+    MaskWord bits = wanted[w] & ~batch->info_loaded[w];
+    if (files_only) {
+      bits &= ~batch->is_dir[w];
+    }
+    for (int bit = 0; bits; bit++, bits >>= 1) {
+      if (!(bits & 1)) {
+        continue;
+      }
+      int index = w * MASK_BITS + bit;
+      char *path = batch_entry_path(batch, index);
+      if (path == NULL) {
+        return -1;
+      }
+      MASK_SET(batch->info_loaded, index);
+      if (get_file_info(path, &batch->infos[index])) {
+        MASK_SET(batch->info_valid, index);
+      }
+      free(path);
+    }
+  }
+  return missing;
+}
+
+/**
+ * @brief ディレクトリが空かどうかを判定する
+ *
+ * @param[in] path ディレクトリのパス
+ * @return 空の場合は 1、エントリがあるか開けない場合は 0
+ */
+static int is_empty_directory(const char *path) {
+  DIR *dir = opendir(path);
+  struct dirent *entry;
+  int empty = 1;
+
+  if (dir == NULL) {
+    return 0;
+  }
+  while (empty && (entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+      empty = 0;
+    }
+  }
+  closedir(dir);
+  return empty;
+}
+
+/**
+ * @brief 単位数を条件の比較方法で比較する
+ *
+ * @param[in] cond 条件
+ * @param[in] value エントリの単位数
+ * @return 条件を満たす場合は非ゼロ値、満たさない場合は 0
+ */
+static int compare_meta_value(const Condition *cond,
+                              const unsigned long value) {
+  if (cond->meta_compare > 0) {
+    return value > cond->meta_value;
+  } else if (cond->meta_compare < 0) {
+    return value < cond->meta_value;
+  }
+  return value == cond->meta_value;
+}
+
+/**
+ * @brief メタデータの条件をエントリ 1 つに対して評価する
+ *
+ * @param[in] cond 条件
+ * @param[in] info エントリのメタデータ
+ * @return 条件を満たす場合は非ゼロ値、満たさない場合は 0
+ */
+static int match_meta_condition(const Condition *cond, const FileInfo *info) {
+  switch (cond->meta) {
+    case META_SIZE:
+      return compare_meta_value(
+          cond, (info->size + cond->meta_unit - 1) / cond->meta_unit);
+    case META_MTIME: {
+      // 未来の日時は経過時間 0 として扱う
+      double age = difftime(cond->meta_time, info->mtime);
+      return compare_meta_value(
+          cond, age > 0 ? (unsigned long)(age / cond->meta_unit) : 0);
+    }
+    case META_NEWER:
+      return difftime(info->mtime, cond->meta_time) > 0;
+    case META_EMPTY:
+      return info->size == 0;
+    default:
+      return 1;
+  }
+}
+
+/**
+ * @brief メタデータの条件を候補のエントリに対して評価する
+ *
+ * 候補のエントリのメタデータだけを取得し、条件を満たさないエントリの
+ * ビットを match から落とす
+ *
+ * @param[in,out] batch 評価対象のエントリ集合
+ * @param[in] cond 評価する条件
+ * @param[in,out] match 候補のエントリのビット集合
+ * @return 評価のコストの見積もり
+ */
+static int evaluate_meta_condition(EntryBatch *batch, const Condition *cond,
+                                   MaskWord *match) {
+  const int words = MASK_WORDS(batch->count);
+  int is_empty = cond->meta == META_EMPTY;
+  int loaded = batch_load_info(batch, match, is_empty);
+  int cost = 0;
+
+  if (loaded < 0) {
+    memset(match, 0, sizeof(MaskWord) * words);
+    return 0;
+  }
+  cost += loaded * META_FETCH_COST;
+
+  for (int w = 0; w < words; w++) {
+    MaskWord bits = match[w];
+    for (int bit = 0; bits; bit++, bits >>= 1) {
+      if (!(bits & 1)) {
+        continue;
+      }
+      int index = w * MASK_BITS + bit;
+      int matched;
+      if (is_empty && MASK_TEST(batch->is_dir, index)) {
+        // 空のディレクトリかどうかはディレクトリを開いて調べる
+        char *path = batch_entry_path(batch, index);
+        matched = path != NULL && is_empty_directory(path);
+        free(path);
+        cost += META_FETCH_COST;
+      } else {
+        matched = MASK_TEST(batch->info_valid, index) &&
+                  match_meta_condition(cond, &batch->infos[index]);
+        cost++;
+      }
+      if (!matched) {
+        match[w] &= ~((MaskWord)1 << bit);
+      }
+    }
+  }
+  return cost;
+}
+
+#define CONTENT_SEARCH_COST 1024  // ファイルの内容を 1 つ調べるコストの見積もり
+
+/**
+ * @brief ファイルの内容の条件 (-contains) を候補のエントリに対して評価する
+ *
+ * ディレクトリは一致しない。読む最大のサイズが指定されている場合は、
+ * それを超えるファイルを読まずに落とす
+ *
+ * @param[in,out] batch 評価対象のエントリ集合
+ * @param[in] cond 評価する条件
+ * @param[in,out] match 候補のエントリのビット集合
+ * @param[in] max_size 読む最大のサイズ (0 は無制限)
+ * @return 評価のコストの見積もり
+ */
+static int evaluate_content_condition(EntryBatch *batch, const Condition *cond,
+                                      MaskWord *match,
+                                      const unsigned long max_size) {
+  const int words = MASK_WORDS(batch->count);
+  int cost = 0;
+
+  for (int w = 0; w < words; w++) {
+    match[w] &= ~batch->is_dir[w];
+  }
+  if (max_size > 0) {
+    int loaded = batch_load_info(batch, match, 1);
+    if (loaded < 0) {
+      memset(match, 0, sizeof(MaskWord) * words);
+      return 0;
+    }
+    cost += loaded * META_FETCH_COST;
+  }
+
+  for (int w = 0; w < words; w++) {
+    MaskWord bits = match[w];
+    for (int bit = 0; bits; bit++, bits >>= 1) {
+      if (!(bits & 1)) {
+        continue;
+      }
+      int index = w * MASK_BITS + bit;
+      int matched = 0;
+      if (max_size == 0 || (MASK_TEST(batch->info_valid, index) &&
+                            batch->infos[index].size <= max_size)) {
+        char *path = batch_entry_path(batch, index);
+        matched = path != NULL &&
+                  content_pattern_search_file(cond->content, path);
+        free(path);
+        cost += CONTENT_SEARCH_COST;
+      }
+      if (!matched) {
+        match[w] &= ~((MaskWord)1 << bit);
+      }
+    }
+  }
+  return cost;
+}
+
+/**
+ * @brief エントリ集合全体に対して条件を評価する
+ *
+ * 評価手順に従って条件を 1 つずつエントリ集合全体に適用して一致したエントリの
+ * ビット集合を求め、ワード単位で結合する。 AND で結合する条件はそれまでの結果が
+ * 真のエントリだけを、 OR で結合する条件は偽のエントリだけを評価する。
+ * 評価中に条件ごとのコストと通過率を集計し、一定数のエントリを評価するごとに
+ * 評価順を見直す。結果は batch->match に格納される
+ *
+ * @param[in,out] batch 評価対象のエントリ集合
+ * @param[in,out] plan 評価手順
+ * @param[in] opts 評価基準を含む Options 構造体へのポインタ
+ * @param[in] fs_ignore_case ファイルシステムが大文字小文字を区別しない場合は
+ * 1、区別する場合は 0
+ */
+static void evaluate_batch(EntryBatch *batch, EvalPlan *plan,
+                           const Options *opts, const int fs_ignore_case) {
+  const int words = MASK_WORDS(batch->count);
+  MaskWord *result = batch->match;
+  MaskWord last_word = ~(MaskWord)0;  // 最終ワードの有効なビット
+
+  if (batch->count == 0) {
+    return;
+  }
+  if (batch->count % MASK_BITS) {
+    last_word = ((MaskWord)1 << (batch->count % MASK_BITS)) - 1;
+  }
+
+  // すべて一致した状態から始める (条件がない場合はそのまま)
+  for (int w = 0; w < words; w++) {
+    result[w] = (w == words - 1) ? last_word : ~(MaskWord)0;
+  }
+  if (plan->step_count == 0) {
+    return;
+  }
+
+  // 属性フラグからシンボリックリンクと実行属性のビット集合を作成
+  memset(batch->symlink, 0, sizeof(MaskWord) * words);
+  memset(batch->executable, 0, sizeof(MaskWord) * words);
+  for (int i = 0; i < batch->count; i++) {
+    if (batch->attributes[i] & FILE_ATTR_SYMLINK) {
+      MASK_SET(batch->symlink, i);
+    }
+    if (batch->attributes[i] & FILE_ATTR_EXECUTABLE) {
+      MASK_SET(batch->executable, i);
+    }
+  }
+
+  // 評価手順に従って各条件を評価
+  for (int k = 0; k < plan->step_count; k++) {
+    const EvalStep *step = &plan->steps[k];
+    const Condition *cond = &opts->conditions[step->cond_index];
+    EvalStats *stats = &plan->stats[step->cond_index];
+    MaskWord *match = batch->scratch;
+    int path_state = batch->path_states ? batch->path_states[step->cond_index]
+                                        : REGEX_STATE_UNKNOWN;
+
+    // 評価対象のエントリを決め、ファイルタイプの条件をワード単位で適用
+    for (int w = 0; w < words; w++) {
+      MaskWord candidates = (step->op == OP_AND) ? result[w] : ~result[w];
+      if (w == words - 1) {
+        candidates &= last_word;
+      }
+      for (MaskWord bits = candidates; bits; bits &= bits - 1) {
+        stats->tested++;
+      }
+      match[w] = candidates & type_mask_word(batch, cond->type, w);
+    }
+    if (cond->type != TYPE_NONE) {
+      stats->cost += words;  // ファイルタイプの評価はワード単位
+    }
+
+    // 名前パターンと正規表現のチェック (残っている候補のみ)
+    if (cond->pattern != NULL || cond->regex != NULL) {
+      for (int w = 0; w < words; w++) {
+        MaskWord bits = match[w];
+        for (int bit = 0; bits; bit++, bits >>= 1) {
+          if (!(bits & 1)) {
+            continue;
+          }
+          int index = w * MASK_BITS + bit;
+          if (!match_entry_condition(batch, index, cond, path_state, stats,
+                                     fs_ignore_case)) {
+            match[w] &= ~((MaskWord)1 << bit);
+          }
+        }
+      }
+    }
+
+    // メタデータの条件のチェック (残っている候補のメタデータだけを取得)
+    if (cond->meta != META_NONE) {
+      stats->cost += evaluate_meta_condition(batch, cond, match);
+    }
+
+    // ファイルの内容の条件のチェック (他の条件で絞り込んだ候補のみ読む)
+    if (cond->content != NULL) {
+      stats->cost += evaluate_content_condition(batch, cond, match,
+                                                opts->content_max_size);
+    }
+
+    // 演算子ロジックを適用
+    for (int w = 0; w < words; w++) {
+      for (MaskWord bits = match[w]; bits; bits &= bits - 1) {
+        stats->passed++;
+      }
+      if (step->op == OP_AND) {
+        result[w] = match[w];  // 候補を result に絞り込み済み
+      } else {
+        result[w] |= match[w];
+      }
+    }
+  }
+
+  // 一定数のエントリを評価したら評価順を見直す
+  plan->tested_since_reorder += batch->count;
+  if (plan->tested_since_reorder >= REORDER_INTERVAL) {
+    plan_reorder(plan);
+  }
+}
+
+/**
+ * @brief asprintf 関数のラッパー
+ *
+ * asprintf を呼び出し、エラー時にはメッセージを出力する
+ *
+ * @param[out] strp  確保された文字列を格納するポインタのアドレス
+ * @param[in] fmt    書式指定文字列
+ * @param[in] ...    可変引数
+ * @return 成功時は文字数、失敗時は負の値
+ */
+static int alloc_formatted_string(char **strp, const char *fmt, ...) {
+  va_list ap;
+  int result;
+
+  va_start(ap, fmt);
+  result = vasprintf(strp, fmt, ap);
+  va_end(ap);
+
+  if (result == -1) {
+    fprintf(stderr, "Memory allocation error\n");
+    *strp = NULL;
+  }
+
+  return result;
+}
+
+/**
+ * @brief ファイル属性チェックが必要かどうかを判定する
+ *
+ * Options 構造体を調べ、シンボリックリンクや実行可能ファイルなど
+ * ファイル属性の検索条件が含まれているかを確認する
+ *
+ * @param[in] opts 検索オプション構造体へのポインタ
+ * @return ファイル属性の検索が必要な場合は 1、それ以外は 0
+ */
+static int needs_file_attribute_check(const Options *opts) {
+  if (opts == NULL || opts->condition_count == 0) {
+    return 0;
+  }
+
+  // 各条件を調べ、TYPE_SYMLINK または TYPE_EXECUTABLE があるか確認
+  for (int i = 0; i < opts->condition_count; i++) {
+    if (opts->conditions[i].type == TYPE_SYMLINK ||
+        opts->conditions[i].type == TYPE_EXECUTABLE) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+#define ENTRY_ATTR_PENDING 0x20   // 属性を取得していないエントリ (収集中のみ)
+#define ENTRY_LINK_FOLLOWED 0x40  // -L でリンク先をたどったエントリ (収集中のみ)
+
+/**
+ * @brief scan_file_attributes から通知された属性をエントリに格納する
+ *
+ * @param[in] name エントリのファイル名
+ * @param[in] attributes 属性のビットフラグ
+ * @param[in] info エントリのメタデータ (使用しない)
+ * @param[in] user_data AttributeScan へのポインタ
+ */
+static void store_scanned_attributes(const char *name, int attributes,
+                                     const FileInfo *info, void *user_data) {
+  AttributeScan *scan = (AttributeScan *)user_data;
+  EntryBatch *batch = scan->batch;
+  int i = find_scanned_entry(scan, name);
+
+  if (i >= 0 && (batch->attributes[i] & ENTRY_ATTR_PENDING)) {
+    batch->attributes[i] =
+        (batch->attributes[i] & ENTRY_LINK_FOLLOWED) | attributes;
+  }
+}
+
+/**
+ * @brief 収集したエントリの属性を取得する
+ *
+ * エントリの多いディレクトリでは、ディレクトリを 1 回だけ先頭から順に読んで
+ * すべての属性をまとめて取得する。取得できなかったエントリは
+ * get_file_attributes で個別に取得する
+ *
+ * @param[in] dir_path ディレクトリのパス (区切り文字で終わる)
+ * @param[in,out] batch 属性を格納するエントリ集合 (ENTRY_ATTR_PENDING の
+ * エントリの属性を取得する)
+ * @return 成功時は 1、メモリ不足の場合は 0
+ */
+static int fetch_entry_attributes(const char *dir_path, EntryBatch *batch) {
+  if (batch->count >= ATTRIBUTE_SCAN_MIN) {
+    AttributeScan scan = {batch, 0};
+    scan_file_attributes(dir_path, store_scanned_attributes, &scan);
+  }
+
+  for (int i = 0; i < batch->count; i++) {
+    if (batch->attributes[i] & ENTRY_ATTR_PENDING) {
+      char *full_path = NULL;
+      if (alloc_formatted_string(&full_path, "%s%s", dir_path,
+                                 BATCH_NAME(batch, i)) < 0) {
+        return 0;
+      }
+      batch->attributes[i] = (batch->attributes[i] & ENTRY_LINK_FOLLOWED) |
+                             get_file_attributes(full_path);
+      free(full_path);
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief ディレクトリからエントリを収集する
+ *
+ * 指定されたディレクトリからすべてのエントリを読み込み、エントリ集合に格納する
+ *
+ * @param[in] dir_path 検索対象のディレクトリパス (区切り文字で終わる)
+ * @param[out] batch 収集したエントリを格納するエントリ集合 (初期化済み)
+ * @param[in] opts 検索オプション構造体へのポインタ
+ * @return 成功時は収集されたエントリ数、失敗時は負の値
+ */
+static int collect_directory_entries(const char *dir_path, EntryBatch *batch,
+                                     const Options *opts) {
+  DIR *dir;
+  struct dirent *entry;
+  char *full_path = NULL;  // 動的に確保するように変更
+  int check_attributes =
+      needs_file_attribute_check(opts);  // ファイル属性のチェックが必要かどうか
+
+  // ディレクトリを開いてエントリを収集
+  if ((dir = opendir(dir_path)) == NULL) {
+    fprintf(stderr, "Cannot open directory '%s': %s\n", dir_path,
+            strerror(errno));
+    return -1;
+  }
+
+  // ディレクトリエントリを読み込む ("." と ".." を除く)
+  while ((entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+      continue;
+    }
+
+    // 属性は全エントリを読み込んだ後でまとめて取得する
+    int attributes = check_attributes ? ENTRY_ATTR_PENDING : 0;
+    int is_dir = is_directory_entry(entry);
+
+    // -L ではリンク先の種類で判定する (リンク先が存在しない場合だけ
+    // シンボリックリンクとして扱う)
+    if (opts->follow == FOLLOW_ALL && is_symlink_entry(entry)) {
+      // 完全パスを構築 (alloc_formatted_string を使用)
+      if (alloc_formatted_string(&full_path, "%s%s", dir_path,
+                                 entry->d_name) < 0) {
+        // メモリ確保に失敗した場合
+        fprintf(stderr, "Memory allocation error for path\n");
+        closedir(dir);
+        return -1;
+      }
+      FileIdentity id;
+      int kind = get_directory_identity(full_path, &id);
+      if (kind >= 0) {
+        is_dir = kind;
+        attributes |= ENTRY_LINK_FOLLOWED;
+      }
+
+      // 不要になったパスを解放
+      free(full_path);
+      full_path = NULL;
+    }
+
+    // エントリ名・ディレクトリかどうか・属性を追加
+    if (!batch_add_entry(batch, entry->d_name, is_dir, attributes)) {
+      closedir(dir);
+      return -1;
+    }
+  }
+
+  // ディレクトリハンドルはもう必要ないので閉じる
+  closedir(dir);
+
+  // 属性情報の取得 (属性チェックが必要な場合のみ)
+  if (check_attributes && !fetch_entry_attributes(dir_path, batch)) {
+    return -1;
+  }
+  for (int i = 0; i < batch->count; i++) {
+    if (batch->attributes[i] & ENTRY_LINK_FOLLOWED) {
+      batch->attributes[i] &= ~(ENTRY_LINK_FOLLOWED | FILE_ATTR_SYMLINK);
+    }
+  }
+
+  return batch->count;
+}
+/**
+ * @brief 索引に保持するディレクトリ 1 つ分の情報
+ *
+ * @struct IndexDir
+ */
+typedef struct {
+  int path;            // ディレクトリのパスの names 内の位置
+  int first;           // 最初のエントリのインデックス
+  int count;           // エントリ数
+  int has_attributes;  // エントリの属性を取得済みの場合は 1
+  FollowMode follow;   // 読み込んだときのシンボリックリンクをたどる範囲
+} IndexDir;
+
+#define INDEX_ENTRY_DIR 0x80  // ディレクトリを表すエントリのフラグ (FILE_ATTR_* と重ならない)
+#define INDEX_NO_DIR (-1)     // buckets の空きを表す値
+
+/**
+ * @brief 読み込んだディレクトリの内容を保持する索引
+ *
+ * ディレクトリのパスとエントリのファイル名は 1 つのバッファに NUL 区切りで
+ * 連結し、エントリの種類と属性は 1 バイトのフラグで保持する。
+ * ディレクトリはパスのハッシュ値で引く
+ */
+struct EfindIndex {
+  IndexDir *dirs;        // ディレクトリの情報
+  int dir_count;         // ディレクトリの数
+  int dir_capacity;      // dirs の容量
+  int *buckets;          // パスのハッシュ値から dirs のインデックスを引く表
+  int bucket_count;      // buckets の要素数 (2 のべき乗)
+  char *names;           // パスとファイル名を NUL 区切りで連結したバッファ
+  int names_size;        // names の使用バイト数
+  int names_capacity;    // names の容量
+  int *name_offsets;     // エントリのファイル名の names 内の位置
+  unsigned char *flags;  // エントリの属性フラグと INDEX_ENTRY_DIR
+  int entry_count;       // エントリの数
+  int entry_capacity;    // エントリ単位の容量
+  char **scopes;         // 索引に追加するディレクトリの範囲 (先頭の "./" なし)
+  int scope_count;       // 範囲の数 (0 の場合はすべてのディレクトリを追加)
+};
+
+EfindIndex *efind_index_create(void) {
+  EfindIndex *index = (EfindIndex *)calloc(1, sizeof(EfindIndex));
+  if (index == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+  }
+  return index;
+}
+
+void efind_index_free(EfindIndex *index) {
+  if (index == NULL) {
+    return;
+  }
+  free(index->dirs);
+  free(index->buckets);
+  free(index->names);
+  free(index->name_offsets);
+  free(index->flags);
+  for (int i = 0; i < index->scope_count; i++) {
+    free(index->scopes[i]);
+  }
+  free(index->scopes);
+  free(index);
+}
+
+/**
+ * @brief 索引のキーにするため、パスの先頭の "./" を読み飛ばす
+ *
+ * @param[in] path パス
+ * @return "./" を除いたパスの先頭
+ */
+static const char *skip_index_prefix(const char *path) {
+  while (path[0] == '.' && (path[1] == '/' || path[1] == '\\')) {
+    path += 2;
+  }
+  return path;
+}
+
+int efind_index_add_scope(EfindIndex *index, const char *path) {
+  const char *scope = skip_index_prefix(path);
+  int len = strlen(scope);
+  if (strcmp(scope, ".") == 0) {
+    len = 0;  // カレントディレクトリの下はすべて追加する
+  }
+  while (len > 0 && (scope[len - 1] == '/' || scope[len - 1] == '\\')) {
+    len--;
+  }
+
+  char **scopes = (char **)realloc(
+      index->scopes, sizeof(char *) * (index->scope_count + 1));
+  if (scopes == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    return 0;
+  }
+  index->scopes = scopes;
+  scopes[index->scope_count] = (char *)malloc(len + 1);
+  if (scopes[index->scope_count] == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    return 0;
+  }
+  memcpy(scopes[index->scope_count], scope, len);
+  scopes[index->scope_count][len] = '\0';
+  index->scope_count++;
+  return 1;
+}
+
+/**
+ * @brief ディレクトリが索引に追加する範囲にあるかどうかを判定する
+ *
+ * @param[in] index 索引
+ * @param[in] key ディレクトリのパス (先頭の "./" なし)
+ * @return 範囲にある場合は 1、それ以外は 0
+ */
+static int index_in_scope(const EfindIndex *index, const char *key) {
+  if (index->scope_count == 0) {
+    return 1;
+  }
+  for (int i = 0; i < index->scope_count; i++) {
+    int len = strlen(index->scopes[i]);
+    if (len == 0 || (strncmp(key, index->scopes[i], len) == 0 &&
+                     (key[len] == '\0' || key[len] == '/' ||
+                      key[len] == '\\'))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief パスのハッシュ値を求める (FNV-1a)
+ *
+ * @param[in] path パス
+ * @return ハッシュ値
+ */
+static unsigned long hash_path(const char *path) {
+  unsigned long hash = 2166136261UL;
+  for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+    hash = (hash ^ *p) * 16777619UL;
+  }
+  return hash;
+}
+
+/**
+ * @brief 索引からディレクトリを探す
+ *
+ * @param[in] index 索引
+ * @param[in] path ディレクトリのパス
+ * @return ディレクトリのインデックス、見つからない場合は INDEX_NO_DIR
+ */
+static int index_find_dir(const EfindIndex *index, const char *path) {
+  if (index->bucket_count == 0) {
+    return INDEX_NO_DIR;
+  }
+  int mask = index->bucket_count - 1;
+  for (int b = hash_path(path) & mask; index->buckets[b] != INDEX_NO_DIR;
+       b = (b + 1) & mask) {
+    int d = index->buckets[b];
+    if (strcmp(index->names + index->dirs[d].path, path) == 0) {
+      return d;
+    }
+  }
+  return INDEX_NO_DIR;
+}
+
+/**
+ * @brief 索引の文字列バッファに文字列を追加する
+ *
+ * @param[in,out] index 索引
+ * @param[in] str 追加する文字列
+ * @return 追加した位置、メモリ不足の場合は -1
+ */
+static int index_add_name(EfindIndex *index, const char *str) {
+  int size = strlen(str) + 1;
+  if (index->names_size + size > index->names_capacity) {
+    int new_capacity = index->names_capacity ? index->names_capacity : 4096;
+    while (index->names_size + size > new_capacity) {
+      new_capacity *= 2;
+    }
+    char *new_names = (char *)realloc(index->names, new_capacity);
+    if (new_names == NULL) {
+      return -1;
+    }
+    index->names = new_names;
+    index->names_capacity = new_capacity;
+  }
+  memcpy(index->names + index->names_size, str, size);
+  index->names_size += size;
+  return index->names_size - size;
+}
+
+/**
+ * @brief 索引のハッシュ表を作り直す
+ *
+ * @param[in,out] index 索引
+ * @param[in] bucket_count 新しい要素数 (2 のべき乗)
+ * @return 成功時は 1、メモリ不足の場合は 0
+ */
+static int index_rehash(EfindIndex *index, const int bucket_count) {
+  int *buckets = (int *)malloc(sizeof(int) * bucket_count);
+  if (buckets == NULL) {
+    return 0;
+  }
+  for (int b = 0; b < bucket_count; b++) {
+    buckets[b] = INDEX_NO_DIR;
+  }
+  for (int d = 0; d < index->dir_count; d++) {
+    int b = hash_path(index->names + index->dirs[d].path) & (bucket_count - 1);
+    while (buckets[b] != INDEX_NO_DIR) {
+      b = (b + 1) & (bucket_count - 1);
+    }
+    buckets[b] = d;
+  }
+  free(index->buckets);
+  index->buckets = buckets;
+  index->bucket_count = bucket_count;
+  return 1;
+}
+
+/**
+ * @brief 読み込んだディレクトリの内容を索引に追加する
+ *
+ * @param[in,out] index 索引
+ * @param[in] path ディレクトリのパス
+ * @param[in] batch ディレクトリのエントリ集合
+ * @param[in] has_attributes エントリの属性を取得済みの場合は 1
+ * @param[in] follow エントリを読み込んだときのシンボリックリンクをたどる範囲
+ * @return 成功時は 1、メモリ不足の場合は 0
+ */
+static int index_add_dir(EfindIndex *index, const char *path,
+                         const EntryBatch *batch, const int has_attributes,
+                         const FollowMode follow) {
+  // ハッシュ表の使用率を 2/3 未満に保つ
+  if ((index->dir_count + 1) * 3 >= index->bucket_count * 2 &&
+      !index_rehash(index,
+                    index->bucket_count ? index->bucket_count * 2 : 64)) {
+    return 0;
+  }
+  if (index->dir_count >= index->dir_capacity) {
+    int new_capacity = index->dir_capacity ? index->dir_capacity * 2 : 64;
+    IndexDir *new_dirs =
+        (IndexDir *)realloc(index->dirs, sizeof(IndexDir) * new_capacity);
+    if (new_dirs == NULL) {
+      return 0;
+    }
+    index->dirs = new_dirs;
+    index->dir_capacity = new_capacity;
+  }
+  if (index->entry_count + batch->count > index->entry_capacity) {
+    int new_capacity = index->entry_capacity ? index->entry_capacity : 256;
+    while (index->entry_count + batch->count > new_capacity) {
+      new_capacity *= 2;
+    }
+    int *new_offsets =
+        (int *)realloc(index->name_offsets, sizeof(int) * new_capacity);
+    if (new_offsets == NULL) {
+      return 0;
+    }
+    index->name_offsets = new_offsets;
+    unsigned char *new_flags =
+        (unsigned char *)realloc(index->flags, new_capacity);
+    if (new_flags == NULL) {
+      return 0;
+    }
+    index->flags = new_flags;
+    index->entry_capacity = new_capacity;
+  }
+
+  IndexDir dir;
+  dir.path = index_add_name(index, path);
+  dir.first = index->entry_count;
+  dir.count = batch->count;
+  dir.has_attributes = has_attributes;
+  dir.follow = follow;
+  if (dir.path < 0) {
+    return 0;
+  }
+  for (int i = 0; i < batch->count; i++) {
+    int offset = index_add_name(index, BATCH_NAME(batch, i));
+    if (offset < 0) {
+      return 0;
+    }
+    index->name_offsets[dir.first + i] = offset;
+    index->flags[dir.first + i] =
+        batch->attributes[i] |
+        (MASK_TEST(batch->is_dir, i) ? INDEX_ENTRY_DIR : 0);
+  }
+
+  // すべて追加できたら登録する
+  int mask = index->bucket_count - 1;
+  int b = hash_path(path) & mask;
+  while (index->buckets[b] != INDEX_NO_DIR) {
+    b = (b + 1) & mask;
+  }
+  index->buckets[b] = index->dir_count;
+  index->dirs[index->dir_count++] = dir;
+  index->entry_count += batch->count;
+  return 1;
+}
+
+/**
+ * @brief ディレクトリのエントリを収集する (索引を使用)
+ *
+ * 検索条件に索引が設定されていれば、すでに読み込んだディレクトリは索引から
+ * エントリを取り出し、初めて読み込むディレクトリは内容を索引に追加する。
+ * 先頭の "./" は索引のキーに含めないため、 "src/" と "./src/" は同じ
+ * ディレクトリとして扱う。索引に範囲が設定されていれば、範囲外の
+ * ディレクトリは索引に追加せずに読み込む
+ *
+ * @param[in] dir_path 検索対象のディレクトリパス
+ * @param[out] batch 収集したエントリを格納するエントリ集合 (初期化済み)
+ * @param[in] opts 検索オプション構造体へのポインタ
+ * @return 成功時は収集されたエントリ数、失敗時は負の値
+ */
+static int load_directory_entries(const char *dir_path, EntryBatch *batch,
+                                  const Options *opts) {
+  EfindIndex *index = opts->index;
+  int check_attributes = needs_file_attribute_check(opts);
+
+  if (index == NULL) {
+    return collect_directory_entries(dir_path, batch, opts);
+  }
+
+  const char *key = skip_index_prefix(dir_path);
+  if (!index_in_scope(index, key)) {
+    return collect_directory_entries(dir_path, batch, opts);
+  }
+  int d = index_find_dir(index, key);
+  if (d == INDEX_NO_DIR) {
+    int count = collect_directory_entries(dir_path, batch, opts);
+    if (count >= 0 && !index_add_dir(index, key, batch, check_attributes,
+                                     opts->follow)) {
+      fprintf(stderr, "Memory allocation error\n");
+    }
+    return count;
+  }
+  if (index->dirs[d].follow != opts->follow) {
+    // リンクのたどり方が異なる検索で読み込んだ内容は使わない
+    return collect_directory_entries(dir_path, batch, opts);
+  }
+
+  IndexDir *dir = &index->dirs[d];
+  int fetch_attributes = check_attributes && !dir->has_attributes;
+  for (int i = dir->first; i < dir->first + dir->count; i++) {
+    // 属性を使わない検索には、ほかの検索で取得した属性を渡さない
+    // (直接読み込む場合と同じく属性なしとして扱う)
+    int attributes = 0;
+    if (check_attributes) {
+      attributes = fetch_attributes ? ENTRY_ATTR_PENDING
+                                    : index->flags[i] & ~INDEX_ENTRY_DIR;
+    }
+    if (!batch_add_entry(batch, index->names + index->name_offsets[i],
+                         index->flags[i] & INDEX_ENTRY_DIR, attributes)) {
+      return -1;
+    }
+  }
+
+  // 索引の作成時に属性を取得していなければ、読み込み時と同じくディレクトリを
+  // 1 回読んでまとめて取得し、索引に残す
+  if (fetch_attributes) {
+    if (!fetch_entry_attributes(dir_path, batch)) {
+      return -1;
+    }
+    for (int k = 0; k < batch->count; k++) {
+      int attributes = batch->attributes[k];
+      FileIdentity id;
+      char *full_path = NULL;
+      if ((attributes & FILE_ATTR_SYMLINK) && dir->follow == FOLLOW_ALL) {
+        if (alloc_formatted_string(&full_path, "%s%s", dir_path,
+                                   BATCH_NAME(batch, k)) < 0) {
+          return -1;
+        }
+        if (get_directory_identity(full_path, &id) >= 0) {
+          attributes &= ~FILE_ATTR_SYMLINK;  // リンク先をたどったエントリ
+        }
+        free(full_path);
+      }
+      batch->attributes[k] = attributes;
+      index->flags[dir->first + k] =
+          (index->flags[dir->first + k] & INDEX_ENTRY_DIR) | attributes;
+    }
+    dir->has_attributes = 1;
+  }
+  return batch->count;
+}
+
+/**
+ * @brief 検索中のディレクトリ 1 階層分の状態
+ *
+ * @struct SearchFrame
+ */
+typedef struct {
+  EntryBatch batch;      // ディレクトリのエントリ集合 (評価済み)
+  char *dir_path;        // ディレクトリのパス (batch.prefix)
+  int *dir_states;       // dir_path まで照合した照合状態とサブディレクトリ用の作業領域
+  int entry_depth;       // エントリの深さ (サブディレクトリの再帰深度)
+  int next_index;        // 次に処理するエントリのインデックス
+  int pending_dir;       // 次に降りていくサブディレクトリのインデックス (なければ -1)
+  unsigned long kbytes;  // 一致したファイルのサイズの合計 (KB 、 efind_summarize 用)
+} SearchFrame;
+
+/**
+ * @brief 訪れたディレクトリの識別値の集合 (-L 用)
+ *
+ * オープンアドレス法のハッシュ表で、空きは device が VISITED_EMPTY の要素で
+ * 表す
+ *
+ * @struct VisitedSet
+ */
+typedef struct {
+  FileIdentity *slots;  // 識別値の表
+  int capacity;         // slots の要素数 (2 のべき乗)
+  int count;            // 格納されている識別値の数
+} VisitedSet;
+
+#define VISITED_EMPTY (~0UL)  // VisitedSet の空きを表す device の値
+
+/**
+ * @brief 識別値のハッシュ値を求める
+ *
+ * @param[in] id 識別値
+ * @return ハッシュ値
+ */
+static unsigned long hash_identity(const FileIdentity *id) {
+  return (id->inode * 2654435761UL) ^ (id->device * 16777619UL);
+}
+
+/**
+ * @brief 識別値を集合に追加する
+ *
+ * @param[in,out] set 集合
+ * @param[in] id 追加する識別値
+ * @return 追加した場合は 1、すでに含まれていた場合は 0、メモリ不足の場合は -1
+ */
+static int visited_add(VisitedSet *set, const FileIdentity *id) {
+  // 表の使用率を 1/2 以下に保つ
+  if ((set->count + 1) * 2 > set->capacity) {
+    int new_capacity = set->capacity ? set->capacity * 2 : 64;
+    FileIdentity *slots =
+        (FileIdentity *)malloc(sizeof(FileIdentity) * new_capacity);
+    if (slots == NULL) {
+      fprintf(stderr, "Memory allocation error\n");
+      return -1;
+    }
+    for (int b = 0; b < new_capacity; b++) {
+      slots[b].device = VISITED_EMPTY;
+    }
+    for (int i = 0; i < set->capacity; i++) {
+      if (set->slots[i].device != VISITED_EMPTY) {
+        int b = hash_identity(&set->slots[i]) & (new_capacity - 1);
+        while (slots[b].device != VISITED_EMPTY) {
+          b = (b + 1) & (new_capacity - 1);
+        }
+        slots[b] = set->slots[i];
+      }
+    }
+    free(set->slots);
+    set->slots = slots;
+    set->capacity = new_capacity;
+  }
+
+  int mask = set->capacity - 1;
+  int b = hash_identity(id) & mask;
+  for (; set->slots[b].device != VISITED_EMPTY; b = (b + 1) & mask) {
+    if (set->slots[b].device == id->device &&
+        set->slots[b].inode == id->inode) {
+      return 0;
+    }
+  }
+  set->slots[b] = *id;
+  set->count++;
+  return 1;
+}
+
+/**
+ * @brief 検索中の状態を保持する構造体
+ *
+ * 再帰呼び出しの代わりに、ディレクトリごとの状態をスタックに積んで
+ * 検索を 1 エントリずつ進められるようにする
+ */
+struct EfindIterator {
+  const Options *opts;              // 検索オプション
+  const char *root;                 // 検索を開始したパス
+  int root_len;                     // エントリのパスのうち開始パスの部分の長さ
+  int fs_ignore_case;               // ファイルシステムが大文字小文字を区別しない場合は 1
+  int required_from;                // 常に満たす必要がある条件 (最後の -o の右辺より後) の先頭
+  EvalPlan plan;                    // 条件の評価手順
+  char component[256];              // 直接たどるディレクトリの名前 (作業用)
+  SearchFrame *frames;              // ディレクトリのスタック
+  int frame_count;                  // スタックに積まれたディレクトリの数
+  int frame_capacity;               // frames の容量
+  char *path;                       // 返すエントリのパスのバッファ
+  int path_capacity;                // path の容量
+  EfindEntry entry;                 // 返すエントリ
+  int status;                       // 開始パスを検索できなかった場合は 1
+  EfindSizeCallback size_callback;  // ディレクトリごとのサイズを受け取る関数
+  void *user_data;                  // size_callback に渡すポインタ
+  VisitedSet visited;               // 訪れたディレクトリ (-L の場合のみ)
+};
+
+static int enter_directory(EfindIterator *it, const char *dir_path,
+                           const int current_depth, const int *path_states);
+
+/**
+ * @brief 条件ごとのパスの照合状態を文字列の分だけ進める
+ *
+ * パスと照合する条件 (正規表現、 -path) 以外は REGEX_STATE_UNKNOWN とする
+ *
+ * @param[in] it 検索中の状態
+ * @param[in] from 進める前の照合状態
+ * @param[in] string 照合する文字列
+ * @param[out] to 進めた後の照合状態
+ */
+static void advance_path_states(const EfindIterator *it, const int *from,
+                                const char *string, int *to) {
+  for (int i = 0; i < it->opts->condition_count; i++) {
+    Regex *re = it->opts->conditions[i].regex;
+    to[i] = (re != NULL) ? regex_advance(re, from[i], string)
+                         : REGEX_STATE_UNKNOWN;
+  }
+}
+
+/**
+ * @brief 照合状態から、以降のどのパスも条件全体を満たさないかを判定する
+ *
+ * 条件は左から順に結合されるため、最後の -o より後の条件は常に満たす必要がある。
+ * そのいずれかの照合状態が REGEX_STATE_DEAD であれば、
+ * そのパスで始まるエントリはどれも条件に一致しない
+ *
+ * @param[in] it 検索中の状態
+ * @param[in] states 条件ごとの照合状態
+ * @return どのパスも一致しない場合は 1、それ以外は 0
+ */
+static int path_states_dead(const EfindIterator *it, const int *states) {
+  for (int i = it->required_from; i < it->opts->condition_count; i++) {
+    if (states[i] == REGEX_STATE_DEAD) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief 照合状態から、次にたどるべきディレクトリの名前が 1 通りに決まるかを
+ * 判定する
+ *
+ * 最後の -o より後の条件のいずれかで、照合状態に続けられるパスの要素が
+ * 1 通りしかなければ、ディレクトリ内のほかのエントリとその下はどれも条件に
+ * 一致しない。決まった名前は it->component に格納する
+ *
+ * @param[in,out] it 検索中の状態
+ * @param[in] states 条件ごとのディレクトリのパスまで照合した照合状態
+ * @return 名前が決まった場合は 1、それ以外は 0
+ */
+static int find_forced_component(EfindIterator *it, const int *states) {
+  for (int i = it->required_from; i < it->opts->condition_count; i++) {
+    Regex *re = it->opts->conditions[i].regex;
+    if (re != NULL && states[i] >= 0 &&
+        regex_forced_component(re, states[i], it->fs_ignore_case,
+                               it->component, sizeof(it->component))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief 名前が決まったサブディレクトリだけを直接たどる
+ *
+ * ディレクトリを列挙せずに it->component の名前のディレクトリを 1 回の検索で
+ * 探し、存在すればその中を処理する
+ *
+ * @param[in,out] it 検索中の状態
+ * @param[in] dir_path 親ディレクトリのパス (区切り文字で終わる)
+ * @param[in] current_depth 親ディレクトリの再帰深度
+ * @param[in] dir_states 条件ごとの dir_path まで照合した照合状態
+ * @param[out] child_states サブディレクトリの照合状態を格納する領域
+ * @return 成功時は 0、エラー時は 1
+ */
+static int descend_forced_component(EfindIterator *it, const char *dir_path,
+                                    const int current_depth,
+                                    const int *dir_states, int *child_states) {
+  char *path = NULL;
+
+  if (alloc_formatted_string(&path, "%s%s", dir_path, it->component) < 0) {
+    return 1;
+  }
+  // 大文字小文字を区別しないファイルシステムでは実際の名前に置き換わる
+  int found = find_subdirectory(path, it->component, sizeof(it->component));
+  free(path);
+  if (!found) {
+    return 0;
+  }
+
+  if (alloc_formatted_string(&path, "%s%s", dir_path, it->component) < 0) {
+    return 1;
+  }
+  advance_path_states(it, dir_states, it->component, child_states);
+  int result = enter_directory(it, path, current_depth + 1, child_states);
+  free(path);
+  return result;
+}
+
+/**
+ * @brief ディレクトリ 1 階層分の状態をスタックに積む
+ *
+ * 成功時は frame が保持する領域の所有権はスタックに移る
+ *
+ * @param[in,out] it 検索中の状態
+ * @param[in] frame 積む状態
+ * @return 成功時は 1、失敗時は 0
+ */
+static int push_frame(EfindIterator *it, const SearchFrame *frame) {
+  if (it->frame_count >= it->frame_capacity) {
+    int new_capacity = it->frame_capacity ? it->frame_capacity * 2 : 16;
+    SearchFrame *new_frames = (SearchFrame *)realloc(
+        it->frames, sizeof(SearchFrame) * new_capacity);
+    if (new_frames == NULL) {
+      fprintf(stderr, "Memory allocation error\n");
+      return 0;
+    }
+    it->frames = new_frames;
+    it->frame_capacity = new_capacity;
+  }
+  it->frames[it->frame_count++] = *frame;
+  return 1;
+}
+
+/**
+ * @brief ディレクトリ 1 階層分の状態が保持する領域を解放する
+ *
+ * @param[in,out] frame 解放する状態
+ */
+static void free_frame(SearchFrame *frame) {
+  batch_free(&frame->batch);
+  free(frame->dir_states);
+  free(frame->dir_path);
+}
+
+/**
+ * @brief 通常ファイルの検索を開始する
+ *
+ * 1 エントリだけのエントリ集合を評価し、スタックに積む
+ *
+ * @param[in,out] it 検索中の状態
+ * @param[in] file_path 処理対象ファイルのパス
+ * @param[in] current_depth 現在の再帰深度
+ * @return 成功時は 0、エラー時は 1
+ */
+static int enter_regular_file(EfindIterator *it, const char *file_path,
+                              const int current_depth) {
+  SearchFrame frame;
+  char *file_name = strrchr(file_path, '/');
+
+  if (file_name == NULL) {
+    file_name = strrchr(file_path, '\\');
+  }
+
+  // ファイル名部分を取得 (パス区切り文字がない場合はパス全体がファイル名)
+  if (file_name == NULL) {
+    file_name = (char *)file_path;
+  } else {
+    file_name++;  // パス区切り文字をスキップ
+  }
+
+  // ファイル属性のチェックが必要な場合のみ属性を取得
+  int attributes = 0;
+  if (needs_file_attribute_check(it->opts)) {
+    attributes = get_file_attributes(file_path);
+  }
+
+  // ファイル名より前の部分 (正規表現との照合に使用)
+  memset(&frame, 0, sizeof(frame));
+  frame.dir_path = strdup(file_path);
+  if (frame.dir_path == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    return 1;
+  }
+  frame.dir_path[file_name - file_path] = '\0';
+  frame.entry_depth = current_depth;
+  frame.pending_dir = -1;
+  if (current_depth == 0) {
+    it->root_len = strlen(file_path);
+  }
+
+  // 1 エントリだけのエントリ集合を作成 (通常ファイル)
+  if (!batch_init(&frame.batch) ||
+      !batch_add_entry(&frame.batch, file_name, 0, attributes)) {
+    free_frame(&frame);
+    return 1;
+  }
+  frame.batch.prefix = frame.dir_path;
+  frame.batch.prefix_len = file_name - file_path;
+
+  // 条件に合致するか評価
+  evaluate_batch(&frame.batch, &it->plan, it->opts, it->fs_ignore_case);
+  if (!push_frame(it, &frame)) {
+    free_frame(&frame);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief ディレクトリのパスをエントリのパスの前に付ける形にする
+ *
+ * ドライブ名だけの場合は "." を、区切り文字で終わらない場合は "/" を付ける
+ *
+ * @param[in] dir_path ディレクトリのパス
+ * @return 作成したパス (呼び出し側で解放する)、メモリ不足の場合は NULL
+ */
+static char *make_directory_prefix(const char *dir_path) {
+  int len = strlen(dir_path);
+  int dot = should_append_dot(dir_path);
+  int separator = !is_path_end_with_separator(dir_path);
+  char *prefix = (char *)malloc(len + dot + separator + 1);
+
+  if (prefix == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    return NULL;
+  }
+  memcpy(prefix, dir_path, len);
+  if (dot) {
+    prefix[len++] = '.';
+  }
+  if (separator) {
+    prefix[len++] = '/';
+  }
+  prefix[len] = '\0';
+  return prefix;
+}
+
+/**
+ * @brief ディレクトリの検索を開始する
+ *
+ * ディレクトリ内のエントリを収集して条件を評価し、スタックに積む。
+ * パスの照合状態からどのエントリも条件に一致しないことがわかる場合は
+ * ディレクトリを読まずに戻り、次にたどるディレクトリの名前が 1 通りに
+ * 決まる場合はディレクトリを列挙せずにそのディレクトリだけをたどる
+ *
+ * @param[in,out] it 検索中の状態
+ * @param[in] dir_path 処理対象ディレクトリのパス
+ * @param[in] current_depth 現在の再帰深度
+ * @param[in] path_states 条件ごとの dir_path まで照合したパスの照合状態
+ * (パスと照合する条件がない場合は NULL)
+ * @return 成功時は 0、エラー時は 1
+ */
+static int enter_directory(EfindIterator *it, const char *dir_path,
+                           const int current_depth, const int *path_states) {
+  const Options *opts = it->opts;
+  SearchFrame frame;
+  int entry_count = 0;
+  int return_status = 0;
+
+  memset(&frame, 0, sizeof(frame));
+  frame.entry_depth = current_depth + 1;
+  frame.pending_dir = -1;
+
+  frame.dir_path = make_directory_prefix(dir_path);
+  if (frame.dir_path == NULL) {
+    return 1;
+  }
+  if (current_depth == 0) {
+    it->root_len = strlen(frame.dir_path);
+  }
+
+  if (opts->maxdepth >= 0 && current_depth > opts->maxdepth - 1) {
+    free(frame.dir_path);
+    return 0;
+  }
+
+  // 照合状態を末尾の区切り文字の分だけ進め、どのエントリも一致し得ないなら
+  // ディレクトリを読まずに戻る
+  if (path_states != NULL) {
+    frame.dir_states = (int *)malloc(sizeof(int) * opts->condition_count * 2);
+    if (frame.dir_states == NULL) {
+      fprintf(stderr, "Memory allocation error\n");
+      free(frame.dir_path);
+      return 1;
+    }
+    advance_path_states(it, path_states, frame.dir_path + strlen(dir_path),
+                        frame.dir_states);
+    if (path_states_dead(it, frame.dir_states)) {
+      free(frame.dir_states);
+      free(frame.dir_path);
+      return 0;
+    }
+
+    // 次にたどるディレクトリの名前が決まっていれば、列挙せずに直接たどる
+    // (find_subdirectory はリンクをたどらないため -L では行わない)
+    if (opts->follow != FOLLOW_ALL &&
+        find_forced_component(it, frame.dir_states)) {
+      return_status = descend_forced_component(
+          it, frame.dir_path, current_depth, frame.dir_states,
+          frame.dir_states + opts->condition_count);
+      free(frame.dir_states);
+      free(frame.dir_path);
+      return return_status;
+    }
+  }
+
+  // -L では、すでに訪れたディレクトリ (リンクの循環や別名) は読まない
+  if (opts->follow == FOLLOW_ALL) {
+    FileIdentity id;
+    if (get_directory_identity(frame.dir_path, &id) == 1) {
+      int added = visited_add(&it->visited, &id);
+      if (added <= 0) {
+        free_frame(&frame);
+        return added < 0 ? 1 : 0;
+      }
+    }
+  }
+
+  // ディレクトリからエントリを収集
+  if (!batch_init(&frame.batch)) {
+    free_frame(&frame);
+    return 1;
+  }
+  entry_count = load_directory_entries(frame.dir_path, &frame.batch, opts);
+  if (entry_count < 0) {
+    free_frame(&frame);
+    // 最初の呼び出し (current_depth == 0) でエラーの場合のみエラーコードを返す
+    return (current_depth == 0) ? 1 : 0;
+  }
+  if (opts->sort && !batch_sort(&frame.batch)) {
+    free_frame(&frame);
+    return 1;
+  }
+
+  // 収集したエントリ全体に対して条件を評価
+  frame.batch.prefix = frame.dir_path;
+  frame.batch.prefix_len = strlen(frame.dir_path);
+  frame.batch.path_states = frame.dir_states;
+  evaluate_batch(&frame.batch, &it->plan, opts, it->fs_ignore_case);
+
+  if (!push_frame(it, &frame)) {
+    free_frame(&frame);
+    return 1;
+  }
+  return return_status;
+}
+
+/**
+ * @brief 開始パスの検索を開始する
+ *
+ * 通常ファイルの場合はそのファイルだけを、それ以外はディレクトリとして処理する。
+ * 種類を調べるのは開始パスだけで、サブディレクトリはディレクトリを読んだ
+ * ときの種類に基づいて enter_directory で直接処理する
+ *
+ * @param[in,out] it 検索中の状態
+ * @param[in] path 検索するパス
+ * @param[in] current_depth 現在の検索深さ
+ * @param[in] path_states 条件ごとの path まで照合したパスの照合状態
+ * (パスと照合する条件がない場合は NULL)
+ * @return 成功時は 0、エラー時は 1
+ */
+static int enter_path(EfindIterator *it, const char *path,
+                      const int current_depth, const int *path_states) {
+  // パスが存在する通常ファイルの場合
+  if (is_existing_regular_file(path)) {
+    return enter_regular_file(it, path, current_depth);
+  } else {
+    // ディレクトリの場合
+    return enter_directory(it, path, current_depth, path_states);
+  }
+}
+
+/**
+ * @brief エントリのパスを it->path に作成する
+ *
+ * @param[in,out] it 検索中の状態
+ * @param[in] frame エントリのあるディレクトリの状態
+ * @param[in] index エントリのインデックス
+ * @return 成功時は 1、失敗時は 0
+ */
+static int build_entry_path(EfindIterator *it, const SearchFrame *frame,
+                            const int index) {
+  int prefix_len = frame->batch.prefix_len;
+  int name_len = BATCH_NAME_LEN(&frame->batch, index);
+
+  if (prefix_len + name_len + 1 > it->path_capacity) {
+    int new_capacity = it->path_capacity ? it->path_capacity : 256;
+    while (prefix_len + name_len + 1 > new_capacity) {
+      new_capacity *= 2;
+    }
+    char *new_path = (char *)realloc(it->path, new_capacity);
+    if (new_path == NULL) {
+      fprintf(stderr, "Memory allocation error\n");
+      return 0;
+    }
+    it->path = new_path;
+    it->path_capacity = new_capacity;
+  }
+
+  memcpy(it->path, frame->dir_path, prefix_len);
+  memcpy(it->path + prefix_len, BATCH_NAME(&frame->batch, index),
+         name_len + 1);
+  return 1;
+}
+
+EfindIterator *efind_open(const char *root, const Options *query) {
+  // ファイルシステムの大文字小文字の区別を検索開始時に 1 回だけチェック
   static int fs_case_checked = 0;
   static int fs_ignore_case = 0;
 
+  EfindIterator *it = (EfindIterator *)calloc(1, sizeof(EfindIterator));
+  if (it == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    return NULL;
+  }
+
   if (!fs_case_checked) {
     fs_ignore_case = is_filesystem_ignore_case();
     fs_case_checked = 1;
   }
 
-  // パスが存在する通常ファイルの場合
-  if (is_existing_regular_file(base_dir)) {
-    return process_regular_file(base_dir, opts, fs_ignore_case);
-  } else {
-    // ディレクトリの場合
-    return process_directory(base_dir, current_depth, opts, fs_ignore_case);
+  it->opts = query;
+  it->root = root;
+  it->fs_ignore_case = fs_ignore_case;
+  plan_init(&it->plan, query);
+
+  // 最後の -o より後の条件の先頭を求める (-o の直後の条件はそれまでの結果と
+  // OR で結合されるので、常に満たす必要があるのはその次の条件から)
+  it->required_from = 0;
+  for (int i = 1; i < query->condition_count; i++) {
+    if (query->conditions[i - 1].op == OP_OR) {
+      it->required_from = i + 1;
+    }
+  }
+
+  // パスと照合する条件があれば、開始パスまで照合した照合状態を求める
+  int *path_states = NULL;
+  for (int i = 0; i < query->condition_count; i++) {
+    if (query->conditions[i].regex != NULL) {
+      path_states = (int *)malloc(sizeof(int) * query->condition_count);
+      if (path_states == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        free(it);
+        return NULL;
+      }
+      break;
+    }
+  }
+  if (path_states != NULL) {
+    for (int i = 0; i < query->condition_count; i++) {
+      Regex *re = query->conditions[i].regex;
+      path_states[i] = (re != NULL) ? regex_start_state(re)
+                                    : REGEX_STATE_UNKNOWN;
+    }
+    advance_path_states(it, path_states, root, path_states);
+  }
+
+  it->status = enter_path(it, root, 0, path_states);
+  free(path_states);
+  return it;
+}
+
+/**
+ * @brief 直前に処理したサブディレクトリに降りていく
+ *
+ * @param[in,out] it 検索中の状態
+ * @param[in,out] frame サブディレクトリのあるディレクトリの状態 (スタックの
+ * 先頭。サブディレクトリが積まれると無効になる)
+ */
+static void descend_pending_dir(EfindIterator *it, SearchFrame *frame) {
+  int index = frame->pending_dir;
+  int *child_states = NULL;
+  frame->pending_dir = -1;
+
+  // 最大の深さに達している場合はパスを作らずに戻る
+  const int maxdepth = it->opts->maxdepth;
+  if (maxdepth >= 0 && frame->entry_depth >= maxdepth) {
+    return;
+  }
+  if (!build_entry_path(it, frame, index)) {
+    return;
+  }
+  if (frame->dir_states != NULL) {
+    child_states = frame->dir_states + it->opts->condition_count;
+    advance_path_states(it, frame->dir_states,
+                        BATCH_NAME(&frame->batch, index), child_states);
+  }
+  // ディレクトリであることはディレクトリを読んだときにわかっている
+  enter_directory(it, it->path, frame->entry_depth, child_states);
+}
+
+/**
+ * @brief 処理し終えたディレクトリをスタックから降ろす
+ *
+ * efind_summarize でサイズを集計している場合は、ディレクトリのサイズの合計を
+ * 通知して親ディレクトリの合計に加える
+ *
+ * @param[in,out] it 検索中の状態
+ */
+static void pop_frame(EfindIterator *it) {
+  SearchFrame *frame = &it->frames[it->frame_count - 1];
+
+  if (it->size_callback != NULL) {
+    // 開始パスが通常ファイルの場合はそのパスを、それ以外は末尾の区切り文字を
+    // 除いたディレクトリのパスを通知する
+    char *dir_path = frame->dir_path;
+    int len = strlen(dir_path);
+    if (len > 1 && is_path_end_with_separator(dir_path)) {
+      dir_path[len - 1] = '\0';
+    }
+    it->size_callback(frame->entry_depth == 0 ? it->root : dir_path,
+                      frame->kbytes, it->user_data);
+    if (it->frame_count > 1) {
+      it->frames[it->frame_count - 2].kbytes += frame->kbytes;
+    }
+  }
+  free_frame(frame);
+  it->frame_count--;
+}
+
+const EfindEntry *efind_next(EfindIterator *it) {
+  while (it->frame_count > 0) {
+    SearchFrame *frame = &it->frames[it->frame_count - 1];
+
+    // 直前に返したエントリがディレクトリなら、その中に降りていく
+    if (frame->pending_dir >= 0) {
+      descend_pending_dir(it, frame);
+      continue;
+    }
+
+    // ディレクトリのエントリをすべて処理したらスタックから降ろす
+    if (frame->next_index >= frame->batch.count) {
+      pop_frame(it);
+      continue;
+    }
+
+    int i = frame->next_index++;
+    if (MASK_TEST(frame->batch.is_dir, i)) {
+      frame->pending_dir = i;
+    }
+
+    // 条件に一致していれば返す
+    if (MASK_TEST(frame->batch.match, i) && build_entry_path(it, frame, i)) {
+      it->entry.path = it->path;
+      it->entry.dir = frame->dir_path;
+      it->entry.name = it->path + frame->batch.prefix_len;
+      it->entry.root = it->root;
+      it->entry.relative = it->path + it->root_len;
+      it->entry.depth = frame->entry_depth;
+      it->entry.is_dir = MASK_TEST(frame->batch.is_dir, i) ? 1 : 0;
+      it->entry.attributes = frame->batch.attributes[i];
+      it->entry.info = NULL;
+      if (frame->batch.infos != NULL &&
+          MASK_TEST(frame->batch.info_valid, i)) {
+        it->entry.info = &frame->batch.infos[i];
+      }
+      return &it->entry;
+    }
+  }
+  return NULL;
+}
+
+int efind_close(EfindIterator *it) {
+  if (it == NULL) {
+    return 0;
+  }
+
+  int status = it->status;
+  while (it->frame_count > 0) {
+    free_frame(&it->frames[--it->frame_count]);
+  }
+  free(it->frames);
+  free(it->path);
+  free(it->visited.slots);
+  free(it);
+  return status;
+}
+
+int efind_walk(const char *root, const Options *query, EfindCallback callback,
+               void *user_data) {
+  EfindIterator *it = efind_open(root, query);
+  const EfindEntry *entry;
+
+  if (it == NULL) {
+    return 1;
+  }
+  while ((entry = efind_next(it)) != NULL) {
+    if (callback(entry, user_data) != 0) {
+      break;
+    }
+  }
+  return efind_close(it);
+}
+
+/**
+ * @brief 専用の関数でパスを出力する際の状態
+ *
+ * @struct FastPrint
+ */
+typedef struct {
+  char *path;     // 出力するパスのバッファ (ディレクトリごとに名前を継ぎ足す)
+  int capacity;   // path の容量
+  int maxdepth;   // 最大の検索深さ
+  FILE *stream;   // 出力先
+} FastPrint;
+
+/**
+ * @brief パスのバッファの容量を確保する
+ *
+ * @param[in,out] fp 出力の状態
+ * @param[in] size 必要なバイト数
+ * @return 成功時は 1、メモリ不足の場合は 0
+ */
+static int fast_print_reserve(FastPrint *fp, const int size) {
+  if (size <= fp->capacity) {
+    return 1;
   }
+  int new_capacity = fp->capacity ? fp->capacity : 256;
+  while (size > new_capacity) {
+    new_capacity *= 2;
+  }
+  char *new_path = (char *)realloc(fp->path, new_capacity);
+  if (new_path == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    return 0;
+  }
+  fp->path = new_path;
+  fp->capacity = new_capacity;
+  return 1;
+}
+
+/**
+ * @brief パスを出力する専用の関数を定義する
+ *
+ * 種類ごとの関数を 1 つの定義から作成する。 match_dirs / match_files には
+ * 定数を指定するので、種類の判定はコンパイル時に消える。
+ * efind_next と同じく、ディレクトリのエントリを集めて閉じてから中に
+ * 降りていくので、開いているディレクトリは深さによらず 1 つだけになる
+ *
+ * @param name 開始パスを受け取る関数の名前
+ * @param match_dirs ディレクトリを出力する場合は 1
+ * @param match_files ディレクトリ以外を出力する場合は 1
+ */
+#define DEFINE_FAST_PRINT(name, match_dirs, match_files)                     \
+  static int name##_directory(FastPrint *fp, const int len,                  \
+                              const int depth) {                             \
+    DIR *dir;                                                                \
+    struct dirent *entry;                                                    \
+    EntryBatch batch;                                                        \
+    int status = 0;                                                          \
+                                                                             \
+    if (fp->maxdepth >= 0 && depth >= fp->maxdepth) {                        \
+      return 0;                                                              \
+    }                                                                        \
+    if ((dir = opendir(fp->path)) == NULL) {                                 \
+      fprintf(stderr, "Cannot open directory '%s': %s\n", fp->path,          \
+              strerror(errno));                                              \
+      return (depth == 0) ? 1 : 0;                                           \
+    }                                                                        \
+    if (!batch_init(&batch)) {                                               \
+      closedir(dir);                                                         \
+      return 1;                                                              \
+    }                                                                        \
+    while ((entry = readdir(dir)) != NULL) {                                 \
+      const char *entry_name = entry->d_name;                                \
+      if (entry_name[0] == '.' &&                                            \
+          (entry_name[1] == '\0' ||                                          \
+           (entry_name[1] == '.' && entry_name[2] == '\0'))) {               \
+        continue;                                                            \
+      }                                                                      \
+      if (!batch_add_entry(&batch, entry_name, is_directory_entry(entry),    \
+                           0)) {                                             \
+        status = 1; /* メモリ不足 */                                         \
+        break;                                                               \
+      }                                                                      \
+    }                                                                        \
+    closedir(dir);                                                           \
+                                                                             \
+    for (int i = 0; i < batch.count && status == 0; i++) {                   \
+      int is_dir = MASK_TEST(batch.is_dir, i);                               \
+      int name_len = BATCH_NAME_LEN(&batch, i);                              \
+      if (!fast_print_reserve(fp, len + name_len + 2)) {                     \
+        status = 1;                                                          \
+        break;                                                               \
+      }                                                                      \
+      memcpy(fp->path + len, BATCH_NAME(&batch, i), name_len);               \
+      if (is_dir ? (match_dirs) : (match_files)) {                           \
+        fp->path[len + name_len] = '\n';                                     \
+        fwrite(fp->path, 1, len + name_len + 1, fp->stream);                 \
+      }                                                                      \
+      if (is_dir) {                                                          \
+        fp->path[len + name_len] = '/';                                      \
+        fp->path[len + name_len + 1] = '\0';                                 \
+        status = name##_directory(fp, len + name_len + 1, depth + 1);        \
+      }                                                                      \
+    }                                                                        \
+    batch_free(&batch);                                                      \
+    return status;                                                           \
+  }                                                                          \
+                                                                             \
+  static int name(const char *root, const Options *query, FILE *stream) {    \
+    FastPrint fp = {NULL, 0, query->maxdepth, stream};                       \
+                                                                             \
+    /* 開始パスが通常ファイルの場合はそのファイルだけを出力する */           \
+    if (is_existing_regular_file(root)) {                                    \
+      if (match_files) {                                                     \
+        fprintf(stream, "%s\n", root);                                       \
+      }                                                                      \
+      return 0;                                                              \
+    }                                                                        \
+    fp.path = make_directory_prefix(root);                                   \
+    if (fp.path == NULL) {                                                   \
+      return 1;                                                              \
+    }                                                                        \
+    fp.capacity = strlen(fp.path) + 1;                                       \
+    int status = name##_directory(&fp, fp.capacity - 1, 0);                  \
+    free(fp.path);                                                           \
+    return status;                                                           \
+  }
+
+DEFINE_FAST_PRINT(fast_print_all, 1, 1)
+DEFINE_FAST_PRINT(fast_print_files, 0, 1)
+DEFINE_FAST_PRINT(fast_print_dirs, 1, 0)
+
+EfindPrintFunction efind_select_print(const Options *query) {
+  // 出力先が標準出力の -print だけであること
+  for (int i = 0; i < query->action_count; i++) {
+    const Action *action = &query->actions[i];
+    if (action->type != ACTION_PRINT || action->stream_name != NULL) {
+      return NULL;
+    }
+  }
+  if (query->action_count > 1 || query->index != NULL ||
+      query->follow == FOLLOW_ALL || query->sort) {
+    return NULL;
+  }
+
+  if (query->condition_count == 0) {
+    return fast_print_all;
+  }
+  const Condition *cond = &query->conditions[0];
+  if (query->condition_count > 1 || cond->pattern != NULL ||
+      cond->regex != NULL || cond->meta != META_NONE ||
+      cond->content != NULL) {
+    return NULL;
+  }
+  switch (cond->type) {
+    case TYPE_FILE:
+      return fast_print_files;
+    case TYPE_DIR:
+      return fast_print_dirs;
+    default:
+      return NULL;
+  }
+}
+
+/**
+ * @brief ビット集合の 1 ワードのうち立っているビットの数を数える
+ *
+ * @param[in] bits ビット集合の 1 ワード
+ * @return 立っているビットの数
+ */
+static int count_bits(MaskWord bits) {
+  int count = 0;
+  for (; bits; bits &= bits - 1) {
+    count++;
+  }
+  return count;
+}
+
+/**
+ * @brief ディレクトリ 1 階層分の一致したエントリを集計する
+ *
+ * 数はビット集合から直接数え、エントリのパスは作成しない。サイズを集計する
+ * 場合だけ、一致したディレクトリ以外のエントリのパスを作成してメタデータを
+ * 取得する
+ *
+ * @param[in,out] it 検索中の状態
+ * @param[in,out] frame 集計するディレクトリの状態
+ * @param[in,out] summary 集計の結果
+ * @return 成功時は 1、メモリ不足の場合は 0
+ */
+static int summarize_frame(EfindIterator *it, SearchFrame *frame,
+                           EfindSummary *summary) {
+  EntryBatch *batch = &frame->batch;
+  unsigned long matches = 0;
+  unsigned long dirs = 0;
+
+  for (int w = 0; w < MASK_WORDS(batch->count); w++) {
+    matches += count_bits(batch->match[w]);
+    dirs += count_bits(batch->match[w] & batch->is_dir[w]);
+  }
+  if (matches == 0) {
+    return 1;
+  }
+  summary->count += matches;
+  summary->dir_count += dirs;
+
+  if (frame->entry_depth >= summary->depth_capacity) {
+    int new_capacity = summary->depth_capacity ? summary->depth_capacity : 16;
+    while (frame->entry_depth >= new_capacity) {
+      new_capacity *= 2;
+    }
+    unsigned long *new_counts = (unsigned long *)realloc(
+        summary->depth_counts, sizeof(unsigned long) * new_capacity);
+    if (new_counts == NULL) {
+      fprintf(stderr, "Memory allocation error\n");
+      return 0;
+    }
+    memset(new_counts + summary->depth_capacity, 0,
+           sizeof(unsigned long) * (new_capacity - summary->depth_capacity));
+    summary->depth_counts = new_counts;
+    summary->depth_capacity = new_capacity;
+  }
+  summary->depth_counts[frame->entry_depth] += matches;
+
+  // 条件の評価で取得済みのメタデータはそのまま使い、残りはまとめて取得する
+  if (it->size_callback != NULL) {
+    if (batch_load_info(batch, batch->match, 1) < 0) {
+      return 0;
+    }
+    for (int w = 0; w < MASK_WORDS(batch->count); w++) {
+      MaskWord bits =
+          batch->match[w] & ~batch->is_dir[w] & batch->info_valid[w];
+      for (int bit = 0; bits; bit++, bits >>= 1) {
+        if (bits & 1) {
+          frame->kbytes +=
+              (batch->infos[w * MASK_BITS + bit].size + 1023) / 1024;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+int efind_summarize(const char *root, const Options *query,
+                    EfindSummary *summary, EfindSizeCallback size_callback,
+                    void *user_data) {
+  EfindIterator *it = efind_open(root, query);
+
+  if (it == NULL) {
+    return 1;
+  }
+  it->size_callback = size_callback;
+  it->user_data = user_data;
+
+  while (it->frame_count > 0) {
+    SearchFrame *frame = &it->frames[it->frame_count - 1];
+
+    if (frame->pending_dir >= 0) {
+      descend_pending_dir(it, frame);
+      continue;
+    }
+
+    // 初めて処理するディレクトリは、エントリ全体をまとめて集計する
+    if (frame->next_index == 0 && !summarize_frame(it, frame, summary)) {
+      it->status = 1;
+      break;
+    }
+
+    // 次のサブディレクトリを探し、なければスタックから降ろす
+    int i = frame->next_index;
+    while (i < frame->batch.count && !MASK_TEST(frame->batch.is_dir, i)) {
+      i++;
+    }
+    if (i >= frame->batch.count) {
+      pop_frame(it);
+      continue;
+    }
+    frame->next_index = i + 1;
+    frame->pending_dir = i;
+  }
+  return efind_close(it);
+}
+
+void efind_summary_free(EfindSummary *summary) {
+  free(summary->depth_counts);
+  summary->depth_counts = NULL;
+  summary->depth_capacity = 0;
 }
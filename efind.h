@@ -1,7 +1,15 @@
 #ifndef EFIND_H
 #define EFIND_H
 
+#include <stdio.h>
+#include <time.h>
+
+#include "arch.h"
+#include "exec_command.h"
+#include "regex_dfa.h"
+
 #define MAX_CONDITIONS 100  // 条件の最大数
+#define MAX_ACTIONS 16      // アクションの最大数
 
 /**
  * @brief 論理演算子を表す列挙型
@@ -27,18 +35,118 @@ typedef enum {
   TYPE_EXECUTABLE  // 実行可能ファイル
 } FileType;
 
+/**
+ * @brief シンボリックリンクをたどる範囲を表す列挙型
+ *
+ * @enum FollowMode
+ */
+typedef enum {
+  FOLLOW_ROOTS,  // 開始パスのリンクだけをたどる (-H 、デフォルト)
+  FOLLOW_ALL     // すべてのリンクをたどる (-L)
+} FollowMode;
+
+/**
+ * @brief 名前パターンの形状を表す列挙型
+ *
+ * 引数解析時にパターンを調べて判定し、形状に応じた照合処理を選択するために使用する
+ *
+ * @enum PatternShape
+ */
+typedef enum {
+  SHAPE_GENERIC,  // 汎用のワイルドカード照合が必要なパターン
+  SHAPE_ANY,      // "*" : 任意の名前に一致
+  SHAPE_EXACT,    // "literal" : 完全一致
+  SHAPE_PREFIX,   // "literal*" : 前方一致
+  SHAPE_SUFFIX,   // "*literal" : 後方一致
+  SHAPE_INFIX     // "*literal*" : 部分一致
+} PatternShape;
+
+/**
+ * @brief ファイルのメタデータを参照する条件の種類を表す列挙型
+ *
+ * @enum MetaTest
+ */
+typedef enum {
+  META_NONE,   // メタデータを参照しない
+  META_SIZE,   // -size : サイズを単位数で比較
+  META_MTIME,  // -mtime / -mmin : 最終更新からの経過時間を単位数で比較
+  META_NEWER,  // -newer : 基準の日時より後に更新されたかどうか
+  META_EMPTY   // -empty : 空のファイルまたはディレクトリかどうか
+} MetaTest;
+
+/**
+ * @brief -contains / -icontains で探す文字列 (content_search.h を参照)
+ *
+ * @struct ContentPattern
+ */
+typedef struct ContentPattern ContentPattern;
+
 /**
  * @brief 検索条件を表す構造体
  *
  * @struct Condition
  */
 typedef struct {
-  char *pattern;    // 検索に使用するパターン文字列
-  FileType type;    // ファイルの種類を指定するためのフィールド
-  Operator op;      // 条件を組み合わせるための演算子
-  int ignore_case;  // 大文字小文字を区別しない場合は 1、区別する場合は 0
+  char *pattern;             // 検索に使用するパターン文字列
+  FileType type;             // ファイルの種類を指定するためのフィールド
+  Operator op;               // 条件を組み合わせるための演算子
+  int ignore_case;           // 大文字小文字を区別しない場合は 1、区別する場合は 0
+  PatternShape shape;        // パターンの形状 (analyze_name_pattern で設定)
+  const char *literal;       // パターン中のリテラル部分の先頭 (pattern 内を指す)
+  int literal_len;           // リテラル部分のバイト数
+  char *regex_pattern;       // -regex / -iregex のパターン (指定されていない場合は NULL)
+  char *path_pattern;        // -path / -ipath のパターン (指定されていない場合は NULL)
+  Regex *regex;              // regex_pattern または path_pattern をコンパイルしたもの
+  MetaTest meta;             // メタデータの条件の種類
+  int meta_compare;          // 比較方法 (-1: 未満、 0: 等しい、 1: より大きい)
+  unsigned long meta_value;  // 比較する単位数
+  unsigned long meta_unit;   // 単位 (-size はバイト数、 -mtime / -mmin は秒数)
+  time_t meta_time;          // 基準の日時 (解析時に求める)
+  ContentPattern *content;   // ファイルの内容に含まれる文字列 (-contains)
 } Condition;
 
+/**
+ * @brief 条件に一致したエントリに対して行うアクションの種類を表す列挙型
+ *
+ * @enum ActionType
+ */
+typedef enum {
+  ACTION_PRINT,   // パスを出力する (-print / -fprint)
+  ACTION_PRINTF,  // 書式に従って出力する (-printf / -fprintf)
+  ACTION_EXEC     // コマンドを実行する (-exec / -execdir)
+} ActionType;
+
+/**
+ * @brief -printf のコンパイルした書式 (print_format.h を参照)
+ *
+ * @struct PrintFormat
+ */
+typedef struct PrintFormat PrintFormat;
+
+/**
+ * @brief 条件に一致したエントリに対して行うアクションを表す構造体
+ *
+ * @struct Action
+ */
+typedef struct {
+  ActionType type;          // アクションの種類
+  ExecCommand *command;     // 実行するコマンド (ACTION_EXEC のみ)
+  PrintFormat *format;      // 出力の書式 (ACTION_PRINTF のみ)
+  FILE *stream;             // 出力先 (ACTION_PRINT / ACTION_PRINTF のみ)
+  const char *stream_name;  // 出力先のファイル名 (標準出力の場合は NULL)
+  int owns_stream;          // stream を閉じる必要がある場合は 1
+} Action;
+
+/**
+ * @brief 読み込んだディレクトリの内容を保持する索引
+ *
+ * 同じツリーに対して検索を繰り返す場合に、ディレクトリを読み直さずに済む
+ * ようにする。索引の作成後にファイルシステムが変更されても反映されない
+ *
+ * @struct EfindIndex
+ */
+typedef struct EfindIndex EfindIndex;
+
 /**
  * @brief 検索オプションを表す構造体
  *
@@ -46,21 +154,443 @@ typedef struct {
  */
 typedef struct {
   int maxdepth;                          // 最大の検索深さ
+  long regex_cache_size;                 // 正規表現の DFA キャッシュの上限 (バイト)
   int condition_count;                   // 条件の数
   Condition conditions[MAX_CONDITIONS];  // 検索条件
+  int action_count;                      // アクションの数 (0 の場合は -print)
+  Action actions[MAX_ACTIONS];           // 一致したエントリに対するアクション
+  EfindIndex *index;                     // 使用する索引 (使用しない場合は NULL)
+  FollowMode follow;                     // シンボリックリンクをたどる範囲
+  unsigned long content_max_size;        // -contains で読む最大のサイズ (0 は無制限)
+  int sort;                              // エントリを名前の順に並べ替える場合は 1 (-s)
 } Options;
 
 // 関数プロトタイプ
 
 /**
- * @brief 指定されたディレクトリを再帰的に検索する
+ * @brief 名前パターンの形状を解析する
+ *
+ * cond->pattern を調べ、 shape / literal / literal_len を設定する。
+ * pattern が NULL の場合は何もしない
  *
- * @param[in] base_dir 検索を開始するディレクトリのパス
- * @param[in] current_depth 現在の検索深さ
- * @param[in] opts 検索オプションを含む構造体へのポインタ
+ * @param[in,out] cond 解析対象の条件
+ */
+void analyze_name_pattern(Condition *cond);
+
+/**
+ * @brief 検索結果のエントリ
+ *
+ * 各フィールドが指す文字列はイテレータが所有する領域を指し、次に
+ * efind_next または efind_close を呼び出すまで有効
+ *
+ * @struct EfindEntry
+ */
+typedef struct {
+  const char *path;      // パス
+  const char *dir;       // パスのうちファイル名より前の部分
+  const char *name;      // ファイル名 (path 内を指す)
+  const char *root;      // 検索を開始したパス
+  const char *relative;  // 開始パスより後の部分 (path 内を指す)
+  int depth;             // 深さ (開始パスの直下は 1、開始パスが通常ファイルなら 0)
+  int is_dir;            // ディレクトリの場合は 1
+  int attributes;        // 属性フラグ (FILE_ATTR_* 、属性の条件がある場合のみ取得)
+  const FileInfo *info;  // メタデータ (条件の評価で取得した場合のみ、それ以外は NULL)
+} EfindEntry;
+
+/**
+ * @brief 検索のイテレータ
+ *
+ * ディレクトリの階層を明示的なスタックでたどり、条件に一致したエントリを
+ * 1 つずつ返す
+ *
+ * @struct EfindIterator
+ */
+typedef struct EfindIterator EfindIterator;
+
+/**
+ * @brief efind_walk で条件に一致したエントリごとに呼び出される関数
+ *
+ * @param[in] entry 条件に一致したエントリ
+ * @param[in] user_data efind_walk に渡されたポインタ
+ * @return 検索を続ける場合は 0、中断する場合は 0 以外
+ */
+typedef int (*EfindCallback)(const EfindEntry *entry, void *user_data);
+
+/**
+ * @brief 検索を開始する
+ *
+ * @param[in] root 検索を開始するパス (ディレクトリまたは通常ファイル。
+ * イテレータを閉じるまで有効である必要がある)
+ * @param[in] query 検索条件 (efind_query_compile でコンパイル済みのもの。
+ * イテレータを閉じるまで有効である必要がある)
+ * @return イテレータ、メモリ不足の場合は NULL
+ */
+EfindIterator *efind_open(const char *root, const Options *query);
+
+/**
+ * @brief 条件に一致する次のエントリを取得する
+ *
+ * @param[in,out] it イテレータ
+ * @return 条件に一致したエントリ、検索が終了した場合は NULL
+ */
+const EfindEntry *efind_next(EfindIterator *it);
+
+/**
+ * @brief 検索を終了してイテレータを解放する
+ *
+ * @param[in] it イテレータ (NULL の場合は何もしない)
+ * @return int 成功時は 0、開始パスを検索できなかった場合は 1
+ */
+int efind_close(EfindIterator *it);
+
+/**
+ * @brief 検索して条件に一致したエントリごとに関数を呼び出す
+ *
+ * @param[in] root 検索を開始するパス
+ * @param[in] query 検索条件 (efind_query_compile でコンパイル済みのもの)
+ * @param[in] callback エントリごとに呼び出す関数
+ * @param[in] user_data callback に渡すポインタ
+ * @return int 成功時は 0、エラー時は 1
+ */
+int efind_walk(const char *root, const Options *query, EfindCallback callback,
+               void *user_data);
+
+/**
+ * @brief 検索して条件に一致したエントリのパスを出力する関数
+ *
+ * @param[in] root 検索を開始するパス
+ * @param[in] query 検索条件
+ * @param[in] stream 出力先
+ * @return int 成功時は 0、エラー時は 1
+ */
+typedef int (*EfindPrintFunction)(const char *root, const Options *query,
+                                  FILE *stream);
+
+/**
+ * @brief 条件とアクションが単純な検索のための専用の関数を選択する
+ *
+ * 条件がないか種類 (-type f / -type d) だけで、アクションが標準出力への
+ * -print だけの場合に、エントリを集めたり条件を評価したりせずに、
+ * ディレクトリを読みながら直接パスを出力する関数を返す。検索を始める前に
+ * 1 回だけ呼び出す
+ *
+ * @param[in] query 検索条件
+ * @return 専用の関数、使用できない場合は NULL (efind_walk を使用する)
+ */
+EfindPrintFunction efind_select_print(const Options *query);
+
+/**
+ * @brief efind_summarize の集計の結果
+ *
+ * 0 で初期化してから efind_summarize に渡す。複数の開始パスを続けて
+ * 集計すると、結果は合算される
+ *
+ * @struct EfindSummary
+ */
+typedef struct {
+  unsigned long count;          // 条件に一致したエントリの数
+  unsigned long dir_count;      // そのうちディレクトリの数
+  unsigned long *depth_counts;  // 深さごとの一致したエントリの数
+  int depth_capacity;           // depth_counts の要素数
+} EfindSummary;
+
+/**
+ * @brief efind_summarize でディレクトリごとのサイズの合計を受け取る関数
+ *
+ * ディレクトリの中をすべて検索し終えたときに、深い方から順に呼び出される
+ *
+ * @param[in] path ディレクトリのパス (開始パスが通常ファイルの場合はそのパス)
+ * @param[in] kbytes ディレクトリ以下の条件に一致したファイルのサイズの合計
+ * (ファイルごとに KB 単位に切り上げたもの)
+ * @param[in] user_data efind_summarize に渡されたポインタ
+ */
+typedef void (*EfindSizeCallback)(const char *path, unsigned long kbytes,
+                                  void *user_data);
+
+/**
+ * @brief 検索して条件に一致したエントリを集計する
+ *
+ * エントリのパスを作成せずに、ディレクトリごとに一致したエントリをまとめて
+ * 数える。 size_callback を指定した場合だけ、一致したファイルのメタデータを
+ * 取得してディレクトリごとのサイズの合計を求める
+ *
+ * @param[in] root 検索を開始するパス
+ * @param[in] query 検索条件 (efind_query_compile でコンパイル済みのもの)
+ * @param[in,out] summary 集計の結果
+ * @param[in] size_callback ディレクトリごとのサイズの合計を受け取る関数
+ * (サイズを集計しない場合は NULL)
+ * @param[in] user_data size_callback に渡すポインタ
  * @return int 成功時は 0、エラー時は 1
  */
-int search_directory(const char *base_dir, int current_depth,
-                     const Options *opts);
+int efind_summarize(const char *root, const Options *query,
+                    EfindSummary *summary, EfindSizeCallback size_callback,
+                    void *user_data);
+
+/**
+ * @brief 集計の結果が保持する領域を解放する
+ *
+ * @param[in,out] summary 集計の結果
+ */
+void efind_summary_free(EfindSummary *summary);
+
+/**
+ * @brief 監視の状態 (efind_watch_create で作成する)
+ *
+ * @struct EfindWatch
+ */
+typedef struct EfindWatch EfindWatch;
+
+/**
+ * @brief efind_watch_scan で条件に一致しなくなったパスを受け取る関数
+ *
+ * @param[in] path 前回の検索で条件に一致し、今回は一致しなかったパス
+ * @param[in] user_data efind_watch_scan に渡されたポインタ
+ */
+typedef void (*EfindRemovedCallback)(const char *path, void *user_data);
+
+/**
+ * @brief 検索結果の変化の監視を開始する
+ *
+ * @param[in,out] query 検索条件 (efind_query_compile でコンパイル済みのもの。
+ * 監視を終了するまで有効である必要がある。経過時間の条件の基準は検索ごとに
+ * 更新する)
+ * @return 監視の状態、メモリ不足の場合は NULL
+ */
+EfindWatch *efind_watch_create(Options *query);
+
+/**
+ * @brief 検索して、前回の検索からの結果の変化を通知する
+ *
+ * 前回の検索で一致していなかったエントリ (最初の検索ではすべてのエントリ) に
+ * ついて added を、一致しなくなったパスについて removed を呼び出す。
+ * 名前の変更は削除と追加として通知される
+ *
+ * @param[in,out] watch 監視の状態
+ * @param[in] roots 検索を開始するパスの配列
+ * @param[in] root_count roots の要素数
+ * @param[in] added 新たに一致したエントリごとに呼び出す関数 (戻り値は無視する)
+ * @param[in] removed 一致しなくなったパスごとに呼び出す関数 (NULL 可)
+ * @param[in] user_data added と removed に渡すポインタ
+ * @return int 成功時は 0、エラー時は 1
+ */
+int efind_watch_scan(EfindWatch *watch, char *const roots[],
+                     const int root_count, EfindCallback added,
+                     EfindRemovedCallback removed, void *user_data);
+
+/**
+ * @brief 監視を終了して状態を解放する
+ *
+ * @param[in] watch 監視の状態 (NULL の場合は何もしない)
+ */
+void efind_watch_free(EfindWatch *watch);
+
+/**
+ * @brief 空の索引を作成する
+ *
+ * 検索条件の index に設定すると、その検索で読み込んだディレクトリの内容が
+ * 索引に追加され、以降の検索で再利用される
+ *
+ * @return 作成した索引、メモリ不足の場合は NULL
+ */
+EfindIndex *efind_index_create(void);
+
+/**
+ * @brief 索引に追加するディレクトリの範囲を追加する
+ *
+ * 範囲を 1 つ以上追加すると、いずれかの範囲のパスと同じか、その下にある
+ * ディレクトリだけを索引に追加する。範囲がない場合はすべて追加する
+ *
+ * @param[in,out] index 索引
+ * @param[in] path 範囲とするディレクトリのパス
+ * @return 成功時は 1、メモリ不足の場合は 0
+ */
+int efind_index_add_scope(EfindIndex *index, const char *path);
+
+/**
+ * @brief 索引を解放する
+ *
+ * @param[in] index 解放する索引 (NULL の場合は何もしない)
+ */
+void efind_index_free(EfindIndex *index);
+
+/**
+ * @brief 検索条件を初期化する
+ *
+ * 条件とアクションはなし、深さの制限もなしの状態にする
+ *
+ * @param[out] query 初期化する検索条件
+ */
+void efind_query_init(Options *query);
+
+/**
+ * @brief 条件を追加する
+ *
+ * 追加した条件はすべてのフィールドを「指定なし」で初期化し、
+ * 次の条件とは AND で結合する
+ *
+ * @param[in,out] query 検索条件
+ * @return 追加した条件へのポインタ、条件数が上限を超える場合は NULL
+ */
+Condition *efind_query_add_condition(Options *query);
+
+/**
+ * @brief ファイルタイプの条件 (-type) を追加する
+ *
+ * @param[in,out] query 検索条件
+ * @param[in] type ファイルタイプ
+ * @return 成功時は 1 、エラー時は 0
+ */
+int efind_query_add_type(Options *query, FileType type);
+
+/**
+ * @brief 名前パターンの条件 (-name / -iname) を追加する
+ *
+ * @param[in,out] query 検索条件
+ * @param[in] pattern パターン (検索条件を解放するまで有効である必要がある)
+ * @param[in] ignore_case 大文字小文字を区別しない場合は 1、区別する場合は 0
+ * @return 成功時は 1 、エラー時は 0
+ */
+int efind_query_add_name(Options *query, const char *pattern,
+                         int ignore_case);
+
+/**
+ * @brief 正規表現の条件 (-regex / -iregex) を追加する
+ *
+ * @param[in,out] query 検索条件
+ * @param[in] pattern 正規表現 (検索条件を解放するまで有効である必要がある)
+ * @param[in] ignore_case 大文字小文字を区別しない場合は 1、区別する場合は 0
+ * @return 成功時は 1 、エラー時は 0
+ */
+int efind_query_add_regex(Options *query, const char *pattern,
+                          int ignore_case);
+
+/**
+ * @brief パスのパターンの条件 (-path / -ipath) を追加する
+ *
+ * @param[in,out] query 検索条件
+ * @param[in] pattern パターン (検索条件を解放するまで有効である必要がある)
+ * @param[in] ignore_case 大文字小文字を区別しない場合は 1、区別する場合は 0
+ * @return 成功時は 1 、エラー時は 0
+ */
+int efind_query_add_path(Options *query, const char *pattern,
+                         int ignore_case);
+
+/**
+ * @brief サイズの条件 (-size) を追加する
+ *
+ * @param[in,out] query 検索条件
+ * @param[in] arg 単位数 ("+" で始まる場合はより大きい、 "-" で始まる場合は
+ * 未満) と単位 (c: バイト、 w: 2 バイト、 b: 512 バイト (省略時)、 k: KB 、
+ * M: MB 、 G: GB)
+ * @return 成功時は 1 、エラー時は 0
+ */
+int efind_query_add_size(Options *query, const char *arg);
+
+/**
+ * @brief 最終更新からの経過時間の条件 (-mtime / -mmin) を追加する
+ *
+ * 経過時間は条件を追加した時刻 (efind_query_update_time で更新できる) から
+ * 求め、単位未満は切り捨てる
+ *
+ * @param[in,out] query 検索条件
+ * @param[in] arg 単位数 ("+" で始まる場合はより大きい、 "-" で始まる場合は
+ * 未満)
+ * @param[in] unit 単位の秒数 (-mtime は 86400 、 -mmin は 60)
+ * @return 成功時は 1 、エラー時は 0
+ */
+int efind_query_add_mtime(Options *query, const char *arg,
+                          unsigned long unit);
+
+/**
+ * @brief 基準のファイルより後に更新されたかどうかの条件 (-newer) を追加する
+ *
+ * 基準のファイルの最終更新日時は、条件を追加するときに 1 回だけ取得する
+ *
+ * @param[in,out] query 検索条件
+ * @param[in] path 基準のファイルのパス
+ * @return 成功時は 1 、エラー時は 0
+ */
+int efind_query_add_newer(Options *query, const char *path);
+
+/**
+ * @brief 経過時間の条件 (-mtime / -mmin) の基準を現在の日時にする
+ *
+ * 同じ検索条件で検索を繰り返す場合に、検索の前に呼び出す
+ *
+ * @param[in,out] query 検索条件
+ */
+void efind_query_update_time(Options *query);
+
+/**
+ * @brief 空のファイルまたはディレクトリの条件 (-empty) を追加する
+ *
+ * @param[in,out] query 検索条件
+ * @return 成功時は 1 、エラー時は 0
+ */
+int efind_query_add_empty(Options *query);
+
+/**
+ * @brief ファイルの内容に文字列が含まれるかどうかの条件 (-contains /
+ * -icontains) を追加する
+ *
+ * ファイルを読む必要があるため、同じ AND の並びの中では常に他の条件より
+ * 後に評価する。ディレクトリには一致しない
+ *
+ * @param[in,out] query 検索条件
+ * @param[in] text 探す文字列
+ * @param[in] ignore_case 英字の大文字小文字を区別しない場合は 1
+ * @return 成功時は 1 、エラー時は 0
+ */
+int efind_query_add_contains(Options *query, const char *text,
+                             int ignore_case);
+
+/**
+ * @brief 最後に追加した条件と次の条件を OR で結合する (-o)
+ *
+ * @param[in,out] query 検索条件
+ * @return 成功時は 1 、条件がまだない場合は 0
+ */
+int efind_query_or(Options *query);
+
+/**
+ * @brief アクションを追加する
+ *
+ * 出力先は標準出力に初期化する
+ *
+ * @param[in,out] query 検索条件
+ * @param[in] type アクションの種類
+ * @return 追加したアクションへのポインタ、アクション数が上限を超える場合は NULL
+ */
+Action *efind_query_add_action(Options *query, ActionType type);
+
+/**
+ * @brief アクションの出力先をファイルにする (-fprint / -fprintf)
+ *
+ * 同じファイル名を指定したアクションどうしは同じストリームを共有する
+ *
+ * @param[in,out] query 検索条件
+ * @param[in,out] action 出力先を設定するアクション
+ * @param[in] path 出力先のファイル名 (検索条件を解放するまで有効である必要が
+ * ある)
+ * @return 成功時は 1 、ファイルを開けない場合は 0
+ */
+int efind_query_set_output(Options *query, Action *action, const char *path);
+
+/**
+ * @brief 検索条件の正規表現とパスのパターンをコンパイルする
+ *
+ * 条件をすべて追加した後、検索を開始する前に呼び出す
+ *
+ * @param[in,out] query 検索条件
+ * @return 成功時は 1 、エラー時は 0
+ */
+int efind_query_compile(Options *query);
+
+/**
+ * @brief 検索条件が保持するリソースを解放する
+ *
+ * @param[in,out] query 検索条件
+ */
+void efind_query_free(Options *query);
 
 #endif /* EFIND_H */
@@ -0,0 +1,258 @@
+#include "exec_command.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "arch.h"
+
+/**
+ * @brief 引数 1 つがコマンドライン上で占める長さを求める
+ *
+ * 引用符と区切りの空白の分を含めて見積もる
+ */
+#define ARG_LINE_LEN(arg) ((int)strlen(arg) + 3)
+
+#define SAVED_DIR_SIZE 1024  // -execdir で戻るディレクトリのパスのバッファサイズ
+
+ExecCommand *exec_command_create(char **args, int arg_count, int in_dir,
+                                 int batch) {
+  ExecCommand *cmd = (ExecCommand *)calloc(1, sizeof(ExecCommand));
+  if (cmd == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    return NULL;
+  }
+  cmd->args = args;
+  cmd->arg_count = arg_count;
+  cmd->in_dir = in_dir;
+  cmd->batch = batch;
+  for (int i = 0; i < arg_count; i++) {
+    cmd->base_len += ARG_LINE_LEN(args[i]);
+  }
+  return cmd;
+}
+
+/**
+ * @brief 文字列中の "{}" をすべてパスに置き換えた文字列を作成する
+ *
+ * @param[in] arg 置き換える文字列
+ * @param[in] path パス
+ * @return 置き換えた文字列 (呼び出し元で解放する)、メモリ不足の場合は NULL
+ */
+static char *replace_braces(const char *arg, const char *path) {
+  int count = 0;
+  for (const char *p = strstr(arg, "{}"); p; p = strstr(p + 2, "{}")) {
+    count++;
+  }
+
+  int path_len = strlen(path);
+  char *result = (char *)malloc(strlen(arg) + count * (path_len - 2) + 1);
+  if (result == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    return NULL;
+  }
+
+  char *out = result;
+  const char *p = arg;
+  const char *brace;
+  while ((brace = strstr(p, "{}")) != NULL) {
+    memcpy(out, p, brace - p);
+    out += brace - p;
+    memcpy(out, path, path_len);
+    out += path_len;
+    p = brace + 2;
+  }
+  strcpy(out, p);
+  return result;
+}
+
+/**
+ * @brief 指定されたディレクトリでコマンドを実行する
+ *
+ * @param[in] argv コマンドと引数 (NULL 終端)
+ * @param[in] dir 実行するディレクトリ (NULL または空文字列の場合は
+ * カレントディレクトリ)
+ * @return コマンドが成功した場合は 1、失敗した場合は 0
+ */
+static int run_in_directory(char *const argv[], const char *dir) {
+  char saved_dir[SAVED_DIR_SIZE];
+
+  if (dir != NULL && *dir == '\0') {
+    dir = NULL;
+  }
+
+  // 上限を超えるコマンドラインは DOS _EXEC に渡せないため実行しない
+  int line_len = 0;
+  for (int i = 0; argv[i] != NULL; i++) {
+    line_len += ARG_LINE_LEN(argv[i]);
+  }
+  if (line_len > get_command_line_limit()) {
+    fprintf(stderr, "Command line too long to execute '%s'\n", argv[0]);
+    return 0;
+  }
+
+  // コマンドの出力と efind の出力の順序が入れ替わらないようにする
+  fflush(stdout);
+
+  if (dir != NULL) {
+    if (getcwd(saved_dir, sizeof(saved_dir)) == NULL || chdir(dir) != 0) {
+      fprintf(stderr, "Cannot change directory to '%s'\n", dir);
+      return 0;
+    }
+  }
+
+  int status = run_command(argv);
+  if (status < 0) {
+    fprintf(stderr, "Cannot execute '%s'\n", argv[0]);
+  }
+
+  if (dir != NULL && chdir(saved_dir) != 0) {
+    fprintf(stderr, "Cannot change directory to '%s'\n", saved_dir);
+    status = -1;
+  }
+  return status == 0;
+}
+
+/**
+ * @brief ";" 形式のコマンドを 1 つのパスに対して実行する
+ *
+ * @param[in,out] cmd コマンド
+ * @param[in] dir 実行するディレクトリ (NULL の場合はカレントディレクトリ)
+ * @param[in] path "{}" を置き換えるパス
+ * @return コマンドが成功した場合は 1、失敗した場合は 0
+ */
+static int run_single(ExecCommand *cmd, const char *dir, const char *path) {
+  char **argv = (char **)calloc(cmd->arg_count + 1, sizeof(char *));
+  int ok = (argv != NULL);
+
+  for (int i = 0; ok && i < cmd->arg_count; i++) {
+    argv[i] = replace_braces(cmd->args[i], path);
+    ok = (argv[i] != NULL);
+  }
+  if (ok) {
+    ok = run_in_directory(argv, dir);
+  } else if (argv == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+  }
+
+  if (argv != NULL) {
+    for (int i = 0; i < cmd->arg_count; i++) {
+      free(argv[i]);
+    }
+    free(argv);
+  }
+  return ok;
+}
+
+int exec_command_flush(ExecCommand *cmd) {
+  if (cmd->pending_count == 0) {
+    return 1;
+  }
+
+  // コマンドと引数のあとにためておいたパスを並べて実行する
+  char **argv = (char **)malloc(sizeof(char *) *
+                                (cmd->arg_count + cmd->pending_count + 1));
+  int ok = 0;
+  if (argv != NULL) {
+    memcpy(argv, cmd->args, sizeof(char *) * cmd->arg_count);
+    memcpy(argv + cmd->arg_count, cmd->pending,
+           sizeof(char *) * cmd->pending_count);
+    argv[cmd->arg_count + cmd->pending_count] = NULL;
+    ok = run_in_directory(argv, cmd->pending_dir);
+    free(argv);
+  } else {
+    fprintf(stderr, "Memory allocation error\n");
+  }
+  if (!ok) {
+    cmd->failed = 1;
+  }
+
+  for (int i = 0; i < cmd->pending_count; i++) {
+    free(cmd->pending[i]);
+  }
+  cmd->pending_count = 0;
+  cmd->pending_len = 0;
+  free(cmd->pending_dir);
+  cmd->pending_dir = NULL;
+  return ok;
+}
+
+int exec_command_run(ExecCommand *cmd, const char *dir, const char *name) {
+  char *path = NULL;
+
+  // -execdir はエントリのあるディレクトリで "./名前" を渡す
+  path = (char *)malloc(strlen(dir) + strlen(name) + 3);
+  if (path == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    return 0;
+  }
+  sprintf(path, "%s%s", cmd->in_dir ? "./" : dir, name);
+
+  if (!cmd->batch) {
+    int ok = run_single(cmd, cmd->in_dir ? dir : NULL, path);
+    if (!ok) {
+      cmd->failed = 1;
+    }
+    free(path);
+    return ok;
+  }
+
+  // -execdir ではディレクトリが変わったら、それまでのパスを実行する
+  if (cmd->in_dir && cmd->pending_dir != NULL &&
+      strcmp(cmd->pending_dir, dir) != 0) {
+    exec_command_flush(cmd);
+  }
+
+  // パス 1 つでもコマンドラインの長さの上限を超える場合は実行できない
+  int len = ARG_LINE_LEN(path);
+  if (cmd->base_len + len > get_command_line_limit()) {
+    fprintf(stderr, "Command line too long for '%s'\n", path);
+    cmd->failed = 1;
+    free(path);
+    return 1;
+  }
+
+  // コマンドラインの長さの上限を超える場合は、それまでのパスを実行する
+  if (cmd->pending_count > 0 && cmd->base_len + cmd->pending_len + len >
+                                    get_command_line_limit()) {
+    exec_command_flush(cmd);
+  }
+
+  if (cmd->pending_count >= cmd->pending_capacity) {
+    int new_capacity = cmd->pending_capacity ? cmd->pending_capacity * 2 : 64;
+    char **new_pending =
+        (char **)realloc(cmd->pending, sizeof(char *) * new_capacity);
+    if (new_pending == NULL) {
+      fprintf(stderr, "Memory allocation error\n");
+      free(path);
+      return 0;
+    }
+    cmd->pending = new_pending;
+    cmd->pending_capacity = new_capacity;
+  }
+  if (cmd->in_dir && cmd->pending_dir == NULL) {
+    cmd->pending_dir = strdup(dir);
+    if (cmd->pending_dir == NULL) {
+      fprintf(stderr, "Memory allocation error\n");
+      free(path);
+      return 0;
+    }
+  }
+
+  cmd->pending[cmd->pending_count++] = path;
+  cmd->pending_len += len;
+  return 1;
+}
+
+void exec_command_free(ExecCommand *cmd) {
+  if (cmd == NULL) {
+    return;
+  }
+  for (int i = 0; i < cmd->pending_count; i++) {
+    free(cmd->pending[i]);
+  }
+  free(cmd->pending);
+  free(cmd->pending_dir);
+  free(cmd);
+}
@@ -0,0 +1,68 @@
+#ifndef EXEC_COMMAND_H
+#define EXEC_COMMAND_H
+
+/**
+ * @brief -exec / -execdir で実行するコマンド
+ *
+ * ";" 形式ではエントリごとに "{}" をパスに置き換えて実行し、 "{} +" 形式では
+ * コマンドラインの長さの上限に収まるだけパスをためてからまとめて実行する
+ *
+ * @struct ExecCommand
+ */
+typedef struct {
+  char **args;           // コマンドと引数 (コマンドライン引数の配列内を指す)
+  int arg_count;         // args の要素数 ("{} +" 形式の最後の "{}" を含まない)
+  int in_dir;            // -execdir の場合は 1 (エントリのあるディレクトリで実行)
+  int batch;             // "{} +" 形式の場合は 1
+  char **pending;        // "{} +" 形式で実行を待っているパス
+  int pending_count;     // 実行を待っているパスの数
+  int pending_capacity;  // pending の容量
+  int pending_len;       // 実行を待っているパスのコマンドライン上の長さ
+  char *pending_dir;     // -execdir で実行を待っているパスのディレクトリ
+  int base_len;          // args 部分のコマンドライン上の長さ
+  int failed;            // 実行したコマンドが 1 度でも失敗した場合は 1
+} ExecCommand;
+
+/**
+ * @brief コマンドを作成する
+ *
+ * @param[in] args コマンドと引数 (終端の ";" 、 "{} +" を含まない)
+ * @param[in] arg_count args の要素数
+ * @param[in] in_dir -execdir の場合は 1、 -exec の場合は 0
+ * @param[in] batch "{} +" 形式の場合は 1、 ";" 形式の場合は 0
+ * @return 作成したコマンド、メモリ不足の場合は NULL
+ */
+ExecCommand *exec_command_create(char **args, int arg_count, int in_dir,
+                                 int batch);
+
+/**
+ * @brief エントリに対してコマンドを実行する
+ *
+ * "{} +" 形式ではパスをためておき、コマンドラインの長さの上限に達した場合や
+ * (-execdir で) ディレクトリが変わった場合にまとめて実行する
+ * (パス 1 つでも上限を超える場合は、エラーを表示して失敗として記録する)
+ *
+ * @param[in,out] cmd コマンド
+ * @param[in] dir エントリのあるディレクトリのパス (区切り文字で終わる)
+ * @param[in] name エントリの名前
+ * @return ";" 形式ではコマンドが成功した場合は 1、失敗した場合は 0。
+ * "{} +" 形式ではメモリ不足の場合を除き 1
+ */
+int exec_command_run(ExecCommand *cmd, const char *dir, const char *name);
+
+/**
+ * @brief "{} +" 形式で実行を待っているパスがあれば実行する
+ *
+ * @param[in,out] cmd コマンド
+ * @return 成功時は 1、失敗時は 0
+ */
+int exec_command_flush(ExecCommand *cmd);
+
+/**
+ * @brief コマンドを解放する
+ *
+ * @param[in] cmd 解放するコマンド (NULL の場合は何もしない)
+ */
+void exec_command_free(ExecCommand *cmd);
+
+#endif /* EXEC_COMMAND_H */
@@ -1,8 +1,11 @@
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "arch.h"
 #include "efind.h"
+#include "print_format.h"
 
 /**
  * @brief ヘルプメッセージを出力する関数
@@ -11,13 +14,57 @@ static void print_help(void) {
   printf(
       "Usage: efind [starting-point...] [expression]\n\n"
       "Options:\n"
+      "  -H                 Follow symbolic links only for starting points "
+      "(default)\n"
+      "  -L                 Follow all symbolic links (each directory is "
+      "visited once)\n"
       "  -maxdepth LEVELS   Maximum directory depth to search\n"
+      "  -s                 Process the entries of each directory in name "
+      "order\n"
+      "  -nodup             Skip starting points inside another starting "
+      "point\n"
       "  -type TYPE         File type to search for\n"
       "                     (f: file, d: directory, l: symbolic link, x: "
       "executable)\n"
       "  -name PATTERN      Search for files matching PATTERN (case "
       "insensitive)\n"
       "  -iname PATTERN     Same as -name, case insensitive\n"
+      "  -regex PATTERN     Search for paths matching regular expression\n"
+      "  -iregex PATTERN    Same as -regex, case insensitive\n"
+      "  -path PATTERN      Search for paths matching PATTERN\n"
+      "  -ipath PATTERN     Same as -path, case insensitive\n"
+      "  -size [+-]N[cwbkMG] File size is more than/less than/exactly N units\n"
+      "  -mtime [+-]N       Last modified more than/less than/exactly N days "
+      "ago\n"
+      "  -mmin [+-]N        Same as -mtime, in minutes\n"
+      "  -newer FILE        Modified more recently than FILE\n"
+      "  -empty             Empty file or directory\n"
+      "  -contains STRING   File contents include STRING (checked last)\n"
+      "  -icontains STRING  Same as -contains, case insensitive\n"
+      "  -containsmax KBYTES Do not read files larger than KBYTES for "
+      "-contains\n"
+      "  -regexcache KBYTES Memory limit for the -regex/-path DFA cache "
+      "(default: 64)\n"
+      "  -print             Print the path of matching files (default "
+      "action)\n"
+      "  -printf FORMAT     Print matching files using FORMAT\n"
+      "                     (%%p %%f %%h %%P %%d %%s %%y %%m %%t %%Tk ...)\n"
+      "  -fprint FILE       Same as -print, write to FILE\n"
+      "  -fprintf FILE FORMAT Same as -printf, write to FILE\n"
+      "  -exec COMMAND ;    Run COMMAND for each match ({} is replaced with "
+      "the path)\n"
+      "  -exec COMMAND {} + Run COMMAND with as many matches as fit\n"
+      "  -execdir ...       Same as -exec, run in the directory of the match\n"
+      "  -count             Print only the number of matches\n"
+      "  -counttype         Print the number of matches by type (f, d)\n"
+      "  -countdepth        Print the number of matches by depth\n"
+      "  -du                Print the total size (KB) of matching files for "
+      "each directory\n"
+      "  -watch SECONDS     Rescan every SECONDS and act only on new matches\n"
+      "  -watchremoved      With -watch, also print matches that disappeared\n"
+      "  -batch FILE        Run one query per line of FILE (- for stdin),\n"
+      "                     reusing directories read by earlier queries\n"
+      "                     (must be the only argument)\n"
       "  -o                 OR operator to combine conditions\n"
       "  --help, -help      Display this help message\n"
       "  --version, -version Display version information\n");
@@ -39,6 +86,36 @@ typedef struct {
   int capacity;  // 配列の容量
 } PathList;
 
+/**
+ * @brief 集計モードの指定を保持する構造体
+ *
+ * いずれかが指定された場合は、エントリごとの出力の代わりに集計結果だけを
+ * 出力する
+ */
+typedef struct {
+  int count;     // 一致したエントリの数を出力する (-count)
+  int by_type;   // 種類ごとの数を出力する (-counttype)
+  int by_depth;  // 深さごとの数を出力する (-countdepth)
+  int sizes;     // ディレクトリごとのサイズの合計を出力する (-du)
+} SummaryMode;
+
+/**
+ * @brief 集計モードが指定されているかどうかを判定する
+ */
+#define SUMMARY_ENABLED(mode) \
+  ((mode)->count || (mode)->by_type || (mode)->by_depth || (mode)->sizes)
+
+#define BATCH_LINE_SIZE 1024  // -batch で読み込む 1 行の最大長
+#define BATCH_MAX_ARGS 128    // -batch の 1 行の引数の最大数
+
+/**
+ * @brief 監視モードの指定を保持する構造体
+ */
+typedef struct {
+  int interval;      // 検索の間隔 (秒、 0 の場合は監視しない) (-watch)
+  int show_removed;  // 一致しなくなったパスを出力する (-watchremoved)
+} WatchMode;
+
 /**
  * @brief パスリストを初期化する関数
  *
@@ -107,6 +184,186 @@ static void free_path_list(PathList *list) {
   list->count = list->capacity = 0;
 }
 
+/**
+ * @brief 開始パスの比較に使う部分の先頭を求める関数
+ *
+ * 先頭の "./" を取り除く ("." だけの場合は空文字列になる)
+ *
+ * @param[in] path 開始パス
+ * @return 比較に使う部分の先頭 (path 内を指す)
+ */
+static const char *skip_current_dir(const char *path) {
+  while (path[0] == '.' && (path[1] == '/' || path[1] == '\\')) {
+    path += 2;
+  }
+  return (strcmp(path, ".") == 0) ? path + 1 : path;
+}
+
+/**
+ * @brief 開始パスがもう一方の開始パスと同じか、その下にあるかを判定する関数
+ *
+ * パスの文字列だけで判定する ("./" の有無と末尾の区切り文字は無視する)
+ *
+ * @param[in] outer 外側の開始パス
+ * @param[in] inner 判定する開始パス
+ * @return inner が outer と同じか outer の下にある場合は 1、それ以外は 0
+ */
+static int is_nested_path(const char *outer, const char *inner) {
+  const char *o = skip_current_dir(outer);
+  const char *i = skip_current_dir(inner);
+  int o_len = strlen(o);
+  int i_len = strlen(i);
+  if (o_len > 0 && is_path_end_with_separator(o)) {
+    o_len--;
+  }
+  if (i_len > 0 && is_path_end_with_separator(i)) {
+    i_len--;
+  }
+
+  // カレントディレクトリの下には、すべての相対パスがある
+  if (o_len == 0) {
+    return !(i[0] == '/' || i[0] == '\\' ||
+             (isalpha((unsigned char)i[0]) && i[1] == ':'));
+  }
+  if (i_len < o_len || strncmp(o, i, o_len) != 0) {
+    return 0;
+  }
+  return i_len == o_len || i[o_len] == '/' || i[o_len] == '\\';
+}
+
+/**
+ * @brief ほかの開始パスと重なる開始パスがあるかどうかを判定する関数
+ *
+ * @param[in] list 検索パスのリスト
+ * @return 重なる開始パスがある場合は 1、それ以外は 0
+ */
+static int has_overlapping_paths(const PathList *list) {
+  for (int i = 0; i < list->count; i++) {
+    for (int j = 0; j < list->count; j++) {
+      if (i != j && is_nested_path(list->paths[i], list->paths[j])) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief ほかの開始パスの検索に含まれる開始パスを取り除く関数 (-nodup)
+ *
+ * 同じ開始パスは最初のものだけを残す。深さの制限がある場合は、
+ * 外側の開始パスから検索しても下の開始パスの結果がすべて得られるとは
+ * 限らないため、同じ開始パスだけを取り除く
+ *
+ * @param[in,out] list 検索パスのリスト
+ * @param[in] maxdepth 最大の検索深さ (制限なしの場合は負の値)
+ */
+static void remove_nested_paths(PathList *list, const int maxdepth) {
+  int count = 0;
+  for (int j = 0; j < list->count; j++) {
+    int nested = 0;
+    for (int i = 0; i < list->count && !nested; i++) {
+      if (i == j || list->paths[i] == NULL ||
+          !is_nested_path(list->paths[i], list->paths[j])) {
+        continue;
+      }
+      // 同じ開始パスは先に指定されたもの、それ以外は外側のものを残す
+      int same = is_nested_path(list->paths[j], list->paths[i]);
+      nested = same ? i < j : maxdepth < 0;
+    }
+    if (nested) {
+      free(list->paths[j]);
+      list->paths[j] = NULL;
+    }
+  }
+  for (int j = 0; j < list->count; j++) {
+    if (list->paths[j] != NULL) {
+      list->paths[count++] = list->paths[j];
+    }
+  }
+  list->count = count;
+}
+
+/**
+ * @brief -exec / -execdir の引数を解析する関数
+ *
+ * コマンドと引数は ";" または "{} +" で終わる
+ *
+ * @param[in] argc コマンドライン引数の数
+ * @param[in] argv コマンドライン引数の配列
+ * @param[in,out] index -exec / -execdir の位置 (解析後は終端の位置)
+ * @param[in,out] opts 解析結果を格納するためのオプション構造体へのポインタ
+ * @return 成功時は 1 、エラー時は 0 を返す
+ */
+static int parse_exec_action(int argc, char *argv[], int *index,
+                             Options *opts) {
+  const char *option = argv[*index];
+  int start = *index + 1;
+  int end = start;
+  int batch = 0;
+
+  // 終端の ";" または "{} +" を探す
+  while (end < argc) {
+    if (strcmp(argv[end], ";") == 0) {
+      break;
+    }
+    if (strcmp(argv[end], "+") == 0 && end > start &&
+        strcmp(argv[end - 1], "{}") == 0) {
+      batch = 1;
+      break;
+    }
+    end++;
+  }
+
+  // "{} +" 形式の最後の "{}" はコマンドの引数に含めない
+  int arg_count = end - start - batch;
+  if (end >= argc || arg_count <= 0) {
+    fprintf(stderr,
+            "Error: %s requires a command terminated by ';' or '{} +'\n",
+            option);
+    return 0;
+  }
+
+  Action *action = efind_query_add_action(opts, ACTION_EXEC);
+  if (action == NULL) {
+    return 0;
+  }
+  action->command = exec_command_create(
+      &argv[start], arg_count, strcmp(option, "-execdir") == 0, batch);
+  if (action->command == NULL) {
+    return 0;
+  }
+
+  *index = end;
+  return 1;
+}
+
+/**
+ * @brief -printf / -fprintf のアクションを追加する関数
+ *
+ * 書式はここで 1 回だけコンパイルし、エントリごとには解析しない
+ *
+ * @param[in,out] opts 解析結果を格納するためのオプション構造体へのポインタ
+ * @param[in] output 出力先のファイル名 (標準出力の場合は NULL)
+ * @param[in] format 書式文字列
+ * @return 成功時は 1 、エラー時は 0 を返す
+ */
+static int add_printf_action(Options *opts, const char *output,
+                             const char *format) {
+  const char *error = NULL;
+
+  Action *action = efind_query_add_action(opts, ACTION_PRINTF);
+  if (action == NULL) {
+    return 0;
+  }
+  action->format = print_format_compile(format, &error);
+  if (action->format == NULL) {
+    fprintf(stderr, "Error: invalid format '%s': %s\n", format, error);
+    return 0;
+  }
+  return output == NULL || efind_query_set_output(opts, action, output);
+}
+
 /**
  * @brief コマンドライン引数を解析する関数
  *
@@ -114,13 +371,20 @@ static void free_path_list(PathList *list) {
  * @param[in] argv コマンドライン引数の配列
  * @param[out] opts 解析結果を格納するためのオプション構造体へのポインタ
  * @param[out] paths 検索パスのリストへのポインタ
+ * @param[out] summary 集計モードの指定
+ * @param[out] watch 監視モードの指定
+ * @param[out] batch_file 検索条件を読み込むファイル名 (-batch が指定されて
+ * いない場合は NULL)
  * @return 成功時は 1 、エラー時は 0 を返す
  */
-static int parse_args(int argc, char *argv[], Options *opts, PathList *paths) {
-  // デフォルト値の設定
-  opts->maxdepth =
-      -1;  // 最大深さのデフォルト値を設定 (-1 は制限なしを意味する)
-  opts->condition_count = 0;  // 条件の数を初期化
+static int parse_args(int argc, char *argv[], Options *opts, PathList *paths,
+                      SummaryMode *summary, WatchMode *watch,
+                      const char **batch_file) {
+  // デフォルト値の設定 (条件なし、深さの制限なし、集計なし、監視なし)
+  efind_query_init(opts);
+  memset(summary, 0, sizeof(*summary));
+  memset(watch, 0, sizeof(*watch));
+  *batch_file = NULL;
 
   // コマンドライン引数がない場合はカレントディレクトリを検索パスに設定
   if (argc < 2) {
@@ -129,6 +393,7 @@ static int parse_args(int argc, char *argv[], Options *opts, PathList *paths) {
   }
 
   int found_search_path = 0;  // 検索パスが見つかったかどうかのフラグ
+  int remove_nested = 0;      // 重なる開始パスを取り除くかどうかのフラグ
 
   for (int i = 1; i < argc; i++) {
     if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-help") == 0) {
@@ -138,6 +403,14 @@ static int parse_args(int argc, char *argv[], Options *opts, PathList *paths) {
                strcmp(argv[i], "-version") == 0) {
       print_version();
       return 0;
+    } else if (strcmp(argv[i], "-H") == 0) {
+      opts->follow = FOLLOW_ROOTS;
+    } else if (strcmp(argv[i], "-L") == 0) {
+      opts->follow = FOLLOW_ALL;
+    } else if (strcmp(argv[i], "-nodup") == 0) {
+      remove_nested = 1;
+    } else if (strcmp(argv[i], "-s") == 0) {
+      opts->sort = 1;
     } else if (strcmp(argv[i], "-maxdepth") == 0) {
       if (i + 1 < argc) {
         opts->maxdepth = atoi(argv[++i]);
@@ -147,36 +420,28 @@ static int parse_args(int argc, char *argv[], Options *opts, PathList *paths) {
       }
     } else if (strcmp(argv[i], "-type") == 0) {
       if (i + 1 < argc) {
-        // 条件数のチェックを追加
-        if (opts->condition_count >= MAX_CONDITIONS) {
-          fprintf(stderr, "Error: Too many conditions (maximum is %d)\n",
-                  MAX_CONDITIONS);
-          return 0;
-        }
-
-        Condition *cond = &opts->conditions[opts->condition_count++];
-        cond->pattern = NULL;
-        cond->op = OP_AND;
-        cond->ignore_case = 0;  // デフォルトは大文字小文字を区別する
-
+        FileType file_type;
         char type = argv[++i][0];
         switch (type) {
           case 'f':
-            cond->type = TYPE_FILE;
+            file_type = TYPE_FILE;
             break;
           case 'd':
-            cond->type = TYPE_DIR;
+            file_type = TYPE_DIR;
             break;
           case 'l':
-            cond->type = TYPE_SYMLINK;
+            file_type = TYPE_SYMLINK;
             break;
           case 'x':
-            cond->type = TYPE_EXECUTABLE;
+            file_type = TYPE_EXECUTABLE;
             break;
           default:
             fprintf(stderr, "Error: invalid type '%c'\n", type);
             return 0;
         }
+        if (!efind_query_add_type(opts, file_type)) {
+          return 0;
+        }
       } else {
         fprintf(stderr, "Error: -type requires an argument\n");
         return 0;
@@ -184,29 +449,164 @@ static int parse_args(int argc, char *argv[], Options *opts, PathList *paths) {
     } else if (strcmp(argv[i], "-name") == 0 ||
                strcmp(argv[i], "-iname") == 0) {
       if (i + 1 < argc) {
-        // 条件数のチェックを追加
-        if (opts->condition_count >= MAX_CONDITIONS) {
-          fprintf(stderr, "Error: Too many conditions (maximum is %d)\n",
-                  MAX_CONDITIONS);
+        // -name と -iname で大文字小文字の区別フラグを設定
+        int ignore_case = (strcmp(argv[i], "-iname") == 0) ? 1 : 0;
+        if (!efind_query_add_name(opts, argv[++i], ignore_case)) {
           return 0;
         }
-
-        Condition *cond = &opts->conditions[opts->condition_count++];
-        cond->pattern = argv[++i];
-        cond->type = TYPE_NONE;
-        cond->op = OP_AND;
-
-        // -name と -iname で大文字小文字の区別フラグを設定
-        cond->ignore_case = (strcmp(argv[i - 1], "-iname") == 0) ? 1 : 0;
       } else {
         fprintf(stderr, "Error: %s requires an argument\n", argv[i]);
         return 0;
       }
-    } else if (strcmp(argv[i], "-o") == 0) {
-      if (opts->condition_count > 0) {
-        opts->conditions[opts->condition_count - 1].op = OP_OR;
+    } else if (strcmp(argv[i], "-regex") == 0 ||
+               strcmp(argv[i], "-iregex") == 0) {
+      if (i + 1 < argc) {
+        int ignore_case = (strcmp(argv[i], "-iregex") == 0) ? 1 : 0;
+        if (!efind_query_add_regex(opts, argv[++i], ignore_case)) {
+          return 0;
+        }
+      } else {
+        fprintf(stderr, "Error: %s requires an argument\n", argv[i]);
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-path") == 0 ||
+               strcmp(argv[i], "-ipath") == 0) {
+      if (i + 1 < argc) {
+        int ignore_case = (strcmp(argv[i], "-ipath") == 0) ? 1 : 0;
+        if (!efind_query_add_path(opts, argv[++i], ignore_case)) {
+          return 0;
+        }
+      } else {
+        fprintf(stderr, "Error: %s requires an argument\n", argv[i]);
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-size") == 0) {
+      if (i + 1 < argc) {
+        if (!efind_query_add_size(opts, argv[++i])) {
+          return 0;
+        }
+      } else {
+        fprintf(stderr, "Error: -size requires an argument\n");
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-mtime") == 0 ||
+               strcmp(argv[i], "-mmin") == 0) {
+      if (i + 1 < argc) {
+        unsigned long unit = (strcmp(argv[i], "-mmin") == 0) ? 60 : 86400;
+        if (!efind_query_add_mtime(opts, argv[++i], unit)) {
+          return 0;
+        }
+      } else {
+        fprintf(stderr, "Error: %s requires an argument\n", argv[i]);
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-newer") == 0) {
+      if (i + 1 < argc) {
+        if (!efind_query_add_newer(opts, argv[++i])) {
+          return 0;
+        }
+      } else {
+        fprintf(stderr, "Error: -newer requires an argument\n");
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-empty") == 0) {
+      if (!efind_query_add_empty(opts)) {
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-contains") == 0 ||
+               strcmp(argv[i], "-icontains") == 0) {
+      if (i + 1 < argc) {
+        int ignore_case = (strcmp(argv[i], "-icontains") == 0) ? 1 : 0;
+        if (!efind_query_add_contains(opts, argv[++i], ignore_case)) {
+          return 0;
+        }
+      } else {
+        fprintf(stderr, "Error: %s requires an argument\n", argv[i]);
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-containsmax") == 0) {
+      if (i + 1 < argc) {
+        opts->content_max_size = strtoul(argv[++i], NULL, 10) * 1024;
+      } else {
+        fprintf(stderr, "Error: -containsmax requires an argument\n");
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-regexcache") == 0) {
+      if (i + 1 < argc) {
+        opts->regex_cache_size = atol(argv[++i]) * 1024;
+      } else {
+        fprintf(stderr, "Error: -regexcache requires an argument\n");
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-print") == 0) {
+      if (efind_query_add_action(opts, ACTION_PRINT) == NULL) {
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-fprint") == 0) {
+      if (i + 1 < argc) {
+        Action *action = efind_query_add_action(opts, ACTION_PRINT);
+        if (action == NULL ||
+            !efind_query_set_output(opts, action, argv[++i])) {
+          return 0;
+        }
+      } else {
+        fprintf(stderr, "Error: -fprint requires an argument\n");
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-printf") == 0) {
+      if (i + 1 < argc) {
+        if (!add_printf_action(opts, NULL, argv[++i])) {
+          return 0;
+        }
+      } else {
+        fprintf(stderr, "Error: -printf requires an argument\n");
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-fprintf") == 0) {
+      if (i + 2 < argc) {
+        if (!add_printf_action(opts, argv[i + 1], argv[i + 2])) {
+          return 0;
+        }
+        i += 2;
+      } else {
+        fprintf(stderr, "Error: -fprintf requires two arguments\n");
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-exec") == 0 ||
+               strcmp(argv[i], "-execdir") == 0) {
+      if (!parse_exec_action(argc, argv, &i, opts)) {
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-count") == 0) {
+      summary->count = 1;
+    } else if (strcmp(argv[i], "-counttype") == 0) {
+      summary->by_type = 1;
+    } else if (strcmp(argv[i], "-countdepth") == 0) {
+      summary->by_depth = 1;
+    } else if (strcmp(argv[i], "-du") == 0) {
+      summary->sizes = 1;
+    } else if (strcmp(argv[i], "-watch") == 0) {
+      if (i + 1 < argc) {
+        watch->interval = atoi(argv[++i]);
+        if (watch->interval <= 0) {
+          fprintf(stderr, "Error: invalid interval '%s'\n", argv[i]);
+          return 0;
+        }
       } else {
-        fprintf(stderr, "Error: -o cannot be the first condition\n");
+        fprintf(stderr, "Error: -watch requires an argument\n");
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-watchremoved") == 0) {
+      watch->show_removed = 1;
+    } else if (strcmp(argv[i], "-batch") == 0) {
+      if (i + 1 < argc) {
+        *batch_file = argv[++i];
+      } else {
+        fprintf(stderr, "Error: -batch requires an argument\n");
+        return 0;
+      }
+    } else if (strcmp(argv[i], "-o") == 0) {
+      if (!efind_query_or(opts)) {
         return 0;
       }
     } else if (argv[i][0] != '-') {
@@ -218,14 +618,409 @@ static int parse_args(int argc, char *argv[], Options *opts, PathList *paths) {
     }
   }
 
+  // -batch では検索条件を各行から読み込むため、ほかの引数は使わない
+  if (*batch_file != NULL && argc != 3) {
+    fprintf(stderr,
+            "Error: -batch cannot be combined with other options, paths or "
+            "predicates\n");
+    return 0;
+  }
+
+  if (SUMMARY_ENABLED(summary) && opts->action_count > 0) {
+    fprintf(stderr,
+            "Error: -count, -counttype, -countdepth and -du cannot be "
+            "combined with actions\n");
+    return 0;
+  }
+
+  if (SUMMARY_ENABLED(summary) && watch->interval > 0) {
+    fprintf(stderr,
+            "Error: -count, -counttype, -countdepth and -du cannot be "
+            "combined with -watch\n");
+    return 0;
+  }
+
+  // 正規表現をコンパイル (-regexcache を反映するため、すべての引数の解析後に行う)
+  if (!efind_query_compile(opts)) {
+    return 0;
+  }
+
   // 検索パスが見つからなかった場合はカレントディレクトリを設定
   if (!found_search_path) {
     add_path(paths, ".");
   }
+  if (remove_nested) {
+    remove_nested_paths(paths, opts->maxdepth);
+  }
 
   return 1;
 }
 
+/**
+ * @brief 条件に一致したエントリに対してアクションを実行する関数
+ *
+ * アクションが指定されていない場合はパスを出力する。ファイルのメタデータは
+ * 書式が参照する場合にだけ、エントリごとに 1 回取得する
+ *
+ * @param[in] entry 条件に一致したエントリ
+ * @param[in] user_data 検索オプション構造体へのポインタ
+ * @return 常に 0 (検索を続ける)
+ */
+static int perform_actions(const EfindEntry *entry, void *user_data) {
+  const Options *opts = (const Options *)user_data;
+  FileInfo info;
+  int has_info = 0;
+
+  if (opts->action_count == 0) {
+    printf("%s\n", entry->path);
+    return 0;
+  }
+  for (int i = 0; i < opts->action_count; i++) {
+    const Action *action = &opts->actions[i];
+    switch (action->type) {
+      case ACTION_PRINT:
+        fprintf(action->stream, "%s\n", entry->path);
+        break;
+      case ACTION_PRINTF:
+        if (!has_info && print_format_needs_info(action->format)) {
+          // 条件の評価で取得したメタデータがあればそれを使う
+          if (entry->info != NULL) {
+            info = *entry->info;
+          } else if (!get_file_info(entry->path, &info)) {
+            fprintf(stderr, "Cannot get information of '%s'\n", entry->path);
+            memset(&info, 0, sizeof(info));
+          }
+          has_info = 1;
+        }
+        print_format_write(action->format, entry, &info, action->stream);
+        break;
+      case ACTION_EXEC:
+        exec_command_run(action->command, entry->dir, entry->name);
+        break;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief アクションの実行を完了する関数
+ *
+ * -exec / -execdir の "{} +" 形式で実行を待っているパスをすべて実行する
+ *
+ * @param[in] opts 検索オプション構造体へのポインタ
+ * @return int 実行したコマンドがすべて成功した場合は 0、失敗があった場合は 1
+ */
+static int finish_actions(const Options *opts) {
+  int status = 0;
+  for (int i = 0; i < opts->action_count; i++) {
+    ExecCommand *command = opts->actions[i].command;
+    if (command != NULL) {
+      exec_command_flush(command);
+      if (command->failed) {
+        status = 1;
+      }
+    }
+  }
+  return status;
+}
+
+/**
+ * @brief 一致しなくなったパスを出力する関数 (-watchremoved)
+ *
+ * @param[in] path 一致しなくなったパス
+ * @param[in] user_data 使用しない
+ */
+static void print_removed(const char *path, void *user_data) {
+  printf("- %s\n", path);
+}
+
+/**
+ * @brief 検索を繰り返し、新たに一致したエントリにだけアクションを実行する関数
+ *
+ * 最初の検索ではすべての一致したエントリにアクションを実行する。
+ * 中断されるか、検索でエラーが発生するまで終了しない
+ *
+ * @param[in] paths 検索パスのリスト
+ * @param[in,out] opts 検索オプション構造体へのポインタ
+ * @param[in] watch 監視モードの指定
+ * @return int エラー時は 1
+ */
+static int run_watch(const PathList *paths, Options *opts,
+                     const WatchMode *watch) {
+  EfindWatch *state = efind_watch_create(opts);
+  if (state == NULL) {
+    return 1;
+  }
+
+  for (;;) {
+    int status = efind_watch_scan(state, paths->paths, paths->count,
+                                  perform_actions,
+                                  watch->show_removed ? print_removed : NULL,
+                                  (void *)opts);
+    // "{} +" 形式のコマンドは検索ごとに実行する
+    finish_actions(opts);
+    fflush(stdout);
+    if (status != 0) {
+      fprintf(stderr, "Error: -watch stopped because the search failed\n");
+      efind_watch_free(state);
+      return 1;
+    }
+    wait_seconds(watch->interval);
+  }
+}
+
+/**
+ * @brief ディレクトリごとのサイズの合計を出力する関数 (-du)
+ *
+ * @param[in] path ディレクトリのパス
+ * @param[in] kbytes サイズの合計 (KB)
+ * @param[in] user_data 使用しない
+ */
+static void print_directory_size(const char *path, unsigned long kbytes,
+                                 void *user_data) {
+  printf("%lu\t%s\n", kbytes, path);
+}
+
+/**
+ * @brief 集計結果を出力する関数
+ *
+ * @param[in] mode 集計モードの指定
+ * @param[in] summary 集計結果
+ */
+static void print_summary(const SummaryMode *mode,
+                          const EfindSummary *summary) {
+  if (mode->count) {
+    printf("%lu\n", summary->count);
+  }
+  if (mode->by_type) {
+    printf("f %lu\n", summary->count - summary->dir_count);
+    printf("d %lu\n", summary->dir_count);
+  }
+  if (mode->by_depth) {
+    for (int depth = 0; depth < summary->depth_capacity; depth++) {
+      if (summary->depth_counts[depth] > 0) {
+        printf("%d %lu\n", depth, summary->depth_counts[depth]);
+      }
+    }
+  }
+}
+
+/**
+ * @brief 検索条件に従って検索し、アクションの実行または集計を行う関数
+ *
+ * 開始パスが重なっている場合は、重なる部分で読み込んだディレクトリの内容を
+ * 索引に残し、同じディレクトリを開始パスごとに読み直さないようにする
+ *
+ * @param[in] paths 検索パスのリスト
+ * @param[in,out] opts 検索オプション構造体へのポインタ
+ * @param[in] summary_mode 集計モードの指定
+ * @return int 成功時は 0、エラー時は 1
+ */
+static int run_query(const PathList *paths, Options *opts,
+                     const SummaryMode *summary_mode) {
+  EfindSummary summary;
+  EfindIndex *index = NULL;
+  EfindPrintFunction print = NULL;
+  int status = 0;
+
+  if (opts->index == NULL && has_overlapping_paths(paths)) {
+    index = efind_index_create();
+    if (index == NULL) {
+      return 1;
+    }
+    opts->index = index;
+
+    // 索引に残すのは、ほかの開始パスと重なる開始パスの下だけにする
+    for (int j = 0; j < paths->count; j++) {
+      for (int i = 0; i < paths->count; i++) {
+        if (i != j && is_nested_path(paths->paths[i], paths->paths[j])) {
+          if (!efind_index_add_scope(index, paths->paths[j])) {
+            opts->index = NULL;
+            efind_index_free(index);
+            return 1;
+          }
+          break;
+        }
+      }
+    }
+  }
+
+  // 条件とアクションが単純な場合は専用の関数で直接出力する
+  if (!SUMMARY_ENABLED(summary_mode)) {
+    print = efind_select_print(opts);
+  }
+
+  // 複数の検索パスを処理 (集計モードではパスを出力せずに集計だけ行う)
+  memset(&summary, 0, sizeof(summary));
+  for (int i = 0; i < paths->count; i++) {
+    int result;
+    if (SUMMARY_ENABLED(summary_mode)) {
+      result = efind_summarize(
+          paths->paths[i], opts, &summary,
+          summary_mode->sizes ? print_directory_size : NULL, NULL);
+    } else if (print != NULL) {
+      result = print(paths->paths[i], opts, stdout);
+    } else {
+      result = efind_walk(paths->paths[i], opts, perform_actions,
+                          (void *)opts);
+    }
+    if (result != 0) {
+      status = result;
+    }
+  }
+  if (SUMMARY_ENABLED(summary_mode)) {
+    print_summary(summary_mode, &summary);
+    efind_summary_free(&summary);
+  }
+  if (index != NULL) {
+    opts->index = NULL;
+    efind_index_free(index);
+  }
+
+  // "{} +" 形式で実行を待っているコマンドを実行
+  if (finish_actions(opts) != 0) {
+    status = 1;
+  }
+  return status;
+}
+
+/**
+ * @brief 1 行の検索条件を空白で区切って引数の配列にする関数
+ *
+ * '...' または "..." で囲んだ部分は空白を含めて 1 つの引数にする。
+ * line の内容は書き換えられ、引数は line 内を指す
+ *
+ * @param[in,out] line 検索条件の行
+ * @param[out] args 引数の配列 (先頭はプログラム名)
+ * @param[in] max_args args の要素数
+ * @return 引数の数 (プログラム名を含む)、エラー時は -1
+ */
+static int split_query_line(char *line, char *args[], const int max_args) {
+  int count = 0;
+  char *p = line;
+
+  args[count++] = PROGRAM;
+  for (;;) {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+      p++;
+    }
+    if (*p == '\0') {
+      return count;
+    }
+    if (count >= max_args) {
+      fprintf(stderr, "Error: too many arguments in query\n");
+      return -1;
+    }
+
+    // 引用符を取り除きながら、引数を line 内に詰めて書き込む
+    char *out = p;
+    args[count++] = out;
+    while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r' &&
+           *p != '\n') {
+      if (*p == '\'' || *p == '"') {
+        char quote = *p++;
+        while (*p != '\0' && *p != quote) {
+          *out++ = *p++;
+        }
+        if (*p != quote) {
+          fprintf(stderr, "Error: unterminated quote in query\n");
+          return -1;
+        }
+        p++;
+      } else {
+        *out++ = *p++;
+      }
+    }
+    char *next = (*p != '\0') ? p + 1 : p;
+    *out = '\0';
+    p = next;
+  }
+}
+
+/**
+ * @brief ファイルから検索条件を 1 行ずつ読み込んで順に検索する関数 (-batch)
+ *
+ * 行ごとにコマンドラインと同じ形式の検索条件を解析して検索し、結果の後に
+ * 空行を出力する。読み込んだディレクトリの内容は索引に残し、以降の検索で
+ * 再利用する
+ *
+ * @param[in] batch_file 検索条件のファイル名 ("-" の場合は標準入力)
+ * @return int すべての検索が成功した場合は 0、エラーがあった場合は 1
+ */
+static int run_batch(const char *batch_file) {
+  char line[BATCH_LINE_SIZE];
+  char *args[BATCH_MAX_ARGS];
+  int status = 0;
+
+  FILE *in = (strcmp(batch_file, "-") == 0) ? stdin : fopen(batch_file, "r");
+  if (in == NULL) {
+    fprintf(stderr, "Error: cannot open '%s'\n", batch_file);
+    return 1;
+  }
+  EfindIndex *index = efind_index_create();
+  if (index == NULL) {
+    if (in != stdin) {
+      fclose(in);
+    }
+    return 1;
+  }
+
+  while (fgets(line, sizeof(line), in) != NULL) {
+    Options opts;
+    PathList paths;
+    SummaryMode summary_mode;
+    WatchMode watch_mode;
+    const char *nested_batch;
+
+    if (strchr(line, '\n') == NULL && !feof(in)) {
+      // 長すぎる行は残りを読み飛ばす
+      fprintf(stderr, "Error: query line too long\n");
+      int c;
+      while ((c = fgetc(in)) != EOF && c != '\n') {
+      }
+      status = 1;
+      continue;
+    }
+    int arg_count = split_query_line(line, args, BATCH_MAX_ARGS);
+    if (arg_count < 0) {
+      status = 1;
+      continue;
+    }
+    if (arg_count < 2) {
+      continue;  // 空行
+    }
+
+    if (!initialize_path_list(&paths)) {
+      status = 1;
+      break;
+    }
+    if (!parse_args(arg_count, args, &opts, &paths, &summary_mode,
+                    &watch_mode, &nested_batch)) {
+      status = 1;
+    } else if (nested_batch != NULL || watch_mode.interval > 0) {
+      fprintf(stderr, "Error: -batch and -watch cannot be used in a query\n");
+      status = 1;
+    } else {
+      opts.index = index;
+      if (run_query(&paths, &opts, &summary_mode) != 0) {
+        status = 1;
+      }
+    }
+    free_path_list(&paths);
+    efind_query_free(&opts);
+
+    // 検索ごとの結果の区切り
+    printf("\n");
+    fflush(stdout);
+  }
+
+  efind_index_free(index);
+  if (in != stdin) {
+    fclose(in);
+  }
+  return status;
+}
+
 /**
  * @brief プログラムのエントリーポイント
  *
@@ -236,6 +1031,9 @@ static int parse_args(int argc, char *argv[], Options *opts, PathList *paths) {
 int main(int argc, char *argv[]) {
   Options opts;
   PathList paths;
+  SummaryMode summary_mode;
+  WatchMode watch_mode;
+  const char *batch_file;
   int status = 0;
 
   // パスリストを初期化
@@ -243,21 +1041,24 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  if (!parse_args(argc, argv, &opts, &paths)) {
+  if (!parse_args(argc, argv, &opts, &paths, &summary_mode, &watch_mode,
+                  &batch_file)) {
+    efind_query_free(&opts);
     free_path_list(&paths);
     return 1;
   }
 
-  // 複数の検索パスを処理
-  for (int i = 0; i < paths.count; i++) {
-    int result = search_directory(paths.paths[i], 0, &opts);
-    if (result != 0) {
-      status = result;
-    }
+  if (batch_file != NULL) {
+    status = run_batch(batch_file);
+  } else if (watch_mode.interval > 0) {
+    status = run_watch(&paths, &opts, &watch_mode);
+  } else {
+    status = run_query(&paths, &opts, &summary_mode);
   }
 
-  // パスリストを解放
+  // パスリストとオプションを解放
   free_path_list(&paths);
+  efind_query_free(&opts);
 
   return status;
 }
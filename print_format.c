@@ -0,0 +1,501 @@
+#include "print_format.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/**
+ * @brief 日時の秒の小数部分
+ *
+ * GNU find と同じ出力の形にそろえる (Human68k の日時は 2 秒単位なので常に 0)
+ */
+#define TIME_FRACTION ".0000000000"
+
+/**
+ * @brief %t などの日時の形式 (ctime と同じ形式)
+ */
+#define CTIME_FORMAT "%a %b %e %H:%M:%S" TIME_FRACTION " %Y"
+
+/**
+ * @brief 書式の命令の種類を表す列挙型
+ *
+ * @enum FormatOpcode
+ */
+typedef enum {
+  FMT_LITERAL,      // 文字列をそのまま出力する
+  FMT_PATH,         // %p : パス
+  FMT_NAME,         // %f : ファイル名
+  FMT_DIR,          // %h : ファイル名より前の部分 (末尾の区切り文字を除く)
+  FMT_RELATIVE,     // %P : 開始パスより後の部分
+  FMT_ROOT,         // %H : 開始パス
+  FMT_DEPTH,        // %d : 深さ
+  FMT_SIZE,         // %s : サイズ (バイト)
+  FMT_KBLOCKS,      // %k : サイズ (1KB 単位、切り上げ)
+  FMT_BLOCKS,       // %b : サイズ (512 バイト単位、切り上げ)
+  FMT_TYPE,         // %y : 種類 (d, f, l)
+  FMT_MODE_OCTAL,   // %m : 許可 (8 進数)
+  FMT_MODE_STRING,  // %M : 種類と許可 (ls -l 形式)
+  FMT_TIME,         // %t, %Tk : 日時 (strftime の書式で出力する)
+  FMT_EPOCH,        // %T@ : 1970-01-01 からの秒数
+  FMT_STOP          // \c : 出力を終える
+} FormatOpcode;
+
+/**
+ * @brief 書式の命令を表す構造体
+ *
+ * @struct FormatOp
+ */
+typedef struct {
+  unsigned char opcode;  // 命令の種類 (FormatOpcode)
+  unsigned char left;    // 左詰めの場合は 1 ("-" フラグ)
+  short width;           // 最小フィールド幅 (0 の場合は指定なし)
+  short precision;       // 最大の出力文字数 (-1 の場合は指定なし)
+  int text;              // 文字列の text 内の位置 (FMT_LITERAL / FMT_TIME)
+  int len;               // 文字列の長さ (FMT_LITERAL)
+} FormatOp;
+
+/**
+ * @brief コンパイルした書式を表す構造体
+ *
+ * @struct PrintFormat
+ */
+struct PrintFormat {
+  FormatOp *ops;      // 命令列
+  int op_count;       // 命令の数
+  int op_capacity;    // ops の容量
+  char *text;         // リテラル文字列と strftime の書式を格納する領域
+  int text_len;       // text の使用済みバイト数
+  int text_capacity;  // text の容量
+  int needs_info;     // メタデータを参照する命令がある場合は 1
+};
+
+/**
+ * @brief 書式の文字列領域にバイト列を追加する
+ *
+ * @param[in,out] fmt 書式
+ * @param[in] data 追加するバイト列
+ * @param[in] len 追加するバイト数
+ * @return 追加した位置、メモリ不足の場合は -1
+ */
+static int append_text(PrintFormat *fmt, const char *data, const int len) {
+  if (fmt->text_len + len > fmt->text_capacity) {
+    int new_capacity = fmt->text_capacity ? fmt->text_capacity : 64;
+    while (fmt->text_len + len > new_capacity) {
+      new_capacity *= 2;
+    }
+    char *new_text = (char *)realloc(fmt->text, new_capacity);
+    if (new_text == NULL) {
+      return -1;
+    }
+    fmt->text = new_text;
+    fmt->text_capacity = new_capacity;
+  }
+  memcpy(fmt->text + fmt->text_len, data, len);
+  fmt->text_len += len;
+  return fmt->text_len - len;
+}
+
+/**
+ * @brief 書式に命令を追加する
+ *
+ * @param[in,out] fmt 書式
+ * @param[in] opcode 命令の種類
+ * @return 追加した命令、メモリ不足の場合は NULL
+ */
+static FormatOp *append_op(PrintFormat *fmt, const FormatOpcode opcode) {
+  if (fmt->op_count >= fmt->op_capacity) {
+    int new_capacity = fmt->op_capacity ? fmt->op_capacity * 2 : 8;
+    FormatOp *new_ops =
+        (FormatOp *)realloc(fmt->ops, sizeof(FormatOp) * new_capacity);
+    if (new_ops == NULL) {
+      return NULL;
+    }
+    fmt->ops = new_ops;
+    fmt->op_capacity = new_capacity;
+  }
+  FormatOp *op = &fmt->ops[fmt->op_count++];
+  memset(op, 0, sizeof(*op));
+  op->opcode = opcode;
+  op->precision = -1;
+  if (opcode >= FMT_SIZE && opcode <= FMT_EPOCH) {
+    fmt->needs_info = 1;
+  }
+  return op;
+}
+
+/**
+ * @brief 書式にリテラル文字列を追加する
+ *
+ * 直前の命令がリテラルであれば、その命令の文字列を延長する
+ *
+ * @param[in,out] fmt 書式
+ * @param[in] data 追加する文字列
+ * @param[in] len 追加するバイト数
+ * @return 成功時は 1、メモリ不足の場合は 0
+ */
+static int append_literal(PrintFormat *fmt, const char *data, const int len) {
+  FormatOp *last = fmt->op_count > 0 ? &fmt->ops[fmt->op_count - 1] : NULL;
+  int offset = append_text(fmt, data, len);
+  if (offset < 0) {
+    return 0;
+  }
+  if (last != NULL && last->opcode == FMT_LITERAL &&
+      last->text + last->len == offset) {
+    last->len += len;
+    return 1;
+  }
+  FormatOp *op = append_op(fmt, FMT_LITERAL);
+  if (op == NULL) {
+    return 0;
+  }
+  op->text = offset;
+  op->len = len;
+  return 1;
+}
+
+/**
+ * @brief 日時の命令を追加する
+ *
+ * @param[in,out] fmt 書式
+ * @param[in] key 日時の指示子の後の文字 (%Tk の k 、 %t の場合は 0)
+ * @param[in,out] op 追加した命令 (幅と精度を設定済み)
+ * @return 成功時は 1、未知の文字の場合は 0、メモリ不足の場合は -1
+ */
+static int compile_time(PrintFormat *fmt, const char key, FormatOp *op) {
+  const char *strftime_format;
+  char buf[4];
+
+  switch (key) {
+    case 0:
+      strftime_format = CTIME_FORMAT;
+      break;
+    case '@':
+      op->opcode = FMT_EPOCH;
+      return 1;
+    case '+':
+      strftime_format = "%Y-%m-%d+%H:%M:%S" TIME_FRACTION;
+      break;
+    case 'S':
+      strftime_format = "%S" TIME_FRACTION;
+      break;
+    case 'T':
+      strftime_format = "%H:%M:%S" TIME_FRACTION;
+      break;
+    default:
+      if (strchr("aAbBcdDFhHIjklmMprUwWxXyYZ", key) == NULL) {
+        return 0;
+      }
+      buf[0] = '%';
+      buf[1] = key;
+      buf[2] = '\0';
+      strftime_format = buf;
+      break;
+  }
+  op->opcode = FMT_TIME;
+  op->text = append_text(fmt, strftime_format, strlen(strftime_format) + 1);
+  return op->text >= 0 ? 1 : -1;
+}
+
+/**
+ * @brief エスケープシーケンスを解析して書式に追加する
+ *
+ * @param[in,out] fmt 書式
+ * @param[in,out] p "\" の次の文字 (解析後はシーケンスの次の文字)
+ * @return 成功時は 1、メモリ不足の場合は 0
+ */
+static int compile_escape(PrintFormat *fmt, const char **p) {
+  static const char escapes[] = "a\ab\bf\fn\nr\rt\tv\v\\\\";
+  const char *s = *p;
+  char c;
+
+  if (*s == 'c') {
+    *p = s + 1;
+    return append_op(fmt, FMT_STOP) != NULL;
+  }
+  if (*s >= '0' && *s <= '7') {
+    // \NNN : 8 進数で指定した文字
+    int value = 0;
+    for (int i = 0; i < 3 && *s >= '0' && *s <= '7'; i++, s++) {
+      value = value * 8 + (*s - '0');
+    }
+    c = (char)value;
+    *p = s;
+    return append_literal(fmt, &c, 1);
+  }
+  for (const char *e = escapes; *s != '\0' && *e != '\0'; e += 2) {
+    if (*e == *s) {
+      *p = s + 1;
+      return append_literal(fmt, e + 1, 1);
+    }
+  }
+  // 未知のシーケンスは "\" ごとそのまま出力する
+  return append_literal(fmt, s - 1, 1);
+}
+
+PrintFormat *print_format_compile(const char *format, const char **error) {
+  PrintFormat *fmt = (PrintFormat *)calloc(1, sizeof(PrintFormat));
+  const char *p = format;
+  const char *message = NULL;
+
+  if (fmt == NULL) {
+    message = "Memory allocation error";
+  }
+
+  while (message == NULL && *p != '\0') {
+    // 次の "\" または "%" までをまとめてリテラルにする
+    int len = strcspn(p, "\\%");
+    if (len > 0) {
+      if (!append_literal(fmt, p, len)) {
+        message = "Memory allocation error";
+      }
+      p += len;
+      continue;
+    }
+
+    if (*p++ == '\\') {
+      if (!compile_escape(fmt, &p)) {
+        message = "Memory allocation error";
+      }
+      continue;
+    }
+
+    if (*p == '%') {
+      if (!append_literal(fmt, p++, 1)) {
+        message = "Memory allocation error";
+      }
+      continue;
+    }
+
+    // %[-][幅][.精度]指示子
+    int left = 0;
+    int width = 0;
+    int precision = -1;
+    if (*p == '-') {
+      left = 1;
+      p++;
+    }
+    while (*p >= '0' && *p <= '9') {
+      width = width * 10 + (*p++ - '0');
+    }
+    if (*p == '.') {
+      precision = 0;
+      for (p++; *p >= '0' && *p <= '9'; p++) {
+        precision = precision * 10 + (*p - '0');
+      }
+    }
+
+    FormatOpcode opcode;
+    switch (*p) {
+      case 'p':
+        opcode = FMT_PATH;
+        break;
+      case 'f':
+        opcode = FMT_NAME;
+        break;
+      case 'h':
+        opcode = FMT_DIR;
+        break;
+      case 'P':
+        opcode = FMT_RELATIVE;
+        break;
+      case 'H':
+        opcode = FMT_ROOT;
+        break;
+      case 'd':
+        opcode = FMT_DEPTH;
+        break;
+      case 's':
+        opcode = FMT_SIZE;
+        break;
+      case 'k':
+        opcode = FMT_KBLOCKS;
+        break;
+      case 'b':
+        opcode = FMT_BLOCKS;
+        break;
+      case 'y':
+        opcode = FMT_TYPE;
+        break;
+      case 'm':
+        opcode = FMT_MODE_OCTAL;
+        break;
+      case 'M':
+        opcode = FMT_MODE_STRING;
+        break;
+      case 'a':
+      case 'c':
+      case 't':
+      case 'A':
+      case 'C':
+      case 'T':
+        // Human68k は最終更新日時しか持たないので、アクセス日時と
+        // 状態変更日時も最終更新日時で代用する
+        opcode = FMT_TIME;
+        break;
+      default:
+        message = (*p == '\0') ? "Incomplete directive at end of format"
+                               : "Unknown directive in format";
+        continue;
+    }
+
+    FormatOp *op = append_op(fmt, opcode);
+    if (op == NULL) {
+      message = "Memory allocation error";
+      continue;
+    }
+    op->left = left;
+    op->width = width;
+    op->precision = precision;
+
+    if (opcode == FMT_TIME) {
+      // %A, %C, %T は次の文字で形式を選ぶ
+      int key = 0;
+      if (*p == 'A' || *p == 'C' || *p == 'T') {
+        key = *++p;
+        if (key == '\0') {
+          message = "Incomplete directive at end of format";
+          continue;
+        }
+      }
+      int result = compile_time(fmt, key, op);
+      if (result <= 0) {
+        message = (result < 0) ? "Memory allocation error"
+                               : "Unknown time directive in format";
+        continue;
+      }
+    }
+    p++;
+  }
+
+  if (message != NULL) {
+    if (error != NULL) {
+      *error = message;
+    }
+    print_format_free(fmt);
+    return NULL;
+  }
+  return fmt;
+}
+
+int print_format_needs_info(const PrintFormat *format) {
+  return format->needs_info;
+}
+
+/**
+ * @brief 命令の幅と精度に従って文字列を出力する
+ *
+ * @param[in] op 命令
+ * @param[in] str 出力する文字列
+ * @param[in] len 出力する文字列の長さ
+ * @param[in] out 出力先
+ */
+static void write_field(const FormatOp *op, const char *str, int len,
+                        FILE *out) {
+  if (op->precision >= 0 && op->precision < len) {
+    len = op->precision;
+  }
+  if (op->width == 0) {
+    fwrite(str, 1, len, out);
+  } else {
+    fprintf(out, op->left ? "%-*.*s" : "%*.*s", op->width, len, str);
+  }
+}
+
+/**
+ * @brief ls -l 形式の種類と許可の文字列を作成する
+ *
+ * @param[in] mode 種類と許可
+ * @param[out] buf 文字列を格納するバッファ (11 バイト以上)
+ */
+static void format_mode_string(const int mode, char *buf) {
+  static const char perms[] = "rwxrwxrwx";
+  buf[0] = S_ISDIR(mode) ? 'd' : S_ISLNK(mode) ? 'l' : '-';
+  for (int i = 0; i < 9; i++) {
+    buf[i + 1] = (mode & (0400 >> i)) ? perms[i] : '-';
+  }
+  buf[10] = '\0';
+}
+
+void print_format_write(const PrintFormat *format, const EfindEntry *entry,
+                        const FileInfo *info, FILE *out) {
+  char buf[80];
+
+  for (int i = 0; i < format->op_count; i++) {
+    const FormatOp *op = &format->ops[i];
+    const char *str = buf;
+    int len = -1;
+
+    switch ((FormatOpcode)op->opcode) {
+      case FMT_LITERAL:
+        fwrite(format->text + op->text, 1, op->len, out);
+        continue;
+      case FMT_STOP:
+        fflush(out);
+        return;
+      case FMT_PATH:
+        str = entry->path;
+        break;
+      case FMT_NAME:
+        str = entry->name;
+        break;
+      case FMT_DIR:
+        // 末尾の区切り文字を除く (ルートディレクトリの場合を除く)
+        len = strlen(entry->dir);
+        if (len == 0) {
+          str = ".";
+          len = 1;
+        } else {
+          str = entry->dir;
+          if (len > 1 && is_path_end_with_separator(str)) {
+            len--;
+          }
+        }
+        break;
+      case FMT_RELATIVE:
+        str = entry->relative;
+        break;
+      case FMT_ROOT:
+        str = entry->root;
+        break;
+      case FMT_DEPTH:
+        sprintf(buf, "%d", entry->depth);
+        break;
+      case FMT_SIZE:
+        sprintf(buf, "%lu", info->size);
+        break;
+      case FMT_KBLOCKS:
+        sprintf(buf, "%lu", (info->size + 1023) / 1024);
+        break;
+      case FMT_BLOCKS:
+        sprintf(buf, "%lu", (info->size + 511) / 512);
+        break;
+      case FMT_TYPE:
+        buf[0] = S_ISDIR(info->mode) ? 'd' : S_ISLNK(info->mode) ? 'l' : 'f';
+        buf[1] = '\0';
+        break;
+      case FMT_MODE_OCTAL:
+        sprintf(buf, "%o", info->mode & 07777);
+        break;
+      case FMT_MODE_STRING:
+        format_mode_string(info->mode, buf);
+        break;
+      case FMT_TIME:
+        len = strftime(buf, sizeof(buf), format->text + op->text,
+                       localtime(&info->mtime));
+        break;
+      case FMT_EPOCH:
+        sprintf(buf, "%ld" TIME_FRACTION, (long)info->mtime);
+        break;
+    }
+    write_field(op, str, len >= 0 ? len : (int)strlen(str), out);
+  }
+}
+
+void print_format_free(PrintFormat *format) {
+  if (format == NULL) {
+    return;
+  }
+  free(format->ops);
+  free(format->text);
+  free(format);
+}
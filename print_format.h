@@ -0,0 +1,50 @@
+#ifndef PRINT_FORMAT_H
+#define PRINT_FORMAT_H
+
+#include <stdio.h>
+
+#include "arch.h"
+#include "efind.h"
+
+/**
+ * @brief -printf の書式をコンパイルする
+ *
+ * 書式文字列を引数解析時に 1 回だけ解析し、エントリごとに実行する命令列に
+ * 変換する。エスケープシーケンスは解析時に展開しておく
+ *
+ * @param[in] format 書式文字列
+ * @param[out] error エラー時にエラーメッセージを格納する (NULL 可)
+ * @return コンパイルした書式、エラー時は NULL
+ */
+PrintFormat *print_format_compile(const char *format, const char **error);
+
+/**
+ * @brief 書式がファイルのメタデータを参照するかどうかを判定する
+ *
+ * サイズ、日時、許可、種類の指示子を含む場合にメタデータが必要になる
+ *
+ * @param[in] format コンパイルした書式
+ * @return メタデータが必要な場合は 1、不要な場合は 0
+ */
+int print_format_needs_info(const PrintFormat *format);
+
+/**
+ * @brief 書式に従ってエントリを出力する
+ *
+ * @param[in] format コンパイルした書式
+ * @param[in] entry 出力するエントリ
+ * @param[in] info エントリのメタデータ (print_format_needs_info が 0 の場合は
+ * NULL 可)
+ * @param[in] out 出力先
+ */
+void print_format_write(const PrintFormat *format, const EfindEntry *entry,
+                        const FileInfo *info, FILE *out);
+
+/**
+ * @brief コンパイルした書式を解放する
+ *
+ * @param[in] format 解放する書式 (NULL の場合は何もしない)
+ */
+void print_format_free(PrintFormat *format);
+
+#endif /* PRINT_FORMAT_H */
@@ -0,0 +1,310 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arch.h"
+#include "content_search.h"
+#include "efind.h"
+#include "print_format.h"
+
+void efind_query_init(Options *query) {
+  memset(query, 0, sizeof(*query));
+  query->maxdepth = -1;  // -1 は制限なしを意味する
+  query->regex_cache_size = REGEX_DEFAULT_CACHE_SIZE;
+}
+
+Condition *efind_query_add_condition(Options *query) {
+  if (query->condition_count >= MAX_CONDITIONS) {
+    fprintf(stderr, "Error: Too many conditions (maximum is %d)\n",
+            MAX_CONDITIONS);
+    return NULL;
+  }
+
+  Condition *cond = &query->conditions[query->condition_count++];
+  memset(cond, 0, sizeof(*cond));
+  cond->type = TYPE_NONE;
+  cond->op = OP_AND;
+  return cond;
+}
+
+int efind_query_add_type(Options *query, FileType type) {
+  Condition *cond = efind_query_add_condition(query);
+  if (cond == NULL) {
+    return 0;
+  }
+  cond->type = type;
+  return 1;
+}
+
+int efind_query_add_name(Options *query, const char *pattern,
+                         int ignore_case) {
+  Condition *cond = efind_query_add_condition(query);
+  if (cond == NULL) {
+    return 0;
+  }
+  cond->pattern = (char *)pattern;
+  cond->ignore_case = ignore_case;
+
+  // パターンの形状を解析して照合処理を選択しておく
+  analyze_name_pattern(cond);
+  return 1;
+}
+
+int efind_query_add_regex(Options *query, const char *pattern,
+                          int ignore_case) {
+  Condition *cond = efind_query_add_condition(query);
+  if (cond == NULL) {
+    return 0;
+  }
+  // コンパイルは efind_query_compile で行う (-regexcache を反映するため)
+  cond->regex_pattern = (char *)pattern;
+  cond->ignore_case = ignore_case;
+  return 1;
+}
+
+int efind_query_add_path(Options *query, const char *pattern,
+                         int ignore_case) {
+  Condition *cond = efind_query_add_condition(query);
+  if (cond == NULL) {
+    return 0;
+  }
+  // 正規表現と同じく efind_query_compile でコンパイルする
+  cond->path_pattern = (char *)pattern;
+  cond->ignore_case = ignore_case;
+  return 1;
+}
+
+/**
+ * @brief 比較する単位数を解析する
+ *
+ * @param[in] arg 単位数 (先頭に "+" / "-" を付けられる)
+ * @param[out] cond 比較方法と単位数を設定する条件
+ * @return 単位数の次の文字へのポインタ、数字がない場合は NULL
+ */
+static const char *parse_meta_value(const char *arg, Condition *cond) {
+  char *end;
+
+  cond->meta_compare = 0;
+  if (*arg == '+') {
+    cond->meta_compare = 1;
+    arg++;
+  } else if (*arg == '-') {
+    cond->meta_compare = -1;
+    arg++;
+  }
+  if (!isdigit((unsigned char)*arg)) {
+    return NULL;
+  }
+  cond->meta_value = strtoul(arg, &end, 10);
+  return end;
+}
+
+/**
+ * @brief -size の単位のバイト数を求める
+ *
+ * @param[in] suffix 単位数の後の文字列
+ * @return 単位のバイト数、単位が正しくない場合は 0
+ */
+static unsigned long size_unit(const char *suffix) {
+  if (suffix[0] == '\0') {
+    return 512;  // 省略時は 512 バイト単位
+  }
+  if (suffix[1] != '\0') {
+    return 0;
+  }
+  switch (suffix[0]) {
+    case 'c':
+      return 1;
+    case 'w':
+      return 2;
+    case 'b':
+      return 512;
+    case 'k':
+      return 1024;
+    case 'M':
+      return 1024UL * 1024;
+    case 'G':
+      return 1024UL * 1024 * 1024;
+    default:
+      return 0;
+  }
+}
+
+int efind_query_add_size(Options *query, const char *arg) {
+  Condition *cond = efind_query_add_condition(query);
+  if (cond == NULL) {
+    return 0;
+  }
+  cond->meta = META_SIZE;
+  const char *suffix = parse_meta_value(arg, cond);
+  cond->meta_unit = (suffix != NULL) ? size_unit(suffix) : 0;
+  if (cond->meta_unit == 0) {
+    fprintf(stderr, "Error: invalid size '%s'\n", arg);
+    return 0;
+  }
+  return 1;
+}
+
+int efind_query_add_mtime(Options *query, const char *arg,
+                          unsigned long unit) {
+  Condition *cond = efind_query_add_condition(query);
+  if (cond == NULL) {
+    return 0;
+  }
+  cond->meta = META_MTIME;
+  const char *end = parse_meta_value(arg, cond);
+  if (end == NULL || *end != '\0') {
+    fprintf(stderr, "Error: invalid time '%s'\n", arg);
+    return 0;
+  }
+  cond->meta_unit = unit;
+  cond->meta_time = time(NULL);
+  return 1;
+}
+
+void efind_query_update_time(Options *query) {
+  time_t now = time(NULL);
+  for (int i = 0; i < query->condition_count; i++) {
+    if (query->conditions[i].meta == META_MTIME) {
+      query->conditions[i].meta_time = now;
+    }
+  }
+}
+
+int efind_query_add_newer(Options *query, const char *path) {
+  FileInfo info;
+  if (!get_file_info(path, &info)) {
+    fprintf(stderr, "Error: cannot get information of '%s'\n", path);
+    return 0;
+  }
+  Condition *cond = efind_query_add_condition(query);
+  if (cond == NULL) {
+    return 0;
+  }
+  cond->meta = META_NEWER;
+  cond->meta_time = info.mtime;
+  return 1;
+}
+
+int efind_query_add_empty(Options *query) {
+  Condition *cond = efind_query_add_condition(query);
+  if (cond == NULL) {
+    return 0;
+  }
+  cond->meta = META_EMPTY;
+  return 1;
+}
+
+int efind_query_add_contains(Options *query, const char *text,
+                             int ignore_case) {
+  Condition *cond = efind_query_add_condition(query);
+  if (cond == NULL) {
+    return 0;
+  }
+  cond->content = content_pattern_compile(text, ignore_case);
+  return cond->content != NULL;
+}
+
+int efind_query_or(Options *query) {
+  if (query->condition_count == 0) {
+    fprintf(stderr, "Error: -o cannot be the first condition\n");
+    return 0;
+  }
+  query->conditions[query->condition_count - 1].op = OP_OR;
+  return 1;
+}
+
+Action *efind_query_add_action(Options *query, ActionType type) {
+  if (query->action_count >= MAX_ACTIONS) {
+    fprintf(stderr, "Error: Too many actions (maximum is %d)\n", MAX_ACTIONS);
+    return NULL;
+  }
+  Action *action = &query->actions[query->action_count++];
+  memset(action, 0, sizeof(*action));
+  action->type = type;
+  action->stream = stdout;
+  return action;
+}
+
+int efind_query_set_output(Options *query, Action *action, const char *path) {
+  // 同じファイルに出力するアクションがあれば、そのストリームを共有する
+  for (int i = 0; i < query->action_count; i++) {
+    const Action *other = &query->actions[i];
+    if (other != action && other->stream_name != NULL &&
+        strcmp(other->stream_name, path) == 0) {
+      action->stream = other->stream;
+      action->stream_name = other->stream_name;
+      action->owns_stream = 0;
+      return 1;
+    }
+  }
+
+  FILE *stream = fopen(path, "w");
+  if (stream == NULL) {
+    fprintf(stderr, "Error: cannot open '%s' for writing\n", path);
+    return 0;
+  }
+  action->stream = stream;
+  action->stream_name = path;
+  action->owns_stream = 1;
+  return 1;
+}
+
+int efind_query_compile(Options *query) {
+  int fs_ignore_case = -1;  // 必要になるまでチェックしない
+
+  for (int i = 0; i < query->condition_count; i++) {
+    Condition *cond = &query->conditions[i];
+    const char *error = NULL;
+
+    if (cond->regex != NULL) {
+      continue;  // コンパイル済み
+    }
+    if (cond->regex_pattern != NULL) {
+      cond->regex = regex_compile(cond->regex_pattern, cond->ignore_case,
+                                  query->regex_cache_size, &error);
+      if (cond->regex == NULL) {
+        fprintf(stderr, "Error: invalid regular expression '%s': %s\n",
+                cond->regex_pattern, error);
+        return 0;
+      }
+    } else if (cond->path_pattern != NULL) {
+      // -path / -ipath は -name と同様に、ファイルシステムが大文字小文字を
+      // 区別しない場合は常に大文字小文字を区別せずに照合する
+      if (fs_ignore_case < 0) {
+        fs_ignore_case = is_filesystem_ignore_case();
+      }
+      cond->regex = regex_compile_glob(cond->path_pattern,
+                                       cond->ignore_case || fs_ignore_case,
+                                       query->regex_cache_size, &error);
+      if (cond->regex == NULL) {
+        fprintf(stderr, "Error: invalid path pattern '%s': %s\n",
+                cond->path_pattern, error);
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+void efind_query_free(Options *query) {
+  for (int i = 0; i < query->condition_count; i++) {
+    regex_free(query->conditions[i].regex);
+    query->conditions[i].regex = NULL;
+    content_pattern_free(query->conditions[i].content);
+    query->conditions[i].content = NULL;
+  }
+  for (int i = 0; i < query->action_count; i++) {
+    Action *action = &query->actions[i];
+    exec_command_free(action->command);
+    action->command = NULL;
+    print_format_free(action->format);
+    action->format = NULL;
+    if (action->owns_stream) {
+      fclose(action->stream);
+      action->owns_stream = 0;
+    }
+  }
+}
@@ -0,0 +1,1216 @@
+#include "regex_dfa.h"
+
+#include <ctype.h>
+#include <mbctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DFA_UNKNOWN REGEX_STATE_UNKNOWN  // 遷移先がまだ構築されていない
+#define DFA_DEAD REGEX_STATE_DEAD        // 遷移先がない (以降どの文字列とも一致しない)
+#define DFA_BUCKETS 256                  // DFA 状態のハッシュ表のバケット数
+#define DFA_MIN_CACHE 256                // DFA キャッシュの最小サイズ (バイト)
+
+/**
+ * @brief 256 バイト分のビット集合
+ *
+ * @struct ByteSet
+ */
+typedef struct {
+  unsigned char bits[32];
+} ByteSet;
+
+/**
+ * @brief NFA の状態の種類を表す列挙型
+ *
+ * @enum NfaType
+ */
+typedef enum {
+  NFA_BYTESET,  // バイト集合に含まれるバイトで out へ遷移
+  NFA_SPLIT,    // 入力を消費せずに out と out1 へ遷移 (out1 が負なら out のみ)
+  NFA_MATCH     // 受理状態
+} NfaType;
+
+/**
+ * @brief NFA の状態
+ *
+ * out / out1 はコンパイル中は未接続の遷移先のリスト
+ * (状態番号 * 2 + フィールド番号) を保持することがある
+ *
+ * @struct NfaState
+ */
+typedef struct {
+  NfaType type;  // 状態の種類
+  int out;       // 遷移先
+  int out1;      // 2 つ目の遷移先 (NFA_SPLIT のみ)
+  int set;       // バイト集合のインデックス (NFA_BYTESET のみ)
+} NfaState;
+
+/**
+ * @brief DFA の状態 (NFA の状態集合)
+ *
+ * キャッシュ領域にヘッダ、遷移表、 NFA の状態集合の順に連続して格納する
+ *
+ * @struct DfaState
+ */
+typedef struct {
+  int hash_next;      // 同じバケットの次の DFA 状態 (なければ -1)
+  unsigned int hash;  // NFA の状態集合のハッシュ値
+  int accepting;      // 受理状態を含む場合は 1
+  int count;          // NFA の状態集合の要素数
+  int *next;          // バイトクラスごとの遷移先 (DFA_UNKNOWN / DFA_DEAD / 番号)
+  int *set;           // NFA の状態集合 (昇順)
+} DfaState;
+
+/**
+ * @brief NFA の断片 (コンパイル中に使用)
+ *
+ * @struct Fragment
+ */
+typedef struct {
+  int start;  // 断片の開始状態
+  int holes;  // 未接続の遷移先のリスト (なければ -1)
+} Fragment;
+
+struct Regex {
+  NfaState *states;    // NFA の状態
+  int state_count;     // NFA の状態数
+  int state_capacity;  // NFA の状態の配列の容量
+  ByteSet *sets;       // バイト集合
+  int set_count;       // バイト集合の数
+  int set_capacity;    // バイト集合の配列の容量
+  int start;           // NFA の開始状態
+  int match;           // NFA の受理状態
+
+  unsigned char byte_class[256];  // バイトから同じ振る舞いのバイトクラスへの対応
+  int class_count;                // バイトクラスの数
+
+  int *work_a;              // 照合用の作業領域 (NFA の状態集合)
+  int *work_b;              // 照合用の作業領域 (NFA の状態集合)
+  int *stack;               // ε 閉包の計算に使用するスタック
+  unsigned int *marks;      // ε 閉包の計算で訪問済みかを記録する世代番号
+  unsigned int generation;  // 現在の世代番号
+
+  char *cache;               // DFA キャッシュの領域
+  long cache_size;           // DFA キャッシュの領域のサイズ
+  long cache_used;           // DFA キャッシュの使用量
+  DfaState **dfa;            // DFA の状態
+  int dfa_count;             // DFA の状態数
+  int dfa_capacity;          // DFA の状態の配列の容量
+  int buckets[DFA_BUCKETS];  // DFA 状態のハッシュ表
+  int dfa_start;             // DFA の開始状態 (キャッシュに入らない場合は -1)
+};
+
+/**
+ * @brief 正規表現のパース中の状態
+ *
+ * @struct Parser
+ */
+typedef struct {
+  Regex *re;               // 構築中の正規表現
+  const unsigned char *p;  // パターンの現在位置
+  int ignore_case;         // 大文字小文字を区別しない場合は 1
+  int depth;               // 括弧の入れ子の深さ
+  const char *error;       // エラーメッセージ (エラーがなければ NULL)
+} Parser;
+
+static int parse_alternation(Parser *ps, Fragment *frag);
+
+/**
+ * @brief バイト集合にバイトを追加する
+ */
+static void byteset_add(ByteSet *set, const int c) {
+  set->bits[c >> 3] |= 1 << (c & 7);
+}
+
+/**
+ * @brief バイト集合にバイトが含まれるかを判定する
+ */
+static int byteset_has(const ByteSet *set, const int c) {
+  return (set->bits[c >> 3] >> (c & 7)) & 1;
+}
+
+/**
+ * @brief バイト集合が空かどうかを判定する
+ */
+static int byteset_empty(const ByteSet *set) {
+  for (int i = 0; i < 32; i++) {
+    if (set->bits[i]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief 2 バイト文字の 2 バイト目として扱うバイトの集合を作成する
+ *
+ * mbsinc と同じく、 1 バイト目の後の NUL 以外のバイトはすべて 2 バイト目とみなす
+ */
+static void byteset_trail_bytes(ByteSet *set) {
+  memset(set, 0, sizeof(*set));
+  for (int c = 1; c < 256; c++) {
+    byteset_add(set, c);
+  }
+}
+
+/**
+ * @brief NFA の状態を追加する
+ *
+ * @param[in,out] re 構築中の正規表現
+ * @param[in] type 状態の種類
+ * @param[in] set バイト集合 (NFA_BYTESET の場合のみ使用、それ以外は NULL)
+ * @return 追加した状態の番号、メモリ確保に失敗した場合は -1
+ */
+static int add_state(Regex *re, const NfaType type, const ByteSet *set) {
+  if (re->state_count >= re->state_capacity) {
+    int new_capacity = re->state_capacity ? re->state_capacity * 2 : 32;
+    NfaState *new_states =
+        (NfaState *)realloc(re->states, sizeof(NfaState) * new_capacity);
+    if (new_states == NULL) {
+      return -1;
+    }
+    re->states = new_states;
+    re->state_capacity = new_capacity;
+  }
+
+  NfaState *st = &re->states[re->state_count];
+  st->type = type;
+  st->out = -1;
+  st->out1 = -1;
+  st->set = -1;
+
+  if (type == NFA_BYTESET) {
+    if (re->set_count >= re->set_capacity) {
+      int new_capacity = re->set_capacity ? re->set_capacity * 2 : 16;
+      ByteSet *new_sets =
+          (ByteSet *)realloc(re->sets, sizeof(ByteSet) * new_capacity);
+      if (new_sets == NULL) {
+        return -1;
+      }
+      re->sets = new_sets;
+      re->set_capacity = new_capacity;
+    }
+    re->sets[re->set_count] = *set;
+    st->set = re->set_count++;
+  }
+
+  return re->state_count++;
+}
+
+/**
+ * @brief 未接続の遷移先のリストが指すフィールドを取得する
+ */
+static int *hole_field(Regex *re, const int hole) {
+  NfaState *st = &re->states[hole >> 1];
+  return (hole & 1) ? &st->out1 : &st->out;
+}
+
+/**
+ * @brief 未接続の遷移先をすべて target に接続する
+ */
+static void patch(Regex *re, int holes, const int target) {
+  while (holes >= 0) {
+    int *field = hole_field(re, holes);
+    holes = *field;
+    *field = target;
+  }
+}
+
+/**
+ * @brief 未接続の遷移先のリストを連結する
+ */
+static int append_holes(Regex *re, const int holes1, const int holes2) {
+  if (holes1 < 0) {
+    return holes2;
+  }
+  int h = holes1;
+  while (*hole_field(re, h) >= 0) {
+    h = *hole_field(re, h);
+  }
+  *hole_field(re, h) = holes2;
+  return holes1;
+}
+
+/**
+ * @brief 入力を消費しない断片を作成する
+ */
+static int make_empty(Parser *ps, Fragment *frag) {
+  int s = add_state(ps->re, NFA_SPLIT, NULL);
+  if (s < 0) {
+    ps->error = "Memory allocation error";
+    return 0;
+  }
+  frag->start = s;
+  frag->holes = s * 2;
+  return 1;
+}
+
+/**
+ * @brief 2 つの断片を選択 (a|b) で結合する
+ */
+static int make_alternative(Parser *ps, Fragment *frag, const Fragment *a,
+                            const Fragment *b) {
+  int s = add_state(ps->re, NFA_SPLIT, NULL);
+  if (s < 0) {
+    ps->error = "Memory allocation error";
+    return 0;
+  }
+  ps->re->states[s].out = a->start;
+  ps->re->states[s].out1 = b->start;
+  frag->start = s;
+  frag->holes = append_holes(ps->re, a->holes, b->holes);
+  return 1;
+}
+
+/**
+ * @brief 2 バイト文字の 1 バイト目の集合と 2 バイト目の集合からなる断片を作成する
+ */
+static int make_double_byte(Parser *ps, Fragment *frag, const ByteSet *leads,
+                            const ByteSet *trails) {
+  int lead = add_state(ps->re, NFA_BYTESET, leads);
+  int trail = add_state(ps->re, NFA_BYTESET, trails);
+  if (lead < 0 || trail < 0) {
+    ps->error = "Memory allocation error";
+    return 0;
+  }
+  ps->re->states[lead].out = trail;
+  frag->start = lead;
+  frag->holes = trail * 2;
+  return 1;
+}
+
+/**
+ * @brief 1 バイト文字の集合からなる断片を作成する
+ */
+static int make_single_byte(Parser *ps, Fragment *frag, const ByteSet *set) {
+  int s = add_state(ps->re, NFA_BYTESET, set);
+  if (s < 0) {
+    ps->error = "Memory allocation error";
+    return 0;
+  }
+  frag->start = s;
+  frag->holes = s * 2;
+  return 1;
+}
+
+/**
+ * @brief 1 バイト文字を集合に追加する (大文字小文字を区別しない場合は両方)
+ */
+static void add_single_char(const Parser *ps, ByteSet *set, const int c) {
+  byteset_add(set, c);
+  if (ps->ignore_case && c < 0x80 && isalpha(c)) {
+    byteset_add(set, tolower(c));
+    byteset_add(set, toupper(c));
+  }
+}
+
+/**
+ * @brief パターンから 1 文字を読み取る
+ *
+ * @param[in,out] ps パース中の状態
+ * @return 文字コード (2 バイト文字は 1 バイト目 << 8 | 2 バイト目)
+ */
+static unsigned int read_char(Parser *ps) {
+  unsigned int c = *ps->p++;
+  if (ismbblead(c) && *ps->p) {
+    c = (c << 8) | *ps->p++;
+  }
+  return c;
+}
+
+/**
+ * @brief ブラケット式の文字クラス名 ("[:alpha:]" など) を処理する
+ *
+ * @param[in,out] ps パース中の状態 ("[:" の直後を指す)
+ * @param[in,out] single 1 バイト文字の集合
+ * @return 成功時は 1、未知のクラス名の場合は 0
+ */
+static int parse_named_class(Parser *ps, ByteSet *single) {
+  static const struct {
+    const char *name;
+    int (*func)(int);
+  } classes[] = {
+      {"alpha", isalpha}, {"digit", isdigit}, {"alnum", isalnum},
+      {"upper", isupper}, {"lower", islower}, {"space", isspace},
+      {"punct", ispunct}, {"xdigit", isxdigit},
+  };
+
+  const char *end = strstr((const char *)ps->p, ":]");
+  if (end == NULL) {
+    return 0;
+  }
+  int len = end - (const char *)ps->p;
+  for (int i = 0; i < (int)(sizeof(classes) / sizeof(classes[0])); i++) {
+    if ((int)strlen(classes[i].name) == len &&
+        strncmp(classes[i].name, (const char *)ps->p, len) == 0) {
+      for (int c = 1; c < 0x80; c++) {
+        if (classes[i].func(c)) {
+          add_single_char(ps, single, c);
+        }
+      }
+      ps->p += len + 2;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief ブラケット式をパースして断片を作成する
+ *
+ * 1 バイト文字は 1 つのバイト集合に、 2 バイト文字は 1 バイト目ごとの
+ * 2 バイト目の集合にまとめる。 2 バイト目の集合が等しい 1 バイト目はまとめて
+ * 1 組の状態にする
+ *
+ * @param[in,out] ps パース中の状態 ('[' の直後を指す)
+ * @param[out] frag 作成した断片
+ * @return 成功時は 1、エラー時は 0
+ */
+static int parse_bracket(Parser *ps, Fragment *frag) {
+  ByteSet single;
+  ByteSet *trails;  // 1 バイト目 (0x80 - 0xff) ごとの 2 バイト目の集合
+  int negate = 0;
+  int first = 1;
+
+  memset(&single, 0, sizeof(single));
+  trails = (ByteSet *)calloc(0x80, sizeof(ByteSet));
+  if (trails == NULL) {
+    ps->error = "Memory allocation error";
+    return 0;
+  }
+
+  if (*ps->p == '^') {
+    negate = 1;
+    ps->p++;
+  }
+
+  // ']' が現れるまで要素を読み取る (先頭の ']' は文字として扱う)
+  while (*ps->p && (first || *ps->p != ']')) {
+    first = 0;
+    if (ps->p[0] == '[' && ps->p[1] == ':') {
+      ps->p += 2;
+      if (!parse_named_class(ps, &single)) {
+        ps->error = "Unknown character class in bracket expression";
+        free(trails);
+        return 0;
+      }
+      continue;
+    }
+
+    unsigned int lo = read_char(ps);
+    unsigned int hi = lo;
+    if (ps->p[0] == '-' && ps->p[1] && ps->p[1] != ']') {
+      ps->p++;
+      hi = read_char(ps);
+      if (hi < lo) {
+        ps->error = "Invalid range in bracket expression";
+        free(trails);
+        return 0;
+      }
+    }
+
+    // 1 バイト文字の範囲
+    for (unsigned int c = lo; c <= hi && c < 0x100; c++) {
+      if (!ismbblead(c)) {
+        add_single_char(ps, &single, c);
+      }
+    }
+    // 2 バイト文字の範囲
+    if (hi >= 0x100) {
+      unsigned int from = lo < 0x8100 ? 0x8100 : lo;
+      for (unsigned int lead = from >> 8; lead <= hi >> 8; lead++) {
+        if (!ismbblead(lead)) {
+          continue;
+        }
+        unsigned int t_lo = (lead == (from >> 8)) ? (from & 0xff) : 1;
+        if (t_lo == 0) {
+          t_lo = 1;  // NUL は 2 バイト目にならない
+        }
+        unsigned int t_hi = (lead == (hi >> 8)) ? (hi & 0xff) : 0xff;
+        for (unsigned int t = t_lo; t <= t_hi; t++) {
+          byteset_add(&trails[lead - 0x80], t);
+        }
+      }
+    }
+  }
+
+  if (*ps->p != ']') {
+    ps->error = "Unmatched [ in regular expression";
+    free(trails);
+    return 0;
+  }
+  ps->p++;
+
+  // 否定の場合は NUL と 2 バイト文字の 1 バイト目を除いた補集合を求める
+  if (negate) {
+    ByteSet all_trails;
+    byteset_trail_bytes(&all_trails);
+    for (int c = 1; c < 256; c++) {
+      if (ismbblead(c)) {
+        continue;
+      }
+      if (byteset_has(&single, c)) {
+        single.bits[c >> 3] &= ~(1 << (c & 7));
+      } else {
+        byteset_add(&single, c);
+      }
+    }
+    for (int lead = 0x80; lead < 0x100; lead++) {
+      if (!ismbblead(lead)) {
+        continue;
+      }
+      for (int i = 0; i < 32; i++) {
+        trails[lead - 0x80].bits[i] =
+            ~trails[lead - 0x80].bits[i] & all_trails.bits[i];
+      }
+    }
+  }
+
+  // 1 バイト文字と、 2 バイト目の集合が等しい 1 バイト目ごとの選択にする
+  int have_frag = 0;
+  int ok = 1;
+  if (!byteset_empty(&single)) {
+    ok = make_single_byte(ps, frag, &single);
+    have_frag = 1;
+  }
+  for (int lead = 0x80; lead < 0x100 && ok; lead++) {
+    ByteSet *set = &trails[lead - 0x80];
+    if (!ismbblead(lead) || byteset_empty(set)) {
+      continue;
+    }
+    ByteSet leads;
+    memset(&leads, 0, sizeof(leads));
+    for (int other = lead; other < 0x100; other++) {
+      if (ismbblead(other) &&
+          memcmp(&trails[other - 0x80], set, sizeof(ByteSet)) == 0) {
+        byteset_add(&leads, other);
+      }
+    }
+    Fragment part;
+    ByteSet trail_set = *set;
+    ok = make_double_byte(ps, &part, &leads, &trail_set);
+    if (ok) {
+      // 処理済みの 1 バイト目は空にしておく
+      for (int other = lead; other < 0x100; other++) {
+        if (byteset_has(&leads, other)) {
+          memset(&trails[other - 0x80], 0, sizeof(ByteSet));
+        }
+      }
+      if (have_frag) {
+        Fragment alt;
+        ok = make_alternative(ps, &alt, frag, &part);
+        *frag = alt;
+      } else {
+        *frag = part;
+        have_frag = 1;
+      }
+    }
+  }
+  free(trails);
+
+  if (!ok) {
+    return 0;
+  }
+  if (!have_frag) {
+    // どの文字とも一致しない (空のバイト集合)
+    ByteSet empty;
+    memset(&empty, 0, sizeof(empty));
+    return make_single_byte(ps, frag, &empty);
+  }
+  return 1;
+}
+
+/**
+ * @brief 任意の 1 文字 ('.') に一致する断片を作成する
+ */
+static int make_any_char(Parser *ps, Fragment *frag) {
+  ByteSet single, leads, trails;
+  memset(&single, 0, sizeof(single));
+  memset(&leads, 0, sizeof(leads));
+  for (int c = 1; c < 256; c++) {
+    byteset_add(ismbblead(c) ? &leads : &single, c);
+  }
+  byteset_trail_bytes(&trails);
+
+  Fragment a, b;
+  return make_single_byte(ps, &a, &single) &&
+         make_double_byte(ps, &b, &leads, &trails) &&
+         make_alternative(ps, frag, &a, &b);
+}
+
+/**
+ * @brief 1 文字 (2 バイト文字を含む) に一致する断片を作成する
+ *
+ * @param[in,out] ps パース中の状態
+ * @param[out] frag 作成した断片
+ * @param[in] c 文字コード (read_char の戻り値)
+ * @return 成功時は 1、エラー時は 0
+ */
+static int make_literal(Parser *ps, Fragment *frag, const unsigned int c) {
+  if (c >= 0x100) {
+    ByteSet leads, trails;
+    memset(&leads, 0, sizeof(leads));
+    memset(&trails, 0, sizeof(trails));
+    byteset_add(&leads, c >> 8);
+    byteset_add(&trails, c & 0xff);
+    return make_double_byte(ps, frag, &leads, &trails);
+  }
+  ByteSet set;
+  memset(&set, 0, sizeof(set));
+  add_single_char(ps, &set, c);
+  return make_single_byte(ps, frag, &set);
+}
+
+/**
+ * @brief アトム (文字、 '.' 、ブラケット式、括弧) をパースする
+ *
+ * @param[in,out] ps パース中の状態
+ * @param[out] frag 作成した断片
+ * @return 成功時は 1、エラー時は 0
+ */
+static int parse_atom(Parser *ps, Fragment *frag) {
+  unsigned int c = *ps->p;
+
+  switch (c) {
+    case '(':
+      ps->p++;
+      ps->depth++;
+      if (!parse_alternation(ps, frag)) {
+        return 0;
+      }
+      if (*ps->p != ')') {
+        ps->error = "Unmatched ( in regular expression";
+        return 0;
+      }
+      ps->p++;
+      ps->depth--;
+      return 1;
+    case '.':
+      ps->p++;
+      return make_any_char(ps, frag);
+    case '[':
+      ps->p++;
+      return parse_bracket(ps, frag);
+    case '*':
+    case '+':
+    case '?':
+      ps->error = "Nothing to repeat in regular expression";
+      return 0;
+    case '{':
+      ps->error = "Interval expressions are not supported";
+      return 0;
+    case '\\':
+      ps->p++;
+      if (*ps->p == '\0') {
+        ps->error = "Trailing backslash in regular expression";
+        return 0;
+      }
+      break;
+    default:
+      break;
+  }
+
+  // 通常の文字
+  return make_literal(ps, frag, read_char(ps));
+}
+
+/**
+ * @brief 断片に繰り返し演算子 ('*' 、 '+' 、 '?') を適用する
+ *
+ * @param[in,out] ps パース中の状態
+ * @param[in,out] frag 繰り返す断片 (適用後の断片で置き換える)
+ * @param[in] op 繰り返し演算子
+ * @return 成功時は 1、エラー時は 0
+ */
+static int apply_repeat(Parser *ps, Fragment *frag, const char op) {
+  int s = add_state(ps->re, NFA_SPLIT, NULL);
+  if (s < 0) {
+    ps->error = "Memory allocation error";
+    return 0;
+  }
+  NfaState *st = &ps->re->states[s];
+  st->out = frag->start;
+  st->out1 = -1;
+
+  if (op == '*') {
+    patch(ps->re, frag->holes, s);
+    frag->start = s;
+    frag->holes = s * 2 + 1;
+  } else if (op == '+') {
+    patch(ps->re, frag->holes, s);
+    frag->holes = s * 2 + 1;
+  } else {
+    frag->start = s;
+    frag->holes = append_holes(ps->re, frag->holes, s * 2 + 1);
+  }
+  return 1;
+}
+
+/**
+ * @brief アトムと後置の繰り返し演算子 ('*' 、 '+' 、 '?') をパースする
+ *
+ * @param[in,out] ps パース中の状態
+ * @param[out] frag 作成した断片
+ * @return 成功時は 1、エラー時は 0
+ */
+static int parse_repeat(Parser *ps, Fragment *frag) {
+  if (!parse_atom(ps, frag)) {
+    return 0;
+  }
+
+  while (*ps->p == '*' || *ps->p == '+' || *ps->p == '?') {
+    if (!apply_repeat(ps, frag, *ps->p++)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief 連接をパースする
+ *
+ * @param[in,out] ps パース中の状態
+ * @param[out] frag 作成した断片
+ * @return 成功時は 1、エラー時は 0
+ */
+static int parse_concatenation(Parser *ps, Fragment *frag) {
+  int have_frag = 0;
+
+  while (*ps->p && *ps->p != '|' && !(*ps->p == ')' && ps->depth > 0)) {
+    // 末尾の '$' は文字列全体との照合なので無視する
+    if (ps->p[0] == '$' && ps->p[1] == '\0') {
+      ps->p++;
+      break;
+    }
+
+    Fragment next;
+    if (!parse_repeat(ps, &next)) {
+      return 0;
+    }
+    if (have_frag) {
+      patch(ps->re, frag->holes, next.start);
+      frag->holes = next.holes;
+    } else {
+      *frag = next;
+      have_frag = 1;
+    }
+  }
+
+  return have_frag ? 1 : make_empty(ps, frag);
+}
+
+/**
+ * @brief 選択 ('|') をパースする
+ *
+ * @param[in,out] ps パース中の状態
+ * @param[out] frag 作成した断片
+ * @return 成功時は 1、エラー時は 0
+ */
+static int parse_alternation(Parser *ps, Fragment *frag) {
+  if (!parse_concatenation(ps, frag)) {
+    return 0;
+  }
+
+  while (*ps->p == '|') {
+    ps->p++;
+    Fragment right, alt;
+    if (!parse_concatenation(ps, &right) ||
+        !make_alternative(ps, &alt, frag, &right)) {
+      return 0;
+    }
+    *frag = alt;
+  }
+  return 1;
+}
+
+/**
+ * @brief ワイルドカードのパターン ('*' と '?') をパースする
+ *
+ * '*' は任意の文字列 ('/' を含む) 、 '?' は任意の 1 文字に一致し、
+ * それ以外の文字はすべてそのままの文字として扱う (match_pattern と同じ規則)
+ *
+ * @param[in,out] ps パース中の状態
+ * @param[out] frag 作成した断片
+ * @return 成功時は 1、エラー時は 0
+ */
+static int parse_glob(Parser *ps, Fragment *frag) {
+  int have_frag = 0;
+
+  while (*ps->p) {
+    Fragment next;
+    int ok;
+    if (*ps->p == '*') {
+      ps->p++;
+      ok = make_any_char(ps, &next) && apply_repeat(ps, &next, '*');
+    } else if (*ps->p == '?') {
+      ps->p++;
+      ok = make_any_char(ps, &next);
+    } else {
+      ok = make_literal(ps, &next, read_char(ps));
+    }
+    if (!ok) {
+      return 0;
+    }
+    if (have_frag) {
+      patch(ps->re, frag->holes, next.start);
+      frag->holes = next.holes;
+    } else {
+      *frag = next;
+      have_frag = 1;
+    }
+  }
+
+  return have_frag ? 1 : make_empty(ps, frag);
+}
+
+/**
+ * @brief バイト集合からバイトクラスを求める
+ *
+ * どのバイト集合に含まれるかがすべて等しいバイトを同じクラスにまとめる
+ *
+ * @param[in,out] re コンパイル中の正規表現
+ */
+static void compute_byte_classes(Regex *re) {
+  memset(re->byte_class, 0, sizeof(re->byte_class));
+  re->class_count = 1;
+
+  // バイト集合ごとに、集合に含まれるバイトと含まれないバイトが混在する
+  // クラスを分割する
+  for (int i = 0; i < re->set_count; i++) {
+    const ByteSet *set = &re->sets[i];
+    unsigned char has_in[256];   // クラスに集合に含まれるバイトがあるか
+    unsigned char has_out[256];  // クラスに集合に含まれないバイトがあるか
+    int new_class[256];          // 分割後に集合に含まれる側が属するクラス
+
+    memset(has_in, 0, re->class_count);
+    memset(has_out, 0, re->class_count);
+    for (int c = 0; c < 256; c++) {
+      if (byteset_has(set, c)) {
+        has_in[re->byte_class[c]] = 1;
+      } else {
+        has_out[re->byte_class[c]] = 1;
+      }
+    }
+
+    int count = re->class_count;
+    for (int k = 0; k < count; k++) {
+      new_class[k] = (has_in[k] && has_out[k]) ? re->class_count++ : k;
+    }
+    for (int c = 0; c < 256; c++) {
+      if (byteset_has(set, c)) {
+        re->byte_class[c] = new_class[re->byte_class[c]];
+      }
+    }
+  }
+}
+
+/**
+ * @brief NFA の状態の ε 閉包を状態集合に追加する
+ *
+ * NFA_SPLIT は集合に含めず、その遷移先をたどる
+ *
+ * @param[in,out] re 正規表現
+ * @param[in,out] set 状態集合
+ * @param[in] count 状態集合の要素数
+ * @param[in] state 追加する状態
+ * @return 追加後の要素数
+ */
+static int add_closure(Regex *re, int *set, int count, const int state) {
+  int sp = 0;
+  re->stack[sp++] = state;
+
+  while (sp > 0) {
+    int s = re->stack[--sp];
+    if (s < 0 || re->marks[s] == re->generation) {
+      continue;
+    }
+    re->marks[s] = re->generation;
+
+    NfaState *st = &re->states[s];
+    if (st->type == NFA_SPLIT) {
+      // NFA_SPLIT はそれぞれ 1 度しか展開されないため、
+      // スタックの大きさは状態数の 2 倍 + 1 で足りる
+      if (st->out1 >= 0 && re->marks[st->out1] != re->generation) {
+        re->stack[sp++] = st->out1;
+      }
+      if (st->out >= 0 && re->marks[st->out] != re->generation) {
+        re->stack[sp++] = st->out;
+      }
+    } else {
+      set[count++] = s;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief 新しい世代番号に切り替える
+ */
+static void next_generation(Regex *re) {
+  if (++re->generation == 0) {
+    memset(re->marks, 0, sizeof(unsigned int) * re->state_count);
+    re->generation = 1;
+  }
+}
+
+/**
+ * @brief NFA の状態集合を 1 バイト分遷移させる
+ *
+ * @param[in,out] re 正規表現
+ * @param[in] from 遷移元の状態集合
+ * @param[in] from_count 遷移元の状態集合の要素数
+ * @param[in] c 入力バイト
+ * @param[out] to 遷移先の状態集合
+ * @return 遷移先の状態集合の要素数
+ */
+static int nfa_step(Regex *re, const int *from, const int from_count,
+                    const int c, int *to) {
+  int count = 0;
+  next_generation(re);
+  for (int i = 0; i < from_count; i++) {
+    NfaState *st = &re->states[from[i]];
+    if (st->type == NFA_BYTESET && byteset_has(&re->sets[st->set], c)) {
+      count = add_closure(re, to, count, st->out);
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief 状態集合が受理状態を含むかを判定する
+ */
+static int set_accepts(const Regex *re, const int *set, const int count) {
+  for (int i = 0; i < count; i++) {
+    if (set[i] == re->match) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief NFA の状態集合に対応する DFA の状態を検索し、なければ追加する
+ *
+ * set は昇順に並べ替えられる
+ *
+ * @param[in,out] re 正規表現
+ * @param[in,out] set NFA の状態集合
+ * @param[in] count 状態集合の要素数
+ * @return DFA の状態の番号、キャッシュの上限に達した場合は -1
+ */
+static int dfa_find_or_add(Regex *re, int *set, const int count) {
+  // 挿入ソート (状態集合は通常小さい)
+  for (int i = 1; i < count; i++) {
+    int v = set[i];
+    int j = i - 1;
+    while (j >= 0 && set[j] > v) {
+      set[j + 1] = set[j];
+      j--;
+    }
+    set[j + 1] = v;
+  }
+
+  unsigned int hash = 2166136261u;
+  for (int i = 0; i < count; i++) {
+    hash = (hash ^ (unsigned int)set[i]) * 16777619u;
+  }
+
+  for (int d = re->buckets[hash % DFA_BUCKETS]; d >= 0;
+       d = re->dfa[d]->hash_next) {
+    DfaState *st = re->dfa[d];
+    if (st->hash == hash && st->count == count &&
+        memcmp(st->set, set, sizeof(int) * count) == 0) {
+      return d;
+    }
+  }
+
+  // キャッシュ領域から新しい状態を確保する
+  long size = sizeof(DfaState) + sizeof(int) * (re->class_count + count);
+  size = (size + 3) & ~3L;
+  if (re->dfa_count >= re->dfa_capacity ||
+      re->cache_used + size > re->cache_size) {
+    return -1;
+  }
+
+  DfaState *st = (DfaState *)(re->cache + re->cache_used);
+  re->cache_used += size;
+  st->next = (int *)(st + 1);
+  st->set = st->next + re->class_count;
+  st->count = count;
+  st->hash = hash;
+  st->accepting = set_accepts(re, set, count);
+  for (int i = 0; i < re->class_count; i++) {
+    st->next[i] = DFA_UNKNOWN;
+  }
+  memcpy(st->set, set, sizeof(int) * count);
+
+  int d = re->dfa_count++;
+  re->dfa[d] = st;
+  st->hash_next = re->buckets[hash % DFA_BUCKETS];
+  re->buckets[hash % DFA_BUCKETS] = d;
+  return d;
+}
+
+/**
+ * @brief パターンをコンパイルする (regex_compile と regex_compile_glob の本体)
+ *
+ * @param[in] pattern パターン
+ * @param[in] ignore_case 大文字小文字を区別しない場合は 1、区別する場合は 0
+ * @param[in] cache_size DFA キャッシュの上限 (バイト)
+ * @param[out] error エラー時にエラーメッセージを格納するポインタ
+ * @param[in] glob ワイルドカードのパターンの場合は 1、正規表現の場合は 0
+ * @return 成功時はコンパイル済みの正規表現、エラー時は NULL
+ */
+static Regex *compile_pattern(const char *pattern, const int ignore_case,
+                              const long cache_size, const char **error,
+                              const int glob) {
+  Regex *re = (Regex *)calloc(1, sizeof(Regex));
+  if (re == NULL) {
+    *error = "Memory allocation error";
+    return NULL;
+  }
+
+  Parser ps;
+  ps.re = re;
+  ps.p = (const unsigned char *)pattern;
+  ps.ignore_case = ignore_case;
+  ps.depth = 0;
+  ps.error = NULL;
+
+  // 先頭の '^' は文字列全体との照合なので無視する
+  if (!glob && *ps.p == '^') {
+    ps.p++;
+  }
+
+  Fragment frag;
+  if (!(glob ? parse_glob(&ps, &frag) : parse_alternation(&ps, &frag))) {
+    *error = ps.error;
+    regex_free(re);
+    return NULL;
+  }
+
+  re->match = add_state(re, NFA_MATCH, NULL);
+  if (re->match < 0) {
+    *error = "Memory allocation error";
+    regex_free(re);
+    return NULL;
+  }
+  patch(re, frag.holes, re->match);
+  re->start = frag.start;
+
+  compute_byte_classes(re);
+
+  // 照合用の作業領域と DFA キャッシュを確保する
+  re->work_a = (int *)malloc(sizeof(int) * re->state_count);
+  re->work_b = (int *)malloc(sizeof(int) * re->state_count);
+  re->stack = (int *)malloc(sizeof(int) * (re->state_count * 2 + 1));
+  re->marks = (unsigned int *)calloc(re->state_count, sizeof(unsigned int));
+  re->cache_size = cache_size < DFA_MIN_CACHE ? DFA_MIN_CACHE : cache_size;
+  re->cache = (char *)malloc(re->cache_size);
+  re->dfa_capacity =
+      re->cache_size / (sizeof(DfaState) + sizeof(int) * re->class_count) + 1;
+  re->dfa = (DfaState **)malloc(sizeof(DfaState *) * re->dfa_capacity);
+  if (re->work_a == NULL || re->work_b == NULL || re->stack == NULL ||
+      re->marks == NULL || re->cache == NULL || re->dfa == NULL) {
+    *error = "Memory allocation error";
+    regex_free(re);
+    return NULL;
+  }
+  re->generation = 0;
+  for (int i = 0; i < DFA_BUCKETS; i++) {
+    re->buckets[i] = -1;
+  }
+
+  // 開始状態を DFA に登録する (入らない場合は NFA のシミュレーションで照合する)
+  next_generation(re);
+  int count = add_closure(re, re->work_a, 0, re->start);
+  re->dfa_start = cache_size > 0 ? dfa_find_or_add(re, re->work_a, count) : -1;
+  if (re->dfa_start < 0) {
+    re->dfa_capacity = 0;
+  }
+
+  return re;
+}
+
+Regex *regex_compile(const char *pattern, int ignore_case, long cache_size,
+                     const char **error) {
+  return compile_pattern(pattern, ignore_case, cache_size, error, 0);
+}
+
+Regex *regex_compile_glob(const char *pattern, int ignore_case,
+                          long cache_size, const char **error) {
+  return compile_pattern(pattern, ignore_case, cache_size, error, 1);
+}
+
+/**
+ * @brief DFA の状態から 1 バイト分遷移する
+ *
+ * 遷移先が未構築の場合は NFA の状態集合から求めてキャッシュする
+ *
+ * @param[in,out] re 正規表現
+ * @param[in] d 遷移元の DFA の状態
+ * @param[in] c 入力バイト
+ * @param[out] nfa_count キャッシュの上限に達した場合に、遷移先の NFA の
+ * 状態集合 (re->work_a に格納される) の要素数を格納する
+ * @return 遷移先の DFA の状態、 DFA_DEAD 、またはキャッシュの上限に達した場合は
+ * DFA_UNKNOWN
+ */
+static int dfa_step(Regex *re, const int d, const int c, int *nfa_count) {
+  DfaState *st = re->dfa[d];
+  int *slot = &st->next[re->byte_class[c]];
+
+  if (*slot == DFA_UNKNOWN) {
+    int count = nfa_step(re, st->set, st->count, c, re->work_a);
+    if (count == 0) {
+      *slot = DFA_DEAD;
+    } else {
+      int next = dfa_find_or_add(re, re->work_a, count);
+      if (next < 0) {
+        *nfa_count = count;
+        return DFA_UNKNOWN;
+      }
+      *slot = next;
+    }
+  }
+  return *slot;
+}
+
+/**
+ * @brief DFA の状態から文字列を照合する (DFA キャッシュが上限に達した場合は
+ * NFA のシミュレーションに切り替える)
+ *
+ * @param[in,out] re 正規表現
+ * @param[in] d 照合を開始する DFA の状態 (負の場合は NFA の開始状態から照合する)
+ * @param[in] parts 照合する文字列の配列 (連結した文字列と照合する)
+ * @param[in] part_count parts の要素数
+ * @return 一致する場合は非ゼロ値、一致しない場合は 0
+ */
+static int match_parts(Regex *re, int d, const unsigned char *const *parts,
+                       const int part_count) {
+  int *current = re->work_a;  // NFA のシミュレーション中の状態集合
+  int *other = re->work_b;
+  int count = 0;
+
+  if (d < 0) {
+    next_generation(re);
+    count = add_closure(re, current, 0, re->start);
+  }
+
+  for (int part = 0; part < part_count; part++) {
+    for (const unsigned char *s = parts[part]; *s; s++) {
+      if (d >= 0) {
+        // DFA で遷移
+        d = dfa_step(re, d, *s, &count);
+        if (d == DFA_DEAD) {
+          return 0;
+        }
+        if (d == DFA_UNKNOWN) {
+          // キャッシュの上限に達したので NFA のシミュレーションに切り替える
+          d = -1;
+          current = re->work_a;
+          other = re->work_b;
+        }
+      } else {
+        // NFA のシミュレーションで遷移
+        count = nfa_step(re, current, count, *s, other);
+        if (count == 0) {
+          return 0;
+        }
+        int *tmp = current;
+        current = other;
+        other = tmp;
+      }
+    }
+  }
+
+  return d >= 0 ? re->dfa[d]->accepting : set_accepts(re, current, count);
+}
+
+int regex_match(Regex *re, const char *prefix, const char *string) {
+  const unsigned char *parts[2];
+  parts[0] = (const unsigned char *)(prefix ? prefix : "");
+  parts[1] = (const unsigned char *)string;
+  return match_parts(re, re->dfa_start, parts, 2);
+}
+
+int regex_start_state(const Regex *re) {
+  return re->dfa_start >= 0 ? re->dfa_start : REGEX_STATE_UNKNOWN;
+}
+
+int regex_advance(Regex *re, int state, const char *string) {
+  int count;
+  for (const unsigned char *s = (const unsigned char *)string;
+       *s && state >= 0; s++) {
+    state = dfa_step(re, state, *s, &count);
+  }
+  return state;
+}
+
+int regex_match_from(Regex *re, int state, const char *string) {
+  const unsigned char *parts[1];
+  if (state == REGEX_STATE_DEAD) {
+    return 0;
+  }
+  parts[0] = (const unsigned char *)string;
+  return match_parts(re, state, parts, 1);
+}
+
+int regex_forced_component(Regex *re, int state, int fold_case, char *name,
+                           int size) {
+  int len = 0;
+
+  while (state >= 0 && len < size - 1) {
+    if (re->dfa[state]->accepting) {
+      return 0;
+    }
+
+    // 遷移先が DFA_DEAD にならないバイトが 1 つだけかを調べる
+    int live = -1;
+    int count;
+    for (int c = 1; c < 256; c++) {
+      int next = dfa_step(re, state, c, &count);
+      if (next == DFA_UNKNOWN) {
+        return 0;
+      }
+      if (next == DFA_DEAD) {
+        continue;
+      }
+      if (live < 0) {
+        live = c;
+      } else if (!(fold_case && c < 0x80 && isalpha(c) &&
+                   tolower(c) == tolower(live))) {
+        return 0;
+      }
+    }
+    if (live < 0) {
+      return 0;
+    }
+
+    if (live == '/') {
+      // "." と ".." はディレクトリを列挙した場合に現れないので対象外とする
+      name[len] = '\0';
+      if (len == 0 || strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+        return 0;
+      }
+      return len;
+    }
+    name[len++] = (char)live;
+    state = dfa_step(re, state, live, &count);
+  }
+  return 0;
+}
+
+void regex_free(Regex *re) {
+  if (re == NULL) {
+    return;
+  }
+  free(re->states);
+  free(re->sets);
+  free(re->work_a);
+  free(re->work_b);
+  free(re->stack);
+  free(re->marks);
+  free(re->cache);
+  free(re->dfa);
+  free(re);
+}
@@ -0,0 +1,129 @@
+#ifndef REGEX_DFA_H
+#define REGEX_DFA_H
+
+/**
+ * @brief DFA キャッシュの上限のデフォルト値 (バイト)
+ */
+#define REGEX_DEFAULT_CACHE_SIZE (64L * 1024)
+
+#define REGEX_STATE_DEAD (-1)     // 以降どの文字列を続けても一致しない状態
+#define REGEX_STATE_UNKNOWN (-2)  // DFA キャッシュに入らず状態を表せない
+
+/**
+ * @brief コンパイル済みの正規表現
+ *
+ * パターンはバイト単位の NFA にコンパイルされ、照合時には NFA の状態集合を
+ * DFA の状態として必要になった分だけ構築してキャッシュする (遅延 DFA)。
+ * キャッシュが上限に達した場合は NFA を直接シミュレートして照合を続ける
+ *
+ * @struct Regex
+ */
+typedef struct Regex Regex;
+
+/**
+ * @brief 正規表現をコンパイルする
+ *
+ * 拡張正規表現 (ERE) のサブセットに対応する。
+ * 使用できるのは文字、 '.' 、ブラケット式 ("[...]" 、 "[^...]" 、範囲、
+ * "[:alpha:]" などの文字クラス) 、 '*' 、 '+' 、 '?' 、 '|' 、 "(...)" 、
+ * '\\' によるエスケープで、先頭の '^' と末尾の '$' は無視する
+ * (文字列全体との照合のため) 。 2 バイト文字 (SJIS) は 1 文字として扱う
+ *
+ * @param[in] pattern 正規表現のパターン
+ * @param[in] ignore_case 大文字小文字を区別しない場合は 1、区別する場合は 0
+ * @param[in] cache_size DFA キャッシュの上限 (バイト)
+ * @param[out] error エラー時にエラーメッセージを格納するポインタ
+ * @return 成功時はコンパイル済みの正規表現、エラー時は NULL
+ */
+Regex *regex_compile(const char *pattern, int ignore_case, long cache_size,
+                     const char **error);
+
+/**
+ * @brief ワイルドカードのパターンをコンパイルする
+ *
+ * '*' (任意の文字列) と '?' (任意の 1 文字) を -name と同じ規則で扱う。
+ * '*' は '/' にも一致する。コンパイル結果は regex_compile と同様に使用できる
+ *
+ * @param[in] pattern ワイルドカードのパターン
+ * @param[in] ignore_case 大文字小文字を区別しない場合は 1、区別する場合は 0
+ * @param[in] cache_size DFA キャッシュの上限 (バイト)
+ * @param[out] error エラー時にエラーメッセージを格納するポインタ
+ * @return 成功時はコンパイル済みのパターン、エラー時は NULL
+ */
+Regex *regex_compile_glob(const char *pattern, int ignore_case,
+                          long cache_size, const char **error);
+
+/**
+ * @brief 正規表現が文字列全体と一致するかを判定する
+ *
+ * prefix と string を連結した文字列と照合する。照合中にメモリを確保することはない
+ *
+ * @param[in,out] re コンパイル済みの正規表現 (DFA キャッシュが更新される)
+ * @param[in] prefix 照合する文字列の前半 (NULL の場合は空文字列)
+ * @param[in] string 照合する文字列の後半
+ * @return 一致する場合は非ゼロ値、一致しない場合は 0
+ */
+int regex_match(Regex *re, const char *prefix, const char *string);
+
+/**
+ * @brief 照合の開始状態を取得する
+ *
+ * 状態は文字列の先頭部分まで照合した途中経過を表し、 regex_advance で
+ * 後続の文字列の分だけ進めることができる。ディレクトリのパスまで進めた状態を
+ * 保持しておけば、その中のエントリはファイル名の分だけ照合すればよい
+ *
+ * @param[in] re コンパイル済みの正規表現
+ * @return 開始状態、 DFA キャッシュに入らない場合は REGEX_STATE_UNKNOWN
+ */
+int regex_start_state(const Regex *re);
+
+/**
+ * @brief 状態を文字列の分だけ進める
+ *
+ * @param[in,out] re コンパイル済みの正規表現 (DFA キャッシュが更新される)
+ * @param[in] state 進める前の状態
+ * @param[in] string 照合する文字列
+ * @return 進めた後の状態。以降どの文字列を続けても一致しない場合は
+ * REGEX_STATE_DEAD 、 state が REGEX_STATE_UNKNOWN の場合や
+ * DFA キャッシュが上限に達した場合は REGEX_STATE_UNKNOWN
+ */
+int regex_advance(Regex *re, int state, const char *string);
+
+/**
+ * @brief 状態から続く文字列が残りの部分と一致するかを判定する
+ *
+ * DFA キャッシュが上限に達した場合も NFA のシミュレーションで照合を続ける
+ *
+ * @param[in,out] re コンパイル済みの正規表現 (DFA キャッシュが更新される)
+ * @param[in] state 照合を開始する状態 (REGEX_STATE_UNKNOWN は指定できない)
+ * @param[in] string 照合する文字列の残りの部分
+ * @return 一致する場合は非ゼロ値、一致しない場合は 0
+ */
+int regex_match_from(Regex *re, int state, const char *string);
+
+/**
+ * @brief 状態に続けられるパスの要素が 1 通りに決まる場合にその名前を求める
+ *
+ * 状態から受理状態を経ずに次の '/' までに続けられる文字列が 1 通りしかない
+ * 場合に、その文字列 ('/' を含まない) を返す。このとき、同じディレクトリの
+ * ほかの名前のエントリはどれも一致しない
+ *
+ * @param[in,out] re コンパイル済みの正規表現 (DFA キャッシュが更新される)
+ * @param[in] state 状態
+ * @param[in] fold_case 大文字小文字だけが異なる 1 バイト文字を同じ文字と
+ * みなす場合は 1 (ファイルシステムが大文字小文字を区別しない場合)
+ * @param[out] name 名前を格納するバッファ
+ * @param[in] size name のバイト数
+ * @return 名前のバイト数、 1 通りに決まらない場合は 0
+ */
+int regex_forced_component(Regex *re, int state, int fold_case, char *name,
+                           int size);
+
+/**
+ * @brief コンパイル済みの正規表現を解放する
+ *
+ * @param[in] re 解放する正規表現 (NULL の場合は何もしない)
+ */
+void regex_free(Regex *re);
+
+#endif /* REGEX_DFA_H */
@@ -0,0 +1,141 @@
+/**
+ * @file test_content_search.c
+ * @brief content_search.c の関数をテストするテストコード
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../content_search.h"
+
+/**
+ * @brief 単一のテストケースを実行する関数
+ *
+ * data を書き込んだ一時ファイルの内容から text を探す
+ *
+ * @param[in] test_name テスト名
+ * @param[in] text 探す文字列
+ * @param[in] ignore_case 英字の大文字小文字を区別しない場合は 1
+ * @param[in] data ファイルの内容
+ * @param[in] size data のバイト数
+ * @param[in] expected 含まれることが期待される場合は 1
+ * @return int テスト成功時は 1、失敗時は 0
+ */
+static int run_test(const char *test_name, const char *text,
+                    const int ignore_case, const char *data, const size_t size,
+                    const int expected) {
+  ContentPattern *pattern = content_pattern_compile(text, ignore_case);
+  if (pattern == NULL) {
+    printf("%s: 失敗 (準備できない)\n", test_name);
+    return 0;
+  }
+
+  FILE *stream = tmpfile();
+  if (stream == NULL) {
+    printf("%s: 失敗 (一時ファイルを作成できない)\n", test_name);
+    content_pattern_free(pattern);
+    return 0;
+  }
+  fwrite(data, 1, size, stream);
+  rewind(stream);
+  int result = content_pattern_search_stream(pattern, stream);
+  fclose(stream);
+  content_pattern_free(pattern);
+
+  if (result != expected) {
+    printf("%s: 失敗 (文字列: \"%s\", 期待値: %d, 結果: %d)\n", test_name,
+           text, expected, result);
+    return 0;
+  }
+  printf("%s: 成功\n", test_name);
+  return 1;
+}
+
+/**
+ * @brief 大きなデータの指定した位置に文字列を置いて探すテストを実行する関数
+ *
+ * @param[in] test_name テスト名
+ * @param[in] size データのバイト数
+ * @param[in] offset 文字列を置く位置 (負の場合は置かない)
+ * @return int テスト成功時は 1、失敗時は 0
+ */
+static int run_large_test(const char *test_name, const size_t size,
+                          const long offset) {
+  static const char needle[] = "needle";
+  char *data = (char *)malloc(size);
+  if (data == NULL) {
+    printf("%s: 失敗 (メモリ不足)\n", test_name);
+    return 0;
+  }
+  // 文字列の一部だけが繰り返し現れるデータにする
+  for (size_t i = 0; i < size; i++) {
+    data[i] = "neede"[i % 5];
+  }
+  if (offset >= 0) {
+    memcpy(data + offset, needle, strlen(needle));
+  }
+  int result = run_test(test_name, needle, 0, data, size, offset >= 0);
+  free(data);
+  return result;
+}
+
+/**
+ * @brief メイン関数
+ *
+ * @return int プログラムの終了ステータス
+ */
+int main(void) {
+  static const char text[] = "Hello, World!\nefind for X68000\n";
+  static const char binary[] = {'\0', 'a', '\0', 'b', '\xff', 'c'};
+  int failed_tests = 0;
+
+  printf("content_search のテスト開始\n");
+  printf("----------------------------------------------------\n");
+
+  // 基本的な照合
+  if (!run_test("先頭", "Hello", 0, text, strlen(text), 1)) failed_tests++;
+  if (!run_test("末尾", "X68000\n", 0, text, strlen(text), 1))
+    failed_tests++;
+  if (!run_test("途中", "find", 0, text, strlen(text), 1)) failed_tests++;
+  if (!run_test("1 文字", "!", 0, text, strlen(text), 1)) failed_tests++;
+  if (!run_test("含まれない", "world", 0, text, strlen(text), 0))
+    failed_tests++;
+  if (!run_test("内容より長い", "Hello, World!\nefind for X68000\n!", 0,
+                text, strlen(text), 0))
+    failed_tests++;
+  if (!run_test("空の文字列", "", 0, text, strlen(text), 1)) failed_tests++;
+  if (!run_test("空のファイル", "a", 0, "", 0, 0)) failed_tests++;
+
+  // 大文字小文字を区別しない照合
+  if (!run_test("大文字小文字を無視", "WORLD", 1, text, strlen(text), 1))
+    failed_tests++;
+  if (!run_test("大文字小文字を無視 (x68000)", "x68000", 1, text,
+                strlen(text), 1))
+    failed_tests++;
+  if (!run_test("大文字小文字を無視 (含まれない)", "worlds", 1, text,
+                strlen(text), 0))
+    failed_tests++;
+
+  // バイナリデータ
+  if (!run_test("バイナリ", "b\xff", 0, binary, sizeof(binary), 1))
+    failed_tests++;
+
+  // 読み込みの単位を超えるデータ
+  if (!run_large_test("大きなデータ (含まれない)", 100000, -1))
+    failed_tests++;
+  if (!run_large_test("大きなデータ (末尾)", 100000, 100000 - 6))
+    failed_tests++;
+  if (!run_large_test("読み込みの境界をまたぐ", 100000, 32768 - 3))
+    failed_tests++;
+  if (!run_large_test("読み込みの境界の直後", 100000, 32768))
+    failed_tests++;
+
+  printf("----------------------------------------------------\n");
+  if (failed_tests == 0) {
+    printf("全てのテストが成功しました！\n");
+    return 0;
+  } else {
+    printf("%d 個のテストが失敗しました。\n", failed_tests);
+    return 1;
+  }
+}
@@ -0,0 +1,506 @@
+/**
+ * @file test_evaluate_batch.c
+ * @brief evaluate_batch() 関数をテストするテストコード
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// static 関数をテストするため、efind.c ファイルをインクルードする
+#include "../efind.c"
+
+/**
+ * @brief テスト用のエントリを表す構造体
+ */
+typedef struct {
+  const char *name;  // ファイル名
+  int is_dir;        // ディレクトリかどうかのフラグ
+  int attributes;    // 属性フラグ (FILE_ATTR_* の組み合わせ)
+} TestEntry;
+
+/**
+ * @brief テスト用のエントリ一覧
+ */
+static const TestEntry test_entries[] = {
+    {"main.c", 0, 0},          {"efind.c", 0, 0},
+    {"efind.h", 0, 0},         {"test", 1, 0},
+    {"libmb", 1, 0},           {"efind.x", 0, FILE_ATTR_EXECUTABLE},
+    {"link.c", 0, FILE_ATTR_SYMLINK},
+    {"dirlink", 1, FILE_ATTR_SYMLINK},
+    {"README.md", 0, 0},       {"makefile", 0, 0},
+};
+
+#define TEST_ENTRY_COUNT ((int)(sizeof(test_entries) / sizeof(test_entries[0])))
+
+/**
+ * @brief 1 エントリずつ条件を評価する (比較用の参照実装)
+ *
+ * 条件を先頭から順に評価し、論理演算子で左から結合する
+ *
+ * @param[in] entry 評価対象のエントリ
+ * @param[in] opts 評価基準を含む Options 構造体へのポインタ
+ * @return 条件を満たす場合は 1、満たさない場合は 0
+ */
+static int reference_evaluate(const TestEntry *entry, const Options *opts) {
+  if (opts->condition_count == 0) {
+    return 1;
+  }
+
+  int result = 0;
+  Operator current_op = OP_AND;
+
+  for (int i = 0; i < opts->condition_count; i++) {
+    const Condition *cond = &opts->conditions[i];
+    int is_link = (entry->attributes & FILE_ATTR_SYMLINK) != 0;
+    int match = 1;
+
+    if ((cond->type == TYPE_FILE && (entry->is_dir || is_link)) ||
+        (cond->type == TYPE_DIR && (!entry->is_dir || is_link)) ||
+        (cond->type == TYPE_SYMLINK && !is_link) ||
+        (cond->type == TYPE_EXECUTABLE &&
+         !(entry->attributes & FILE_ATTR_EXECUTABLE))) {
+      match = 0;
+    }
+    if (cond->pattern != NULL &&
+        !match_pattern(cond->pattern, entry->name, cond->ignore_case, 0)) {
+      match = 0;
+    }
+
+    if (i == 0) {
+      result = match;
+    } else if (current_op == OP_AND) {
+      result = result && match;
+    } else {
+      result = result || match;
+    }
+    current_op = cond->op;
+  }
+
+  return result;
+}
+
+/**
+ * @brief 条件を追加する
+ *
+ * @param[in,out] opts 条件を追加する Options 構造体
+ * @param[in] type ファイルタイプ
+ * @param[in] pattern 名前パターン (NULL の場合は指定なし)
+ * @param[in] op 次の条件との論理演算子
+ */
+static void add_condition(Options *opts, FileType type, const char *pattern,
+                          Operator op) {
+  Condition *cond = &opts->conditions[opts->condition_count++];
+  memset(cond, 0, sizeof(*cond));
+  cond->type = type;
+  cond->pattern = (char *)pattern;
+  cond->op = op;
+  cond->ignore_case = 0;
+  analyze_name_pattern(cond);
+}
+
+/**
+ * @brief エントリ集合を評価し、参照実装の結果と比較する
+ *
+ * repeat 回繰り返したエントリ一覧を使用し、ワード境界をまたぐ場合も確認する
+ *
+ * @param[in] test_name テスト名
+ * @param[in] opts 評価基準を含む Options 構造体へのポインタ
+ * @param[in] repeat エントリ一覧を繰り返す回数
+ * @return テスト結果 (0: 成功, 1: 失敗)
+ */
+static int run_batch_test(const char *test_name, const Options *opts,
+                          int repeat) {
+  EntryBatch batch;
+  EvalPlan plan;
+  int failed = 0;
+
+  plan_init(&plan, opts);
+  batch_init(&batch);
+  for (int r = 0; r < repeat; r++) {
+    for (int i = 0; i < TEST_ENTRY_COUNT; i++) {
+      batch_add_entry(&batch, test_entries[i].name, test_entries[i].is_dir,
+                      test_entries[i].attributes);
+    }
+  }
+
+  evaluate_batch(&batch, &plan, opts, 0);
+
+  for (int i = 0; i < batch.count; i++) {
+    const TestEntry *entry = &test_entries[i % TEST_ENTRY_COUNT];
+    int expected = reference_evaluate(entry, opts);
+    int result = MASK_TEST(batch.match, i) ? 1 : 0;
+    if (expected != result ||
+        strcmp(BATCH_NAME(&batch, i), entry->name) != 0 ||
+        BATCH_NAME_LEN(&batch, i) != (int)strlen(entry->name)) {
+      printf("%s: 失敗 (エントリ %d: \"%s\", 期待値: %d, 結果: %d)\n",
+             test_name, i, entry->name, expected, result);
+      failed = 1;
+      break;
+    }
+  }
+
+  // 最終ワードの余りのビットが立っていないこと
+  if (!failed && batch.count % MASK_BITS) {
+    MaskWord rest = batch.match[MASK_WORDS(batch.count) - 1] >>
+                    (batch.count % MASK_BITS);
+    if (rest) {
+      printf("%s: 失敗 (範囲外のビットが立っている)\n", test_name);
+      failed = 1;
+    }
+  }
+
+  if (!failed) {
+    printf("%s: 成功\n", test_name);
+  }
+
+  batch_free(&batch);
+  return failed;
+}
+
+/**
+ * @brief 評価順の並べ替えのテスト
+ *
+ * 同じエントリ集合を繰り返し評価し、評価順が並べ替えられた後も
+ * 結果が参照実装と一致すること、および期待した条件が先頭に来ることを確認する
+ *
+ * @param[in] test_name テスト名
+ * @param[in] opts 評価基準を含む Options 構造体へのポインタ
+ * @param[in] expected_first 並べ替え後に最初に評価されるべき条件のインデックス
+ * @return テスト結果 (0: 成功, 1: 失敗)
+ */
+static int run_reorder_test(const char *test_name, const Options *opts,
+                            int expected_first) {
+  EntryBatch batch;
+  EvalPlan plan;
+  int failed = 0;
+
+  plan_init(&plan, opts);
+  batch_init(&batch);
+  for (int r = 0; r < 7; r++) {
+    for (int i = 0; i < TEST_ENTRY_COUNT; i++) {
+      batch_add_entry(&batch, test_entries[i].name, test_entries[i].is_dir,
+                      test_entries[i].attributes);
+    }
+  }
+
+  for (int round = 0; round < 10 && !failed; round++) {
+    evaluate_batch(&batch, &plan, opts, 0);
+    for (int i = 0; i < batch.count; i++) {
+      const TestEntry *entry = &test_entries[i % TEST_ENTRY_COUNT];
+      if (reference_evaluate(entry, opts) != (int)MASK_TEST(batch.match, i)) {
+        printf("%s: 失敗 (%d 回目の評価でエントリ %d が不一致)\n", test_name,
+               round + 1, i);
+        failed = 1;
+        break;
+      }
+    }
+  }
+
+  if (!failed && plan.steps[0].cond_index != expected_first) {
+    printf("%s: 失敗 (最初に評価される条件: %d, 期待値: %d)\n", test_name,
+           plan.steps[0].cond_index, expected_first);
+    failed = 1;
+  }
+
+  // OR のステップの位置は変わらないこと
+  for (int k = 0; k < plan.step_count && !failed; k++) {
+    int index = plan.steps[k].cond_index;
+    Operator expected_op = (k == 0) ? OP_AND : opts->conditions[k - 1].op;
+    if (plan.steps[k].op != expected_op ||
+        (expected_op == OP_OR && index != k)) {
+      printf("%s: 失敗 (OR のステップ %d が移動した)\n", test_name, k);
+      failed = 1;
+    }
+  }
+
+  if (!failed) {
+    printf("%s: 成功\n", test_name);
+  }
+
+  batch_free(&batch);
+  return failed;
+}
+
+/**
+ * @brief ファイルの内容の条件の評価順のテスト
+ *
+ * ファイルの内容の条件 (-contains) が、指定された位置に関わらず最初から
+ * AND の並びの最後に評価されることを確認する
+ *
+ * @param[in] test_name テスト名
+ * @param[in] opts 評価基準を含む Options 構造体へのポインタ
+ * @param[in] expected 評価される条件のインデックスの並び
+ * @return テスト結果 (0: 成功, 1: 失敗)
+ */
+static int run_deferred_test(const char *test_name, const Options *opts,
+                             const int *expected) {
+  EvalPlan plan;
+
+  plan_init(&plan, opts);
+  for (int k = 0; k < plan.step_count; k++) {
+    if (plan.steps[k].cond_index != expected[k]) {
+      printf("%s: 失敗 (ステップ %d の条件: %d, 期待値: %d)\n", test_name, k,
+             plan.steps[k].cond_index, expected[k]);
+      return 1;
+    }
+  }
+  printf("%s: 成功\n", test_name);
+  return 0;
+}
+
+/**
+ * @brief メタデータの条件のテスト
+ *
+ * エントリ i のサイズを i * 300 バイト、最終更新日時を基準の日時の i 日前
+ * として取得済みの状態にしておき、条件に一致するエントリを確認する
+ * (ディレクトリのエントリは -empty の評価でディレクトリを開くため使用しない)
+ *
+ * @param[in] test_name テスト名
+ * @param[in] cond 評価する条件 (meta_time は基準の日時に設定する)
+ * @param[in] expected 一致するエントリのインデックスのビット集合
+ * @return テスト結果 (0: 成功, 1: 失敗)
+ */
+static int run_metadata_test(const char *test_name, const Condition *cond,
+                             const unsigned long expected) {
+  static const time_t base_time = 1700000000;
+  Options opts;
+  EntryBatch batch;
+  EvalPlan plan;
+  int failed = 0;
+
+  opts.condition_count = 1;
+  opts.conditions[0] = *cond;
+  opts.conditions[0].meta_time = base_time;
+  plan_init(&plan, &opts);
+  batch_init(&batch);
+  for (int i = 0; i < TEST_ENTRY_COUNT; i++) {
+    if (!test_entries[i].is_dir) {
+      batch_add_entry(&batch, test_entries[i].name, 0, 0);
+    }
+  }
+
+  // すべてのエントリのメタデータを取得済みにしておく
+  int words = MASK_WORDS(batch.count);
+  batch.infos = (FileInfo *)calloc(batch.count, sizeof(FileInfo));
+  batch.info_loaded = (MaskWord *)calloc(words, sizeof(MaskWord));
+  batch.info_valid = (MaskWord *)calloc(words, sizeof(MaskWord));
+  for (int i = 0; i < batch.count; i++) {
+    batch.infos[i].size = i * 300;
+    batch.infos[i].mtime = base_time - i * 86400L - 3600;
+    MASK_SET(batch.info_loaded, i);
+    MASK_SET(batch.info_valid, i);
+  }
+
+  evaluate_batch(&batch, &plan, &opts, 0);
+
+  for (int i = 0; i < batch.count; i++) {
+    int result = MASK_TEST(batch.match, i) ? 1 : 0;
+    if (result != (int)((expected >> i) & 1)) {
+      printf("%s: 失敗 (エントリ %d: \"%s\", 結果: %d)\n", test_name, i,
+             BATCH_NAME(&batch, i), result);
+      failed = 1;
+      break;
+    }
+  }
+  if (!failed) {
+    printf("%s: 成功\n", test_name);
+  }
+
+  batch_free(&batch);
+  return failed;
+}
+
+/**
+ * @brief エントリの並べ替え (-s) のテスト
+ *
+ * 名前を並べ替えた順序と、ディレクトリかどうか・属性がエントリとともに
+ * 移動することを確認する
+ *
+ * @return テスト結果 (0: 成功, 1: 失敗)
+ */
+static int run_sort_test(void) {
+  // 先頭 4 バイトが同じ名前、 4 バイトより短い名前、シフト JIS の名前を含む
+  static const char *const names[] = {
+      "main.c", "\x83\x65\x83\x58\x83\x67", "mai", "README", "main.h",
+      "\x83\x41", "b", "mainx", "a.c", "main",
+  };
+  static const char *const sorted[] = {
+      "README", "a.c",   "b",   "mai", "main", "main.c", "main.h", "mainx",
+      "\x83\x41", "\x83\x65\x83\x58\x83\x67",
+  };
+  const int count = sizeof(names) / sizeof(names[0]);
+  EntryBatch batch;
+  int failed = 0;
+
+  batch_init(&batch);
+  for (int i = 0; i < count; i++) {
+    // 偶数番目をディレクトリにし、属性にはもとのインデックスを入れる
+    batch_add_entry(&batch, names[i], i % 2 == 0, i);
+  }
+  if (!batch_sort(&batch)) {
+    printf("並べ替え: 失敗 (メモリ不足)\n");
+    batch_free(&batch);
+    return 1;
+  }
+
+  for (int i = 0; i < count && !failed; i++) {
+    int from = batch.attributes[i];
+    if (strcmp(BATCH_NAME(&batch, i), sorted[i]) != 0 ||
+        BATCH_NAME_LEN(&batch, i) != (int)strlen(sorted[i]) ||
+        strcmp(names[from], sorted[i]) != 0 ||
+        (int)MASK_TEST(batch.is_dir, i) != (from % 2 == 0)) {
+      printf("並べ替え: 失敗 (%d 番目: \"%s\", 期待値: \"%s\")\n", i,
+             BATCH_NAME(&batch, i), sorted[i]);
+      failed = 1;
+    }
+  }
+  if (!failed) {
+    printf("並べ替え: 成功\n");
+  }
+
+  batch_free(&batch);
+  return failed;
+}
+
+/**
+ * @brief メイン関数
+ * @return テスト結果 (0: 成功, 0以外: 失敗)
+ */
+int main(void) {
+  Options opts;
+  int failed = 0;
+
+  printf("evaluate_batch のテストを開始します\n");
+  printf("----------------------------------------------------\n");
+
+  for (int repeat = 1; repeat <= 7; repeat += 6) {
+    printf("\n【エントリ数 %d】\n\n", TEST_ENTRY_COUNT * repeat);
+
+    opts.condition_count = 0;
+    failed += run_batch_test("条件なし", &opts, repeat);
+
+    opts.condition_count = 0;
+    add_condition(&opts, TYPE_DIR, NULL, OP_AND);
+    failed += run_batch_test("-type d", &opts, repeat);
+
+    opts.condition_count = 0;
+    add_condition(&opts, TYPE_FILE, NULL, OP_AND);
+    failed += run_batch_test("-type f", &opts, repeat);
+
+    opts.condition_count = 0;
+    add_condition(&opts, TYPE_SYMLINK, NULL, OP_AND);
+    failed += run_batch_test("-type l", &opts, repeat);
+
+    opts.condition_count = 0;
+    add_condition(&opts, TYPE_EXECUTABLE, NULL, OP_AND);
+    failed += run_batch_test("-type x", &opts, repeat);
+
+    opts.condition_count = 0;
+    add_condition(&opts, TYPE_FILE, NULL, OP_AND);
+    add_condition(&opts, TYPE_NONE, "*.c", OP_AND);
+    failed += run_batch_test("-type f -name '*.c'", &opts, repeat);
+
+    opts.condition_count = 0;
+    add_condition(&opts, TYPE_NONE, "*.c", OP_OR);
+    add_condition(&opts, TYPE_NONE, "*.h", OP_AND);
+    failed += run_batch_test("-name '*.c' -o -name '*.h'", &opts, repeat);
+
+    opts.condition_count = 0;
+    add_condition(&opts, TYPE_NONE, "efind*", OP_OR);
+    add_condition(&opts, TYPE_DIR, NULL, OP_AND);
+    add_condition(&opts, TYPE_NONE, "*i*", OP_AND);
+    failed += run_batch_test("-name 'efind*' -o -type d -name '*i*'", &opts,
+                             repeat);
+
+    opts.condition_count = 0;
+    add_condition(&opts, TYPE_NONE, "m?in.c", OP_AND);
+    add_condition(&opts, TYPE_NONE, "*.c", OP_OR);
+    add_condition(&opts, TYPE_EXECUTABLE, NULL, OP_AND);
+    failed += run_batch_test("-name 'm?in.c' -name '*.c' -o -type x", &opts,
+                             repeat);
+  }
+
+  printf("\n【評価順の並べ替え】\n\n");
+
+  opts.condition_count = 0;
+  add_condition(&opts, TYPE_NONE, "*", OP_AND);
+  add_condition(&opts, TYPE_NONE, "*f?n*", OP_AND);
+  add_condition(&opts, TYPE_EXECUTABLE, NULL, OP_AND);
+  failed += run_reorder_test("-name '*' -name '*f?n*' -type x", &opts, 2);
+
+  opts.condition_count = 0;
+  add_condition(&opts, TYPE_NONE, "*i*", OP_AND);
+  add_condition(&opts, TYPE_DIR, NULL, OP_OR);
+  add_condition(&opts, TYPE_NONE, "*.?", OP_AND);
+  add_condition(&opts, TYPE_SYMLINK, NULL, OP_AND);
+  failed += run_reorder_test("-name '*i*' -type d -o -name '*.?' -type l",
+                             &opts, 1);
+
+  ContentPattern *content = content_pattern_compile("main", 0);
+  opts.condition_count = 0;
+  add_condition(&opts, TYPE_NONE, NULL, OP_AND);
+  opts.conditions[0].content = content;
+  add_condition(&opts, TYPE_NONE, "*.c", OP_AND);
+  add_condition(&opts, TYPE_FILE, NULL, OP_AND);
+  failed += run_deferred_test("-contains main -name '*.c' -type f", &opts,
+                              (const int[]){1, 2, 0});
+
+  // OR のステップの位置は変わらないこと
+  opts.condition_count = 0;
+  add_condition(&opts, TYPE_NONE, "*.h", OP_OR);
+  add_condition(&opts, TYPE_FILE, NULL, OP_AND);
+  add_condition(&opts, TYPE_NONE, NULL, OP_AND);
+  opts.conditions[2].content = content;
+  add_condition(&opts, TYPE_NONE, "*.c", OP_AND);
+  failed += run_deferred_test(
+      "-name '*.h' -o -type f -contains main -name '*.c'", &opts,
+      (const int[]){0, 1, 3, 2});
+  content_pattern_free(content);
+
+  // ディレクトリを除く 8 エントリ (サイズ 0, 300, ..., 2100 バイト、
+  // 0 日前, 1 日前, ..., 7 日前に更新)
+  printf("\n【メタデータの条件】\n\n");
+
+  Condition cond;
+  memset(&cond, 0, sizeof(cond));
+  cond.type = TYPE_NONE;
+  cond.meta = META_SIZE;
+  cond.meta_compare = 1;
+  cond.meta_value = 2;
+  cond.meta_unit = 512;
+  failed += run_metadata_test("-size +2", &cond, 0xf0);  // 1025 バイト以上
+  cond.meta_compare = 0;
+  cond.meta_value = 1;
+  cond.meta_unit = 1024;
+  failed += run_metadata_test("-size 1k", &cond, 0x0e);  // 1 〜 1024 バイト
+  cond.meta_compare = -1;
+  cond.meta_value = 1;
+  failed += run_metadata_test("-size -1k", &cond, 0x01);  // 空のファイルのみ
+
+  cond.meta = META_MTIME;
+  cond.meta_unit = 86400;
+  cond.meta_compare = 0;
+  cond.meta_value = 3;
+  failed += run_metadata_test("-mtime 3", &cond, 0x08);
+  cond.meta_compare = -1;
+  failed += run_metadata_test("-mtime -3", &cond, 0x07);
+  cond.meta_compare = 1;
+  cond.meta_value = 5;
+  failed += run_metadata_test("-mtime +5", &cond, 0xc0);
+
+  cond.meta = META_EMPTY;
+  failed += run_metadata_test("-empty", &cond, 0x01);
+
+  printf("\n【エントリの並べ替え】\n\n");
+
+  failed += run_sort_test();
+
+  printf("----------------------------------------------------\n");
+  if (failed == 0) {
+    printf("全てのテストが成功しました！\n");
+  } else {
+    printf("%d 個のテストが失敗しました。\n", failed);
+  }
+
+  return failed;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file test_exec_command.c
+ * @brief exec_command.c の関数をテストするテストコード
+ *
+ * コマンドラインの長さの上限を超えるパスを渡したときに、コマンドを
+ * 実行せずに失敗として記録することを確認する
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../arch.h"
+#include "../exec_command.h"
+
+/**
+ * @brief 単一のテストケースを実行する関数
+ *
+ * @param[in] test_name テスト名
+ * @param[in] batch "{} +" 形式の場合は 1、 ";" 形式の場合は 0
+ * @param[in] name_len エントリの名前の長さ
+ * @param[in] expected_result exec_command_run の期待される戻り値
+ * @param[in] expected_pending 実行を待っているパスの期待される数
+ * @param[in] expected_failed 失敗として記録されることが期待される場合は 1
+ * @return int テスト成功時は 1、失敗時は 0
+ */
+static int run_test(const char *test_name, const int batch,
+                    const int name_len, const int expected_result,
+                    const int expected_pending, const int expected_failed) {
+  static char *args[] = {"echo", "{}"};
+  ExecCommand *cmd = exec_command_create(args, batch ? 1 : 2, 0, batch);
+  char *name = (char *)malloc(name_len + 1);
+  if (cmd == NULL || name == NULL) {
+    printf("%s: 失敗 (メモリ不足)\n", test_name);
+    exec_command_free(cmd);
+    free(name);
+    return 0;
+  }
+  memset(name, 'a', name_len);
+  name[name_len] = '\0';
+
+  int result = exec_command_run(cmd, "dir/", name);
+  int pending = cmd->pending_count;
+  int failed = cmd->failed;
+  exec_command_free(cmd);
+  free(name);
+
+  if (result != expected_result || pending != expected_pending ||
+      failed != expected_failed) {
+    printf("%s: 失敗 (戻り値: %d/%d, 待機: %d/%d, 失敗の記録: %d/%d)\n",
+           test_name, result, expected_result, pending, expected_pending,
+           failed, expected_failed);
+    return 0;
+  }
+  printf("%s: 成功\n", test_name);
+  return 1;
+}
+
+/**
+ * @brief メイン関数
+ *
+ * @return int プログラムの終了ステータス
+ */
+int main(void) {
+  int limit = get_command_line_limit();
+  int failed_tests = 0;
+
+  printf("exec_command のテスト開始\n");
+  printf("----------------------------------------------------\n");
+
+  // 上限に収まるパスは "{} +" 形式で実行を待つ
+  if (!run_test("{} + (短いパス)", 1, 8, 1, 1, 0)) failed_tests++;
+
+  // パス 1 つで上限を超える場合は、ためずに失敗として記録する
+  if (!run_test("{} + (上限を超えるパス)", 1, limit, 1, 0, 1))
+    failed_tests++;
+
+  // ";" 形式でも、上限を超える場合は実行せずに失敗とする
+  if (!run_test("; (上限を超えるパス)", 0, limit, 0, 0, 1)) failed_tests++;
+
+  printf("----------------------------------------------------\n");
+  if (failed_tests == 0) {
+    printf("全てのテストが成功しました！\n");
+    return 0;
+  } else {
+    printf("%d 個のテストが失敗しました。\n", failed_tests);
+    return 1;
+  }
+}
@@ -54,6 +54,46 @@ int run_test(const char *test_name, const char *pattern, const char *string,
   return (expected == result);
 }
 
+/**
+ * @brief 形状別の照合処理のテストケースを実行する関数
+ *
+ * analyze_name_pattern で判定される形状と、 match_name_condition の結果が
+ * 期待値および match_pattern の結果と一致するかを確認する
+ *
+ * @param[in] test_name テスト名
+ * @param[in] pattern マッチングパターン
+ * @param[in] string 比較文字列
+ * @param[in] ignore_case 大文字小文字を区別しない場合は 1、区別する場合は 0
+ * @param[in] fs_ignore_case ファイルシステムが大文字小文字を区別しない場合は
+ * 1、区別する場合は 0
+ * @param[in] expected_shape 期待されるパターンの形状
+ * @param[in] expected 期待される結果
+ * @return int テスト成功時は 1、失敗時は 0
+ */
+int run_shape_test(const char *test_name, const char *pattern,
+                   const char *string, int ignore_case, int fs_ignore_case,
+                   PatternShape expected_shape, int expected) {
+  Condition cond;
+  cond.pattern = (char *)pattern;
+  cond.type = TYPE_NONE;
+  cond.op = OP_AND;
+  cond.ignore_case = ignore_case;
+  analyze_name_pattern(&cond);
+
+  int result =
+      match_name_condition(&cond, string, strlen(string), fs_ignore_case) ? 1
+                                                                          : 0;
+  int reference = match_pattern(pattern, string, ignore_case, fs_ignore_case);
+  if (cond.shape != expected_shape || reference != expected) {
+    printf("%s: 失敗 (形状: %d, 期待される形状: %d, match_pattern: %d)\n",
+           test_name, cond.shape, expected_shape, reference);
+    return 0;
+  }
+  print_test_result(test_name, pattern, string, ignore_case, fs_ignore_case,
+                    expected, result);
+  return (expected == result);
+}
+
 /**
  * @brief メイン関数
  *
@@ -172,6 +212,74 @@ int main(void) {
     failed_tests++;
   if (!run_test("混合大文字小文字", "HeLLo", "hEllO", 0, 1, 1)) failed_tests++;
 
+  // 形状別の照合処理のテスト
+  printf("\n【形状別の照合処理】\n\n");
+
+  if (!run_shape_test("* のみ", "*", "anything", 0, 0, SHAPE_ANY, 1))
+    failed_tests++;
+  if (!run_shape_test("完全一致", "hello", "hello", 0, 0, SHAPE_EXACT, 1))
+    failed_tests++;
+  if (!run_shape_test("完全一致 (長さ違い)", "hello", "hello2", 0, 0,
+                      SHAPE_EXACT, 0))
+    failed_tests++;
+  if (!run_shape_test("前方一致", "hel*", "hello", 0, 0, SHAPE_PREFIX, 1))
+    failed_tests++;
+  if (!run_shape_test("前方一致 (短い文字列)", "hello*", "he", 1, 0,
+                      SHAPE_PREFIX, 0))
+    failed_tests++;
+  if (!run_shape_test("後方一致", "*.c", "efind.c", 0, 0, SHAPE_SUFFIX, 1))
+    failed_tests++;
+  if (!run_shape_test("後方一致 (-iname)", "*.C", "efind.c", 1, 0,
+                      SHAPE_SUFFIX, 1))
+    failed_tests++;
+  if (!run_shape_test("後方一致 (区別あり)", "*.C", "efind.c", 0, 0,
+                      SHAPE_SUFFIX, 0))
+    failed_tests++;
+  if (!run_shape_test("部分一致", "*ind*", "efind.c", 0, 0, SHAPE_INFIX, 1))
+    failed_tests++;
+  if (!run_shape_test("部分一致 (末尾)", "*.c*", "efind.c", 0, 0,
+                      SHAPE_INFIX, 1))
+    failed_tests++;
+  if (!run_shape_test("部分一致 (fs_ignore_case)", "*IND*", "efind.c", 0, 1,
+                      SHAPE_INFIX, 1))
+    failed_tests++;
+  if (!run_shape_test("部分一致 (不一致)", "*xyz*", "efind.c", 1, 1,
+                      SHAPE_INFIX, 0))
+    failed_tests++;
+  if (!run_shape_test("? を含むパターン", "*.?", "efind.c", 0, 0,
+                      SHAPE_GENERIC, 1))
+    failed_tests++;
+  if (!run_shape_test("途中に * を含むパターン", "e*d.c", "efind.c", 0, 0,
+                      SHAPE_GENERIC, 1))
+    failed_tests++;
+  if (!run_shape_test("日本語の後方一致", "*スト", "テスト", 0, 0,
+                      SHAPE_SUFFIX, 1))
+    failed_tests++;
+  if (!run_shape_test("日本語の部分一致", "*ス*", "テスト", 0, 0, SHAPE_INFIX,
+                      1))
+    failed_tests++;
+
+  // 2 バイト文字の 2 バイト目から始まる一致は採用しない
+  // ("ア" は 0x83 0x41 、 "表" は 0x95 0x5c)
+  if (!run_shape_test("2 バイト目との後方一致", "*A", "ア", 0, 0,
+                      SHAPE_SUFFIX, 0))
+    failed_tests++;
+  if (!run_shape_test("2 バイト目との後方一致 (-iname)", "*a", "アア", 1, 0,
+                      SHAPE_SUFFIX, 0))
+    failed_tests++;
+  if (!run_shape_test("2 バイト目との部分一致", "*A*", "アイ", 0, 0,
+                      SHAPE_INFIX, 0))
+    failed_tests++;
+  if (!run_shape_test("2 バイト目との部分一致 (-iname)", "*a*", "アイ", 1, 0,
+                      SHAPE_INFIX, 0))
+    failed_tests++;
+  if (!run_shape_test("2 バイト目の後の一致", "*A*", "アA", 0, 0,
+                      SHAPE_INFIX, 1))
+    failed_tests++;
+  if (!run_shape_test("2 バイト目が \\ の文字", "*\\*", "表示", 0, 0,
+                      SHAPE_INFIX, 0))
+    failed_tests++;
+
   // 結果表示
   printf("----------------------------------------------------\n");
   if (failed_tests == 0) {
@@ -0,0 +1,181 @@
+/**
+ * @file test_print_format.c
+ * @brief print_format.c の関数をテストするテストコード
+ */
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "../print_format.h"
+
+/**
+ * @brief テストで出力するエントリ ("src/lib/util.c" を開始パス "src" から検索)
+ */
+static const char test_path[] = "src/lib/util.c";
+static const EfindEntry test_entry = {
+    .path = test_path,
+    .dir = "src/lib/",
+    .name = test_path + 8,
+    .root = "src",
+    .relative = test_path + 4,
+    .depth = 2,
+};
+
+/**
+ * @brief テストで使用するメタデータを作成する
+ *
+ * @param[out] info 作成したメタデータ (2024-03-05 06:07:08 に更新した
+ * 1500 バイトの読み込み専用のファイル)
+ */
+static void make_test_info(FileInfo *info) {
+  struct tm tm;
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_year = 2024 - 1900;
+  tm.tm_mon = 3 - 1;
+  tm.tm_mday = 5;
+  tm.tm_hour = 6;
+  tm.tm_min = 7;
+  tm.tm_sec = 8;
+  tm.tm_isdst = -1;
+  info->size = 1500;
+  info->mtime = mktime(&tm);
+  info->mode = S_IFREG | 0444;
+}
+
+/**
+ * @brief 単一のテストケースを実行する関数
+ *
+ * @param[in] test_name テスト名
+ * @param[in] format 書式
+ * @param[in] expected 期待される出力
+ * @param[in] needs_info 書式がメタデータを参照することが期待される場合は 1
+ * @return int テスト成功時は 1、失敗時は 0
+ */
+int run_test(const char *test_name, const char *format, const char *expected,
+             int needs_info) {
+  const char *error = NULL;
+  char output[256];
+  FileInfo info;
+
+  PrintFormat *fmt = print_format_compile(format, &error);
+  if (fmt == NULL) {
+    printf("%s: 失敗 (コンパイルエラー: %s)\n", test_name, error);
+    return 0;
+  }
+  if (print_format_needs_info(fmt) != needs_info) {
+    printf("%s: 失敗 (メタデータの要否: 期待値: %d, 結果: %d)\n", test_name,
+           needs_info, print_format_needs_info(fmt));
+    print_format_free(fmt);
+    return 0;
+  }
+
+  // 一時ファイルに出力して読み戻す
+  FILE *out = tmpfile();
+  if (out == NULL) {
+    printf("%s: 失敗 (一時ファイルを作成できない)\n", test_name);
+    print_format_free(fmt);
+    return 0;
+  }
+  make_test_info(&info);
+  print_format_write(fmt, &test_entry, needs_info ? &info : NULL, out);
+  print_format_free(fmt);
+  rewind(out);
+  size_t len = fread(output, 1, sizeof(output) - 1, out);
+  output[len] = '\0';
+  fclose(out);
+
+  if (len != strlen(expected) || memcmp(output, expected, len) != 0) {
+    printf("%s: 失敗 (書式: \"%s\", 期待値: \"%s\", 結果: \"%s\")\n",
+           test_name, format, expected, output);
+    return 0;
+  }
+
+  printf("%s: 成功\n", test_name);
+  return 1;
+}
+
+/**
+ * @brief コンパイルエラーになることを確認するテストケースを実行する関数
+ *
+ * @param[in] test_name テスト名
+ * @param[in] format 書式
+ * @return int テスト成功時は 1、失敗時は 0
+ */
+int run_error_test(const char *test_name, const char *format) {
+  const char *error = NULL;
+  PrintFormat *fmt = print_format_compile(format, &error);
+  if (fmt != NULL) {
+    printf("%s: 失敗 (書式: \"%s\" がエラーにならない)\n", test_name,
+           format);
+    print_format_free(fmt);
+    return 0;
+  }
+  printf("%s: 成功 (%s)\n", test_name, error);
+  return 1;
+}
+
+/**
+ * @brief メイン関数
+ *
+ * @return int プログラムの終了ステータス
+ */
+int main(void) {
+  int failed_tests = 0;
+
+  printf("print_format のテスト開始\n");
+  printf("----------------------------------------------------\n");
+
+  // パスと名前
+  if (!run_test("パス", "%p", "src/lib/util.c", 0)) failed_tests++;
+  if (!run_test("ファイル名", "%f", "util.c", 0)) failed_tests++;
+  if (!run_test("ディレクトリ", "%h", "src/lib", 0)) failed_tests++;
+  if (!run_test("開始パスからの相対パス", "%P", "lib/util.c", 0))
+    failed_tests++;
+  if (!run_test("開始パス", "%H", "src", 0)) failed_tests++;
+  if (!run_test("深さ", "%d", "2", 0)) failed_tests++;
+
+  // リテラルとエスケープシーケンス
+  if (!run_test("リテラル", "name=%f;", "name=util.c;", 0)) failed_tests++;
+  if (!run_test("%%", "100%%", "100%", 0)) failed_tests++;
+  if (!run_test("エスケープ", "%f\\t%d\\n", "util.c\t2\n", 0))
+    failed_tests++;
+  if (!run_test("8 進数のエスケープ", "\\101\\\\", "A\\", 0)) failed_tests++;
+  if (!run_test("未知のエスケープ", "\\q", "\\q", 0)) failed_tests++;
+  if (!run_test("\\c で出力を終える", "%f\\c%p", "util.c", 0))
+    failed_tests++;
+
+  // 幅と精度
+  if (!run_test("右詰め", "[%8f]", "[  util.c]", 0)) failed_tests++;
+  if (!run_test("左詰め", "[%-8f]", "[util.c  ]", 0)) failed_tests++;
+  if (!run_test("精度", "[%.4f]", "[util]", 0)) failed_tests++;
+  if (!run_test("数値の幅", "[%3d]", "[  2]", 0)) failed_tests++;
+
+  // メタデータ
+  if (!run_test("サイズ", "%s %k %b", "1500 2 3", 1)) failed_tests++;
+  if (!run_test("種類", "%y", "f", 1)) failed_tests++;
+  if (!run_test("許可", "%m %M", "444 -r--r--r--", 1)) failed_tests++;
+  if (!run_test("日時", "%TY-%Tm-%Td %TH:%TM", "2024-03-05 06:07", 1))
+    failed_tests++;
+  if (!run_test("日時 (秒)", "%TT", "06:07:08.0000000000", 1))
+    failed_tests++;
+  if (!run_test("日時 (%T+)", "%T+", "2024-03-05+06:07:08.0000000000", 1))
+    failed_tests++;
+  if (!run_test("日時 (%t)", "%t", "Tue Mar  5 06:07:08.0000000000 2024", 1))
+    failed_tests++;
+
+  // エラー
+  if (!run_error_test("未知の指示子", "%z")) failed_tests++;
+  if (!run_error_test("末尾の %", "abc%")) failed_tests++;
+  if (!run_error_test("日時の形式がない", "%T")) failed_tests++;
+  if (!run_error_test("未知の日時の形式", "%Tq")) failed_tests++;
+
+  printf("----------------------------------------------------\n");
+  if (failed_tests == 0) {
+    printf("全てのテストが成功しました！\n");
+    return 0;
+  } else {
+    printf("%d 個のテストが失敗しました。\n", failed_tests);
+    return 1;
+  }
+}
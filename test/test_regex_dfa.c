@@ -0,0 +1,354 @@
+/**
+ * @file test_regex_dfa.c
+ * @brief regex_dfa.c の関数をテストするテストコード
+ */
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../regex_dfa.h"
+
+/**
+ * @brief 単一のテストケースを実行する関数
+ *
+ * 十分な DFA キャッシュを使用した場合と、 DFA キャッシュを使用しない
+ * (NFA のシミュレーションのみの) 場合の両方で照合し、期待値と比較する
+ *
+ * @param[in] test_name テスト名
+ * @param[in] pattern 正規表現のパターン
+ * @param[in] prefix 照合する文字列の前半
+ * @param[in] string 照合する文字列の後半
+ * @param[in] ignore_case 大文字小文字を区別しない場合は 1、区別する場合は 0
+ * @param[in] expected 期待される結果
+ * @return int テスト成功時は 1、失敗時は 0
+ */
+int run_test(const char *test_name, const char *pattern, const char *prefix,
+             const char *string, int ignore_case, int expected) {
+  static const long cache_sizes[] = {REGEX_DEFAULT_CACHE_SIZE, 0};
+  const char *error = NULL;
+
+  for (int i = 0; i < 2; i++) {
+    Regex *re = regex_compile(pattern, ignore_case, cache_sizes[i], &error);
+    if (re == NULL) {
+      printf("%s: 失敗 (コンパイルエラー: %s)\n", test_name, error);
+      return 0;
+    }
+    // 2 回照合し、キャッシュ済みの遷移でも同じ結果になることを確認する
+    for (int round = 0; round < 2; round++) {
+      int result = regex_match(re, prefix, string) ? 1 : 0;
+      if (result != expected) {
+        printf(
+            "%s: 失敗 (パターン: \"%s\", 文字列: \"%s%s\", キャッシュ: %ld, "
+            "期待値: %d, 結果: %d)\n",
+            test_name, pattern, prefix ? prefix : "", string, cache_sizes[i],
+            expected, result);
+        regex_free(re);
+        return 0;
+      }
+    }
+    regex_free(re);
+  }
+
+  printf("%s: 成功\n", test_name);
+  return 1;
+}
+
+/**
+ * @brief ワイルドカードのパターンの単一のテストケースを実行する関数
+ *
+ * パス全体を一度に照合した場合と、 prefix まで進めた状態から string を
+ * 照合した場合の両方で期待値と比較する
+ *
+ * @param[in] test_name テスト名
+ * @param[in] pattern ワイルドカードのパターン
+ * @param[in] prefix 照合する文字列の前半 (ディレクトリのパス)
+ * @param[in] string 照合する文字列の後半 (ファイル名)
+ * @param[in] ignore_case 大文字小文字を区別しない場合は 1、区別する場合は 0
+ * @param[in] expected 期待される結果
+ * @return int テスト成功時は 1、失敗時は 0
+ */
+int run_glob_test(const char *test_name, const char *pattern,
+                  const char *prefix, const char *string, int ignore_case,
+                  int expected) {
+  const char *error = NULL;
+  Regex *re = regex_compile_glob(pattern, ignore_case,
+                                 REGEX_DEFAULT_CACHE_SIZE, &error);
+  if (re == NULL) {
+    printf("%s: 失敗 (コンパイルエラー: %s)\n", test_name, error);
+    return 0;
+  }
+
+  int result = regex_match(re, prefix, string) ? 1 : 0;
+  int state = regex_advance(re, regex_start_state(re), prefix);
+  int result_from = regex_match_from(re, state, string) ? 1 : 0;
+  regex_free(re);
+
+  if (result != expected || result_from != expected) {
+    printf(
+        "%s: 失敗 (パターン: \"%s\", 文字列: \"%s%s\", 期待値: %d, "
+        "結果: %d, 途中から照合した結果: %d)\n",
+        test_name, pattern, prefix, string, expected, result, result_from);
+    return 0;
+  }
+
+  printf("%s: 成功\n", test_name);
+  return 1;
+}
+
+/**
+ * @brief 照合状態から以降どの文字列とも一致しないことを判定できるかを
+ * 確認する関数
+ *
+ * @param[in] test_name テスト名
+ * @param[in] pattern ワイルドカードのパターン
+ * @param[in] prefix 照合する文字列の前半 (ディレクトリのパス)
+ * @param[in] expected_dead 以降どの文字列とも一致しない場合は 1
+ * @return int テスト成功時は 1、失敗時は 0
+ */
+int run_dead_state_test(const char *test_name, const char *pattern,
+                        const char *prefix, int expected_dead) {
+  const char *error = NULL;
+  Regex *re = regex_compile_glob(pattern, 0, REGEX_DEFAULT_CACHE_SIZE, &error);
+  if (re == NULL) {
+    printf("%s: 失敗 (コンパイルエラー: %s)\n", test_name, error);
+    return 0;
+  }
+
+  int state = regex_advance(re, regex_start_state(re), prefix);
+  int dead = (state == REGEX_STATE_DEAD) ? 1 : 0;
+  regex_free(re);
+
+  if (state == REGEX_STATE_UNKNOWN || dead != expected_dead) {
+    printf("%s: 失敗 (パターン: \"%s\", パス: \"%s\", 状態: %d)\n",
+           test_name, pattern, prefix, state);
+    return 0;
+  }
+
+  printf("%s: 成功\n", test_name);
+  return 1;
+}
+
+/**
+ * @brief 照合状態に続くディレクトリ名が 1 通りに決まるかを確認する関数
+ *
+ * @param[in] test_name テスト名
+ * @param[in] pattern ワイルドカードのパターン
+ * @param[in] ignore_case 大文字小文字を区別しない場合は 1、区別する場合は 0
+ * @param[in] prefix 照合する文字列の前半 (ディレクトリのパス)
+ * @param[in] expected 期待されるディレクトリ名 (決まらない場合は NULL)
+ * @return int テスト成功時は 1、失敗時は 0
+ */
+int run_forced_component_test(const char *test_name, const char *pattern,
+                              int ignore_case, const char *prefix,
+                              const char *expected) {
+  const char *error = NULL;
+  char name[32];
+  Regex *re = regex_compile_glob(pattern, ignore_case,
+                                 REGEX_DEFAULT_CACHE_SIZE, &error);
+  if (re == NULL) {
+    printf("%s: 失敗 (コンパイルエラー: %s)\n", test_name, error);
+    return 0;
+  }
+
+  int state = regex_advance(re, regex_start_state(re), prefix);
+  int len = regex_forced_component(re, state, ignore_case, name, sizeof(name));
+  regex_free(re);
+
+  // 大文字小文字を区別しない場合は、どちらの文字が選ばれてもよい
+  if (expected == NULL
+          ? len != 0
+          : (len != (int)strlen(expected) ||
+             (ignore_case ? strncasecmp(name, expected, len)
+                          : strncmp(name, expected, len)) != 0)) {
+    printf("%s: 失敗 (パターン: \"%s\", パス: \"%s\", 結果: \"%.*s\")\n",
+           test_name, pattern, prefix, len, name);
+    return 0;
+  }
+
+  printf("%s: 成功\n", test_name);
+  return 1;
+}
+
+/**
+ * @brief コンパイルエラーになることを確認する関数
+ *
+ * @param[in] test_name テスト名
+ * @param[in] pattern 正規表現のパターン
+ * @return int テスト成功時は 1、失敗時は 0
+ */
+int run_error_test(const char *test_name, const char *pattern) {
+  const char *error = NULL;
+  Regex *re = regex_compile(pattern, 0, REGEX_DEFAULT_CACHE_SIZE, &error);
+  if (re != NULL) {
+    printf("%s: 失敗 (パターン \"%s\" がエラーにならない)\n", test_name,
+           pattern);
+    regex_free(re);
+    return 0;
+  }
+  printf("%s: 成功 (%s)\n", test_name, error);
+  return 1;
+}
+
+/**
+ * @brief DFA キャッシュが上限に達した後も正しく照合できることを確認する関数
+ *
+ * @return int テスト成功時は 1、失敗時は 0
+ */
+int run_small_cache_test(void) {
+  const char *error = NULL;
+  // 状態数の多い DFA になるパターンを最小限のキャッシュで照合する
+  Regex *re = regex_compile(".*a.....", 0, 1, &error);
+  int ok = re != NULL && regex_match(re, "./", "xxaxxxxx") &&
+           !regex_match(re, "./", "xxxxxxxx") &&
+           regex_match(re, NULL, "aaaaaaaaaa") &&
+           !regex_match(re, NULL, "aaaaaaaaabbbbbb");
+  regex_free(re);
+  printf("キャッシュが上限に達した場合: %s\n", ok ? "成功" : "失敗");
+  return ok;
+}
+
+/**
+ * @brief メイン関数
+ * @return テスト結果 (0: 成功, 0以外: 失敗)
+ */
+int main(void) {
+  int failed_tests = 0;
+
+  printf("regex_dfa のテストを開始します\n");
+  printf("----------------------------------------------------\n");
+
+  // 基本的な照合 (文字列全体との一致)
+  if (!run_test("完全一致", "abc", NULL, "abc", 0, 1)) failed_tests++;
+  if (!run_test("部分一致は不一致", "abc", NULL, "xabcx", 0, 0))
+    failed_tests++;
+  if (!run_test("前半と後半の連結", "./src/main\\.c", "./src/", "main.c", 0, 1))
+    failed_tests++;
+  if (!run_test("空のパターン", "", NULL, "", 0, 1)) failed_tests++;
+  if (!run_test("^ と $", "^a.c$", NULL, "abc", 0, 1)) failed_tests++;
+
+  // 演算子
+  if (!run_test(".*", ".*\\.c", "./", "efind.c", 0, 1)) failed_tests++;
+  if (!run_test(".* (不一致)", ".*\\.c", "./", "efind.h", 0, 0))
+    failed_tests++;
+  if (!run_test("+", "a+b", NULL, "aaab", 0, 1)) failed_tests++;
+  if (!run_test("+ (0 回)", "a+b", NULL, "b", 0, 0)) failed_tests++;
+  if (!run_test("?", "ab?c", NULL, "ac", 0, 1)) failed_tests++;
+  if (!run_test("|", ".*\\.(c|h)", NULL, "efind.h", 0, 1)) failed_tests++;
+  if (!run_test("| (不一致)", ".*\\.(c|h)", NULL, "efind.x", 0, 0))
+    failed_tests++;
+  if (!run_test("入れ子の繰り返し", "(a*)*b", NULL, "aaab", 0, 1))
+    failed_tests++;
+  if (!run_test("空の選択肢", "a(|b)c", NULL, "ac", 0, 1)) failed_tests++;
+
+  // ブラケット式
+  if (!run_test("範囲", "[a-c]+", NULL, "abcba", 0, 1)) failed_tests++;
+  if (!run_test("範囲 (不一致)", "[a-c]+", NULL, "abd", 0, 0)) failed_tests++;
+  if (!run_test("否定", "[^/]*", NULL, "abc", 0, 1)) failed_tests++;
+  if (!run_test("否定 (不一致)", "[^/]*", NULL, "a/c", 0, 0)) failed_tests++;
+  if (!run_test("先頭の ]", "[]a]+", NULL, "]a]", 0, 1)) failed_tests++;
+  if (!run_test("文字クラス名", "[[:digit:]]+", NULL, "0123", 0, 1))
+    failed_tests++;
+
+  // 大文字小文字を区別しない場合
+  if (!run_test("-iregex", ".*\\.C", NULL, "efind.c", 1, 1)) failed_tests++;
+  if (!run_test("-regex は区別する", ".*\\.C", NULL, "efind.c", 0, 0))
+    failed_tests++;
+  if (!run_test("-iregex の範囲", "[A-Z]+", NULL, "abc", 1, 1))
+    failed_tests++;
+
+  // 2 バイト文字 (SJIS)
+  if (!run_test("日本語の完全一致", "テスト", NULL, "テスト", 0, 1))
+    failed_tests++;
+  if (!run_test(". は 2 バイト文字 1 文字", "テ.ト", NULL, "テスト", 0, 1))
+    failed_tests++;
+  if (!run_test(". の数が合わない", "テ..ト", NULL, "テスト", 0, 0))
+    failed_tests++;
+  if (!run_test("2 バイト目と一致しない", ".*A", NULL, "ア", 0, 0))
+    failed_tests++;
+  if (!run_test("2 バイト目と一致しない (-iregex)", ".*a", NULL, "ア", 1, 0))
+    failed_tests++;
+  if (!run_test("2 バイト目が \\ の文字", ".*\\\\.*", NULL, "表示", 0, 0))
+    failed_tests++;
+  if (!run_test("日本語のブラケット式", "[アイウ]+", NULL, "イア", 0, 1))
+    failed_tests++;
+  if (!run_test("日本語の範囲", "[ア-ウ]+", NULL, "イ", 0, 1)) failed_tests++;
+  if (!run_test("日本語の否定", "[^ア]", NULL, "イ", 0, 1)) failed_tests++;
+  if (!run_test("日本語の否定 (不一致)", "[^ア]", NULL, "ア", 0, 0))
+    failed_tests++;
+  if (!run_test("否定は 2 バイト文字にも一致", "[^/]+", NULL, "テスト", 0, 1))
+    failed_tests++;
+
+  // ワイルドカードのパターン (-path)
+  if (!run_glob_test("-path の *", "./src/*.c", "./src/", "main.c", 0, 1))
+    failed_tests++;
+  if (!run_glob_test("* は / にも一致", "./*.c", "./src/lib/", "a.c", 0, 1))
+    failed_tests++;
+  if (!run_glob_test("-path の ?", "./?.c", "./", "a.c", 0, 1))
+    failed_tests++;
+  if (!run_glob_test("-path の不一致", "./src/*.c", "./doc/", "main.c", 0, 0))
+    failed_tests++;
+  if (!run_glob_test(". はそのままの文字", "./a.c", "./", "abc", 0, 0))
+    failed_tests++;
+  if (!run_glob_test("-ipath", "./SRC/*", "./src/", "main.c", 1, 1))
+    failed_tests++;
+  if (!run_glob_test("日本語の ?", "./?.txt", "./", "表.txt", 0, 1))
+    failed_tests++;
+  if (!run_glob_test("2 バイト目が \\ の文字", "*\\*", "./", "表示", 0, 0))
+    failed_tests++;
+
+  // 照合状態による枝刈り
+  if (!run_dead_state_test("対象外のディレクトリ", "./src/*/test/*", "./doc/",
+                           1))
+    failed_tests++;
+  if (!run_dead_state_test("対象のディレクトリ", "./src/*/test/*",
+                           "./src/lib/", 0))
+    failed_tests++;
+  if (!run_dead_state_test("パターンより深い", "./src", "./src/", 1))
+    failed_tests++;
+  if (!run_dead_state_test("先頭が *", "*/test/*", "./doc/", 0))
+    failed_tests++;
+
+  // 直接たどるディレクトリ名
+  if (!run_forced_component_test("固定のディレクトリ名", "./build/release/*.o",
+                                 0, "./", "build"))
+    failed_tests++;
+  if (!run_forced_component_test("2 段目のディレクトリ名",
+                                 "./build/release/*.o", 0, "./build/",
+                                 "release"))
+    failed_tests++;
+  if (!run_forced_component_test("ワイルドカードから先", "./build/release/*.o",
+                                 0, "./build/release/", NULL))
+    failed_tests++;
+  if (!run_forced_component_test("途中にワイルドカード", "./b?ild/*", 0, "./",
+                                 NULL))
+    failed_tests++;
+  if (!run_forced_component_test("ディレクトリ自身が一致", "./build*", 0, "./",
+                                 NULL))
+    failed_tests++;
+  if (!run_forced_component_test("大文字小文字を区別しない", "./Build/*", 1,
+                                 "./", "Build"))
+    failed_tests++;
+  if (!run_forced_component_test("日本語のディレクトリ名", "./表示/*", 0, "./",
+                                 "表示"))
+    failed_tests++;
+  if (!run_forced_component_test("..", "./../*", 0, "./", NULL))
+    failed_tests++;
+
+  // エラー
+  if (!run_error_test("対応しない (", "(abc")) failed_tests++;
+  if (!run_error_test("対応しない [", "[abc")) failed_tests++;
+  if (!run_error_test("繰り返す対象がない", "*abc")) failed_tests++;
+  if (!run_error_test("間隔指定", "a{2}")) failed_tests++;
+  if (!run_error_test("逆順の範囲", "[z-a]")) failed_tests++;
+
+  if (!run_small_cache_test()) failed_tests++;
+
+  printf("----------------------------------------------------\n");
+  if (failed_tests == 0) {
+    printf("全てのテストが成功しました！\n");
+    return 0;
+  } else {
+    printf("%d 個のテストが失敗しました。\n", failed_tests);
+    return 1;
+  }
+}
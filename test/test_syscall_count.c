@@ -0,0 +1,430 @@
+/**
+ * @file test_syscall_count.c
+ * @brief 検索中のファイルシステムの呼び出し回数をテストするテストコード
+ *
+ * ディレクトリの読み込みとファイルの情報の取得を数える関数に置き換えて
+ * efind.c をインクルードし、テスト用のツリーを検索したときの呼び出し回数が
+ * 増えていないことを確認する
+ */
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../arch.h"
+
+static int dir_reads;      // ディレクトリを読んだ回数
+static int entry_reads;    // ディレクトリのエントリを読んだ回数
+static int path_stats;     // パスを指定してファイルの情報を取得した回数
+static int open_dirs;      // 開いているディレクトリの数
+static int max_open_dirs;  // 同時に開いていたディレクトリの数の最大値
+
+static DIR *counting_opendir(const char *path) {
+  dir_reads++;
+  DIR *dir = opendir(path);
+  if (dir != NULL && ++open_dirs > max_open_dirs) {
+    max_open_dirs = open_dirs;
+  }
+  return dir;
+}
+
+static int counting_closedir(DIR *dir) {
+  open_dirs--;
+  return closedir(dir);
+}
+
+static struct dirent *counting_readdir(DIR *dir) {
+  entry_reads++;
+  return readdir(dir);
+}
+
+static int counting_scan_file_attributes(const char *dir_path,
+                                         FileAttributeCallback callback,
+                                         void *user_data) {
+  dir_reads++;
+  return scan_file_attributes(dir_path, callback, user_data);
+}
+
+static int counting_is_existing_regular_file(const char *path) {
+  path_stats++;
+  return is_existing_regular_file(path);
+}
+
+static int counting_get_directory_identity(const char *path,
+                                           FileIdentity *id) {
+  path_stats++;
+  return get_directory_identity(path, id);
+}
+
+static int counting_find_subdirectory(const char *path, char *name,
+                                      const int size) {
+  path_stats++;
+  return find_subdirectory(path, name, size);
+}
+
+static int counting_get_file_attributes(const char *path) {
+  path_stats++;
+  return get_file_attributes(path);
+}
+
+static int counting_get_file_info(const char *path, FileInfo *info) {
+  path_stats++;
+  return get_file_info(path, info);
+}
+
+#define opendir counting_opendir
+#define readdir counting_readdir
+#define closedir counting_closedir
+#define scan_file_attributes counting_scan_file_attributes
+#define is_existing_regular_file counting_is_existing_regular_file
+#define get_directory_identity counting_get_directory_identity
+#define find_subdirectory counting_find_subdirectory
+#define get_file_attributes counting_get_file_attributes
+#define get_file_info counting_get_file_info
+
+// static 関数と同じ呼び出しを数えるため、efind.c ファイルをインクルードする
+#include "../efind.c"
+
+#define TEST_ROOT "sctest"  // テスト用のツリーの開始パス
+#define TEST_DIRS 4         // テスト用のツリーのディレクトリ数 (開始パスを含む)
+#define TEST_ENTRIES 7      // テスト用のツリーのエントリ数 (開始パスを除く)
+
+/**
+ * @brief テスト用のツリーのエントリ (末尾が "/" のものはディレクトリ)
+ */
+static const char *const test_tree[] = {
+    TEST_ROOT "/",
+    TEST_ROOT "/a.c",
+    TEST_ROOT "/b.h",
+    TEST_ROOT "/sub1/",
+    TEST_ROOT "/sub1/c.c",
+    TEST_ROOT "/sub1/sub2/",
+    TEST_ROOT "/sub1/sub2/d.c",
+    TEST_ROOT "/sub3/",
+};
+#define TEST_TREE_SIZE (int)(sizeof(test_tree) / sizeof(test_tree[0]))
+
+/**
+ * @brief テスト用のツリーを作成または削除する
+ *
+ * @param[in] create 作成する場合は 1、削除する場合は 0
+ * @return 成功時は 1、失敗時は 0
+ */
+static int setup_tree(const int create) {
+  for (int n = 0; n < TEST_TREE_SIZE; n++) {
+    // 削除する場合は中身から順に削除する
+    const char *entry = test_tree[create ? n : TEST_TREE_SIZE - 1 - n];
+    char path[64];
+    int len = strlen(entry);
+    int is_dir = entry[len - 1] == '/';
+
+    strcpy(path, entry);
+    if (is_dir) {
+      path[len - 1] = '\0';
+    }
+    if (!create) {
+      if (is_dir) {
+        rmdir(path);
+      } else {
+        remove(path);
+      }
+    } else if (is_dir) {
+      if (mkdir(path, 0755) != 0) {
+        return 0;
+      }
+    } else {
+      FILE *fp = fopen(path, "w");
+      if (fp == NULL) {
+        return 0;
+      }
+      fclose(fp);
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief 一致したエントリを数えるコールバック関数
+ *
+ * @param[in] entry 一致したエントリ
+ * @param[in,out] user_data 一致したエントリ数 (int へのポインタ)
+ * @return 検索を続けるため常に 0
+ */
+static int count_entry(const EfindEntry *entry, void *user_data) {
+  (*(int *)user_data)++;
+  return 0;
+}
+
+/**
+ * @brief 索引に残ったエントリの属性フラグを書き換える
+ *
+ * @param[in,out] index 索引
+ * @param[in] name 書き換えるエントリのファイル名
+ * @param[in] attributes 追加する属性フラグ
+ */
+static void mark_index_entry(EfindIndex *index, const char *name,
+                             const int attributes) {
+  for (int d = 0; d < index->dir_count; d++) {
+    const IndexDir *dir = &index->dirs[d];
+    for (int i = dir->first; i < dir->first + dir->count; i++) {
+      if (strcmp(index->names + index->name_offsets[i], name) == 0) {
+        index->flags[i] |= attributes;
+      }
+    }
+  }
+}
+
+/**
+ * @brief 単一のテストケースを実行する関数
+ *
+ * @param[in] test_name テスト名
+ * @param[in] opts 検索条件
+ * @param[in] expected_matches 一致するエントリ数
+ * @param[in] expected_dirs ディレクトリを読む回数
+ * @param[in] max_stats ファイルの情報を取得する回数の上限
+ * @return int テスト成功時は 1、失敗時は 0
+ */
+static int run_test(const char *test_name, const Options *opts,
+                    const int expected_matches, const int expected_dirs,
+                    const int max_stats) {
+  int matches = 0;
+
+  dir_reads = 0;
+  entry_reads = 0;
+  path_stats = 0;
+  efind_walk(TEST_ROOT, opts, count_entry, &matches);
+
+  // 各ディレクトリで "." と ".." と終端を読む分を許容する
+  if (matches != expected_matches || dir_reads != expected_dirs ||
+      path_stats > max_stats ||
+      entry_reads > TEST_ENTRIES + expected_dirs * 3) {
+    printf("%s: 失敗 (一致: %d/%d, ディレクトリ: %d/%d, 情報の取得: %d/%d, "
+           "エントリ: %d)\n",
+           test_name, matches, expected_matches, dir_reads, expected_dirs,
+           path_stats, max_stats, entry_reads);
+    return 0;
+  }
+  printf("%s: 成功 (ディレクトリ: %d, 情報の取得: %d, エントリ: %d)\n",
+         test_name, dir_reads, path_stats, entry_reads);
+  return 1;
+}
+
+/**
+ * @brief 専用の関数 (efind_select_print) でパスを出力するテストケースを
+ * 実行する関数
+ *
+ * @param[in] test_name テスト名
+ * @param[in] opts 検索条件
+ * @param[in] expected_matches 出力されるパスの数
+ * @return int テスト成功時は 1、失敗時は 0
+ */
+static int run_print_test(const char *test_name, const Options *opts,
+                          const int expected_matches) {
+  EfindPrintFunction print = efind_select_print(opts);
+  if (print == NULL) {
+    printf("%s: 失敗 (専用の関数が選択されない)\n", test_name);
+    return 0;
+  }
+  FILE *out = tmpfile();
+  if (out == NULL) {
+    printf("%s: 失敗 (一時ファイルを作成できない)\n", test_name);
+    return 0;
+  }
+
+  dir_reads = 0;
+  entry_reads = 0;
+  path_stats = 0;
+  max_open_dirs = 0;
+  print(TEST_ROOT, opts, out);
+
+  int lines = 0;
+  int c;
+  rewind(out);
+  while ((c = getc(out)) != EOF) {
+    if (c == '\n') {
+      lines++;
+    }
+  }
+  fclose(out);
+
+  // efind_next と同じく、中に降りる前にディレクトリを閉じる
+  if (lines != expected_matches || dir_reads != TEST_DIRS || path_stats > 1 ||
+      entry_reads > TEST_ENTRIES + TEST_DIRS * 3 || max_open_dirs != 1) {
+    printf("%s: 失敗 (出力: %d/%d, ディレクトリ: %d, 情報の取得: %d, "
+           "エントリ: %d, 同時に開いたディレクトリ: %d)\n",
+           test_name, lines, expected_matches, dir_reads, path_stats,
+           entry_reads, max_open_dirs);
+    return 0;
+  }
+  printf("%s: 成功 (ディレクトリ: %d, 情報の取得: %d, エントリ: %d)\n",
+         test_name, dir_reads, path_stats, entry_reads);
+  return 1;
+}
+
+/**
+ * @brief メイン関数
+ *
+ * @return int プログラムの終了ステータス
+ */
+int main(void) {
+  Options opts;
+  int failed_tests = 0;
+
+  printf("ファイルシステムの呼び出し回数のテスト開始\n");
+  printf("----------------------------------------------------\n");
+
+  setup_tree(0);
+  if (!setup_tree(1)) {
+    printf("テスト用のツリーを作成できません\n");
+    setup_tree(0);
+    return 1;
+  }
+
+  // 種類を調べるのは開始パスだけで、サブディレクトリはディレクトリを読んだ
+  // ときの種類に基づいて降りていく
+  efind_query_init(&opts);
+  if (!run_test("条件なし", &opts, TEST_ENTRIES, TEST_DIRS, 1)) failed_tests++;
+
+  efind_query_init(&opts);
+  efind_query_add_name(&opts, "*.c", 0);
+  if (!run_test("-name '*.c'", &opts, 3, TEST_DIRS, 1)) failed_tests++;
+
+  efind_query_init(&opts);
+  opts.maxdepth = 1;
+  if (!run_test("-maxdepth 1", &opts, 4, 1, 1)) failed_tests++;
+
+  // 属性が必要な場合も、取得するのはエントリごとに 1 回まで
+  efind_query_init(&opts);
+  efind_query_add_type(&opts, TYPE_SYMLINK);
+  if (!run_test("-type l", &opts, 0, TEST_DIRS, 1 + TEST_ENTRIES))
+    failed_tests++;
+
+  // -L ではディレクトリの識別値をディレクトリごとに 1 回だけ取得する
+  efind_query_init(&opts);
+  opts.follow = FOLLOW_ALL;
+  if (!run_test("-L", &opts, TEST_ENTRIES, TEST_DIRS, 1 + TEST_DIRS))
+    failed_tests++;
+
+  // 索引を作成した検索のあとは、ディレクトリを読まずに索引から列挙し、
+  // 索引にない属性はエントリごとに 1 回までで取得する
+  efind_query_init(&opts);
+  opts.index = efind_index_create();
+  if (opts.index == NULL ||
+      !run_test("索引の作成", &opts, TEST_ENTRIES, TEST_DIRS, 1))
+    failed_tests++;
+  efind_query_add_type(&opts, TYPE_SYMLINK);
+  if (opts.index == NULL ||
+      !run_test("索引の再利用 (-type l)", &opts, 0, 0, 1 + TEST_ENTRIES))
+    failed_tests++;
+
+  // 属性を使わない検索の結果は、ほかの検索が索引に残した属性によらず
+  // 索引を使わない場合と同じになる (リンクを作成できない環境でも確認できる
+  // よう、索引に残った a.c の属性をリンクにする)
+  EfindIndex *index = opts.index;
+  if (index != NULL) {
+    mark_index_entry(index, "a.c", FILE_ATTR_SYMLINK);
+  }
+  efind_query_init(&opts);
+  efind_query_add_type(&opts, TYPE_FILE);
+  if (!run_test("-type f", &opts, TEST_ENTRIES - TEST_DIRS + 1, TEST_DIRS, 1))
+    failed_tests++;
+  opts.index = index;
+  if (index == NULL || !run_test("索引の再利用 (-type f)", &opts,
+                                 TEST_ENTRIES - TEST_DIRS + 1, 0, 1))
+    failed_tests++;
+  efind_index_free(index);
+
+  // 範囲を設定した索引には範囲の下のディレクトリだけを追加し、重なる開始
+  // パスの検索ではディレクトリを読み直さない
+  efind_query_init(&opts);
+  opts.index = efind_index_create();
+  if (opts.index == NULL ||
+      !efind_index_add_scope(opts.index, "./" TEST_ROOT "/sub1/")) {
+    printf("索引の範囲: 失敗 (索引を作成できない)\n");
+    failed_tests++;
+  } else {
+    int matches = 0;
+    int ok = run_test("索引の範囲 (外側)", &opts, TEST_ENTRIES, TEST_DIRS, 1);
+    dir_reads = 0;
+    efind_walk("./" TEST_ROOT "/sub1", &opts, count_entry, &matches);
+    if (!ok || opts.index->dir_count != 2 || matches != 3 || dir_reads != 0) {
+      printf("索引の範囲 (内側): 失敗 (索引: %d/2, 一致: %d/3, "
+             "ディレクトリ: %d/0)\n",
+             opts.index->dir_count, matches, dir_reads);
+      failed_tests++;
+    } else {
+      printf("索引の範囲 (内側): 成功 (索引: %d)\n", opts.index->dir_count);
+    }
+  }
+  efind_index_free(opts.index);
+
+  // -o の直後の -path は必須の条件ではないので、一致しないディレクトリも
+  // 読んで、ほかの条件に一致するエントリを出力する
+  efind_query_init(&opts);
+  efind_query_add_name(&opts, "a.c", 0);
+  efind_query_or(&opts);
+  efind_query_add_path(&opts, TEST_ROOT "/sub1/*", 0);
+  efind_query_compile(&opts);
+  if (!run_test("-name a.c -o -path 'sctest/sub1/*'", &opts, 4, TEST_DIRS, 1))
+    failed_tests++;
+  efind_query_free(&opts);
+
+  // 必須の -path の先頭のディレクトリ名が決まっていれば、途中のディレクトリを
+  // 列挙せずに直接たどる
+  efind_query_init(&opts);
+  efind_query_add_path(&opts, TEST_ROOT "/sub1/sub2/*", 0);
+  efind_query_compile(&opts);
+  if (!run_test("-path 'sctest/sub1/sub2/*'", &opts, 1, 1, 3))
+    failed_tests++;
+  efind_query_free(&opts);
+
+  // -o で結合した -path では直接たどらず、ほかの条件に一致するエントリを
+  // 出力する
+  efind_query_init(&opts);
+  efind_query_add_name(&opts, "a.c", 0);
+  efind_query_or(&opts);
+  efind_query_add_path(&opts, TEST_ROOT "/sub1/sub2/*", 0);
+  efind_query_compile(&opts);
+  if (!run_test("-name a.c -o -path 'sctest/sub1/sub2/*'", &opts, 2,
+                TEST_DIRS, 1))
+    failed_tests++;
+  efind_query_free(&opts);
+
+  // 条件がないか種類だけの場合は、専用の関数で直接出力する
+  efind_query_init(&opts);
+  if (!run_print_test("専用の関数 (条件なし)", &opts, TEST_ENTRIES))
+    failed_tests++;
+
+  efind_query_init(&opts);
+  efind_query_add_type(&opts, TYPE_DIR);
+  if (!run_print_test("専用の関数 (-type d)", &opts, TEST_DIRS - 1))
+    failed_tests++;
+
+  efind_query_init(&opts);
+  efind_query_add_type(&opts, TYPE_FILE);
+  if (!run_print_test("専用の関数 (-type f)", &opts,
+                      TEST_ENTRIES - TEST_DIRS + 1))
+    failed_tests++;
+
+  efind_query_init(&opts);
+  efind_query_add_name(&opts, "*.c", 0);
+  if (efind_select_print(&opts) != NULL) {
+    printf("専用の関数 (-name): 失敗 (選択された)\n");
+    failed_tests++;
+  } else {
+    printf("専用の関数 (-name): 成功 (選択されない)\n");
+  }
+
+  setup_tree(0);
+
+  printf("----------------------------------------------------\n");
+  if (failed_tests == 0) {
+    printf("全てのテストが成功しました！\n");
+    return 0;
+  } else {
+    printf("%d 個のテストが失敗しました。\n", failed_tests);
+    return 1;
+  }
+}
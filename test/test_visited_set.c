@@ -0,0 +1,84 @@
+/**
+ * @file test_visited_set.c
+ * @brief visited_add() 関数をテストするテストコード
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+// static 関数をテストするため、efind.c ファイルをインクルードする
+#include "../efind.c"
+
+/**
+ * @brief 単一のテストケースを実行する関数
+ *
+ * @param[in,out] set 集合
+ * @param[in] test_name テスト名
+ * @param[in] device 追加する識別値のドライブ番号
+ * @param[in] inode 追加する識別値の番号
+ * @param[in] expected visited_add の期待される戻り値
+ * @return int テスト成功時は 1、失敗時は 0
+ */
+static int run_test(VisitedSet *set, const char *test_name,
+                    const unsigned long device, const unsigned long inode,
+                    const int expected) {
+  FileIdentity id = {device, inode};
+  int result = visited_add(set, &id);
+  if (result != expected) {
+    printf("%s: 失敗 (期待値: %d, 結果: %d)\n", test_name, expected, result);
+    return 0;
+  }
+  printf("%s: 成功\n", test_name);
+  return 1;
+}
+
+/**
+ * @brief メイン関数
+ *
+ * @return int プログラムの終了ステータス
+ */
+int main(void) {
+  VisitedSet set = {NULL, 0, 0};
+  int failed_tests = 0;
+
+  printf("visited_add のテスト開始\n");
+  printf("----------------------------------------------------\n");
+
+  if (!run_test(&set, "初めてのディレクトリ", 2, 100, 1)) failed_tests++;
+  if (!run_test(&set, "同じディレクトリ (循環)", 2, 100, 0)) failed_tests++;
+  if (!run_test(&set, "別のドライブの同じ番号", 3, 100, 1)) failed_tests++;
+  if (!run_test(&set, "ルートディレクトリ", 2, 0, 1)) failed_tests++;
+  if (!run_test(&set, "ルートディレクトリ (2 回目)", 2, 0, 0)) failed_tests++;
+
+  // 表を何度も拡張した後も、すべての識別値が 1 回だけ追加されること
+  int grow_failed = 0;
+  for (unsigned long i = 1; i <= 1000 && !grow_failed; i++) {
+    FileIdentity id = {4, i * 64};
+    if (visited_add(&set, &id) != 1) {
+      grow_failed = 1;
+    }
+  }
+  for (unsigned long i = 1; i <= 1000 && !grow_failed; i++) {
+    FileIdentity id = {4, i * 64};
+    if (visited_add(&set, &id) != 0) {
+      grow_failed = 1;
+    }
+  }
+  if (grow_failed || set.count != 1003) {
+    printf("表の拡張: 失敗 (格納数: %d)\n", set.count);
+    failed_tests++;
+  } else {
+    printf("表の拡張: 成功 (容量: %d)\n", set.capacity);
+  }
+  if (!run_test(&set, "拡張後の同じディレクトリ", 2, 100, 0)) failed_tests++;
+
+  free(set.slots);
+
+  printf("----------------------------------------------------\n");
+  if (failed_tests == 0) {
+    printf("全てのテストが成功しました！\n");
+    return 0;
+  } else {
+    printf("%d 個のテストが失敗しました。\n", failed_tests);
+    return 1;
+  }
+}
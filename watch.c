@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "efind.h"
+
+/**
+ * @brief 監視の状態を保持する構造体
+ *
+ * 前回の検索で条件に一致したパスを整列して保持し、今回の検索結果と比較する
+ */
+struct EfindWatch {
+  Options *query;        // 検索条件
+  char **previous;       // 前回一致したパス (整列済み)
+  int previous_count;    // previous の要素数
+  char **current;        // 今回一致したパス
+  int current_count;     // current の要素数
+  int current_capacity;  // current の容量
+  int error;             // メモリ不足が発生した場合は 1
+};
+
+/**
+ * @brief efind_walk のコールバックに渡す情報
+ */
+typedef struct {
+  EfindWatch *watch;    // 監視の状態
+  EfindCallback added;  // 新たに一致したエントリを受け取る関数
+  void *user_data;      // added に渡すポインタ
+} WatchScan;
+
+/**
+ * @brief qsort / bsearch 用のパスの比較関数
+ */
+static int compare_paths(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * @brief パスの配列を解放する
+ *
+ * @param[in] paths 解放する配列
+ * @param[in] count 要素数
+ */
+static void free_paths(char **paths, const int count) {
+  for (int i = 0; i < count; i++) {
+    free(paths[i]);
+  }
+  free(paths);
+}
+
+/**
+ * @brief 条件に一致したエントリを記録し、前回一致していなければ通知する
+ *
+ * @param[in] entry 条件に一致したエントリ
+ * @param[in] user_data WatchScan へのポインタ
+ * @return 検索を続ける場合は 0、メモリ不足で中断する場合は 1
+ */
+static int record_entry(const EfindEntry *entry, void *user_data) {
+  WatchScan *scan = (WatchScan *)user_data;
+  EfindWatch *watch = scan->watch;
+
+  if (watch->current_count >= watch->current_capacity) {
+    int new_capacity =
+        watch->current_capacity ? watch->current_capacity * 2 : 256;
+    char **new_current =
+        (char **)realloc(watch->current, sizeof(char *) * new_capacity);
+    if (new_current == NULL) {
+      fprintf(stderr, "Memory allocation error\n");
+      watch->error = 1;
+      return 1;
+    }
+    watch->current = new_current;
+    watch->current_capacity = new_capacity;
+  }
+  char *path = strdup(entry->path);
+  if (path == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    watch->error = 1;
+    return 1;
+  }
+  watch->current[watch->current_count++] = path;
+
+  if (bsearch(&path, watch->previous, watch->previous_count, sizeof(char *),
+              compare_paths) != NULL) {
+    return 0;  // 前回も一致していた
+  }
+  // 結果をすべて記録するため、 added の戻り値にかかわらず検索を続ける
+  scan->added(entry, scan->user_data);
+  return 0;
+}
+
+EfindWatch *efind_watch_create(Options *query) {
+  EfindWatch *watch = (EfindWatch *)calloc(1, sizeof(EfindWatch));
+  if (watch == NULL) {
+    fprintf(stderr, "Memory allocation error\n");
+    return NULL;
+  }
+  watch->query = query;
+  return watch;
+}
+
+int efind_watch_scan(EfindWatch *watch, char *const roots[],
+                     const int root_count, EfindCallback added,
+                     EfindRemovedCallback removed, void *user_data) {
+  WatchScan scan = {watch, added, user_data};
+  int status = 0;
+
+  // -mmin / -mtime の経過時間は検索を開始した日時から求める
+  efind_query_update_time(watch->query);
+
+  watch->current_count = 0;
+  for (int i = 0; i < root_count && !watch->error; i++) {
+    if (efind_walk(roots[i], watch->query, record_entry, &scan) != 0) {
+      status = 1;
+    }
+  }
+  if (watch->error) {
+    free_paths(watch->current, watch->current_count);
+    watch->current = NULL;
+    watch->current_count = watch->current_capacity = 0;
+    watch->error = 0;
+    return 1;
+  }
+
+  // 今回の結果を整列し、前回だけに含まれるパスを通知する
+  qsort(watch->current, watch->current_count, sizeof(char *), compare_paths);
+  if (removed != NULL) {
+    int j = 0;
+    for (int i = 0; i < watch->previous_count; i++) {
+      int cmp = 1;
+      while (j < watch->current_count &&
+             (cmp = strcmp(watch->current[j], watch->previous[i])) < 0) {
+        j++;
+      }
+      if (j >= watch->current_count || cmp > 0) {
+        removed(watch->previous[i], user_data);
+      }
+    }
+  }
+
+  // 今回の結果を次回の比較対象にする
+  free_paths(watch->previous, watch->previous_count);
+  watch->previous = watch->current;
+  watch->previous_count = watch->current_count;
+  watch->current = NULL;
+  watch->current_count = watch->current_capacity = 0;
+  return status;
+}
+
+void efind_watch_free(EfindWatch *watch) {
+  if (watch == NULL) {
+    return;
+  }
+  free_paths(watch->previous, watch->previous_count);
+  free_paths(watch->current, watch->current_count);
+  free(watch);
+}